@@ -10,11 +10,131 @@ extern "C"
 	// Function to setup a scene into the raycast manager
 	RCU_EXPORT void rcu_raycast_manager_setup(RCURaycastManagerObject* raycastManager, RCUSceneObject* scene);
 
+	// Function to start building a scene in the background, queries keep using the previous scene until it is ready
+	RCU_EXPORT void rcu_raycast_manager_setup_async(RCURaycastManagerObject* raycastManager, RCUSceneObject* scene);
+
+	// Function to cancel the background build
+	RCU_EXPORT void rcu_raycast_manager_cancel_setup(RCURaycastManagerObject* raycastManager);
+
+	// Function to get the status of the background build (0 idle, 1 building, 2 ready, 3 cancelled, 4 failed)
+	RCU_EXPORT int rcu_raycast_manager_setup_status(RCURaycastManagerObject* raycastManager);
+
+	// Function to get the progress [0, 1] of the background build
+	RCU_EXPORT float rcu_raycast_manager_setup_progress(RCURaycastManagerObject* raycastManager);
+
+	// Function to build the structures needed by the spatial queries (closest point, overlaps, sweeps) during the next setups
+	RCU_EXPORT void rcu_raycast_manager_enable_spatial_queries(RCURaycastManagerObject* raycastManager, int enabled);
+
+	// Function to build the scenes with context filter support during the next setups, needed by run_multi_hit
+	RCU_EXPORT void rcu_raycast_manager_enable_multi_hit(RCURaycastManagerObject* raycastManager, int enabled);
+
+	// Function to bake a sparse occupancy grid during the next setups, the rays that only cross empty voxels skip the traversal. The voxel size
+	// is doubled until the grid fits in memoryBudget bytes, 0 disables the grid.
+	RCU_EXPORT void rcu_raycast_manager_enable_occupancy_culling(RCURaycastManagerObject* raycastManager, float voxelSize, uint64_t memoryBudget);
+
+	// Function to bake a sparse signed distance field during the next setups for the approximate queries. The voxel size is doubled until the
+	// field fits in memoryBudget bytes, 0 disables the field. The geometry updates resample it, the samples report an error of FLT_MAX
+	// once a geometry left it.
+	RCU_EXPORT void rcu_raycast_manager_enable_distance_field(RCURaycastManagerObject* raycastManager, float voxelSize, uint64_t memoryBudget);
+
+	// Function to merge the small static geometries (at most maxTriangles triangles) in batches during the next setups, 0 disables it
+	RCU_EXPORT void rcu_raycast_manager_enable_geometry_merging(RCURaycastManagerObject* raycastManager, uint32_t maxTriangles);
+
+	// Function to push the updated vertices of a deformable geometry, the hierarchies are refitted before the next query
+	RCU_EXPORT void rcu_raycast_manager_update_geometry(RCURaycastManagerObject* raycastManager, uint32_t geometryIdx);
+
+	// Function to push the transform of an instanced geometry, only the top level hierarchy is updated before the next query
+	RCU_EXPORT void rcu_raycast_manager_update_geometry_transform(RCURaycastManagerObject* raycastManager, uint32_t geometryIdx);
+
+	// Function to follow the specular reflections of the emitter rays for up to maxBounces bounces, one path endpoint is written per emitter
+	RCU_EXPORT void rcu_raycast_manager_trace_reflection_paths(RCURaycastManagerObject* raycastManager, float* emitterDataArray, int* endpointDataArray, uint32_t numPaths, uint32_t maxBounces, float minEnergy);
+
+	// Function to estimate the ambient visibility (1 is fully open) of points given as position and normal, one float is written per point
+	RCU_EXPORT void rcu_raycast_manager_ambient_occlusion(RCURaycastManagerObject* raycastManager, float* pointDataArray, float* visibilityArray, uint32_t numPoints, uint32_t numSamples, float radius, uint32_t mask);
+
+	// Function to bake the visibility of the lights from every lightmap texel of a geometry, one width x height float plane is written per light
+	RCU_EXPORT void rcu_raycast_manager_bake_visibility(RCURaycastManagerObject* raycastManager, uint32_t geometryIdx, uint32_t width, uint32_t height, float* lightDataArray, uint32_t numLights, uint32_t mask, float* atlas);
+
+	// Function to test the visibility between every source and every target (positions as 3 floats), one row of (numTargets + 31) / 32
+	// words is written per source and bit j of a row is set if target j is visible. A null targetDataArray tests the sources against each other.
+	RCU_EXPORT void rcu_raycast_manager_line_of_sight(RCURaycastManagerObject* raycastManager, float* sourceDataArray, uint32_t numSources, float* targetDataArray, uint32_t numTargets, uint32_t mask, uint32_t* bitMatrix);
+
+	// Function to sample the distance field at points (3 floats each), a distance and its error bound are written per point
+	RCU_EXPORT void rcu_raycast_manager_distance_samples(RCURaycastManagerObject* raycastManager, float* pointDataArray, float* sampleDataArray, uint32_t numPoints);
+
+	// Function to sphere trace rays through the distance field, one distance hit is written per ray
+	RCU_EXPORT void rcu_raycast_manager_approximate_raycasts(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* hitDataArray, uint32_t numRays);
+
+	// Function to bake the potentially visible set of a grid of cells, origin and cellSize are 3 floats and resolution 3 uints
+	RCU_EXPORT void rcu_raycast_manager_bake_visibility_grid(RCURaycastManagerObject* raycastManager, float* originData, float* cellSizeData, uint32_t* resolution, uint32_t numSamples, uint32_t mask);
+
+	// Function to look up the baked state of a pair of cells (unknown, hidden, visible or partial)
+	RCU_EXPORT uint32_t rcu_raycast_manager_cell_visibility(RCURaycastManagerObject* raycastManager, uint32_t cellA, uint32_t cellB);
+
+	// Function to test the visibility of segments (sources and targets as 3 floats), one byte is written per segment. Only the segments
+	// whose cells are baked as visible skip the tracing, every segment is traced if mask is not the one of the bake.
+	RCU_EXPORT void rcu_raycast_manager_potential_visibility(RCURaycastManagerObject* raycastManager, float* sourceDataArray, float* targetDataArray, uint32_t numPairs, uint32_t mask, uint8_t* visibleArray);
+
+	// Function to switch to a tiled world whose resident tiles fit in memoryBudget bytes, the previous tiles are dropped
+	RCU_EXPORT void rcu_raycast_manager_setup_world(RCURaycastManagerObject* raycastManager, uint64_t memoryBudget);
+
+	// Function to drop the tiles of the world, rcu_raycast_manager_release only releases the scene
+	RCU_EXPORT void rcu_raycast_manager_release_world(RCURaycastManagerObject* raycastManager);
+
+	// Function to declare a tile with its bounds (min and max as 3 floats each) and either a scene or the path of a tile cache file
+	RCU_EXPORT uint32_t rcu_raycast_manager_add_world_tile(RCURaycastManagerObject* raycastManager, float* boundsData, RCUSceneObject* scene, const char* cachePath);
+
+	// Functions to load tiles in the background (one tile or the tiles overlapping a sphere), to unload a tile and to query its status.
+	// Requesting or evicting a failed tile resets it.
+	RCU_EXPORT void rcu_raycast_manager_request_world_tile(RCURaycastManagerObject* raycastManager, uint32_t tileIdx);
+	RCU_EXPORT void rcu_raycast_manager_request_world_region(RCURaycastManagerObject* raycastManager, float* centerData, float radius);
+	RCU_EXPORT void rcu_raycast_manager_evict_world_tile(RCURaycastManagerObject* raycastManager, uint32_t tileIdx);
+	RCU_EXPORT uint32_t rcu_raycast_manager_world_tile_status(RCURaycastManagerObject* raycastManager, uint32_t tileIdx);
+
+	// Function to trace rays through the resident tiles, the tile of every ray is written in tileArray (see the world tile constants)
+	RCU_EXPORT void rcu_raycast_manager_run_world(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* intersectionDataArray, uint32_t* tileArray, uint32_t numRays);
+
 	// Function to release a scene from the raycast manager
 	RCU_EXPORT void rcu_raycast_manager_release(RCURaycastManagerObject* raycastManager);
 
 	RCU_EXPORT void rcu_raycast_manager_run(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* intersectionDataArray, uint32_t numRays);
 
+	// Function to let rcu_raycast_manager_run reuse the intersections of the rays cast again against unchanged geometries, capacity 0 disables it.
+	// Rays that only differ by less than quantum may share their intersection, 0 only matches identical rays.
+	RCU_EXPORT void rcu_raycast_manager_enable_result_cache(RCURaycastManagerObject* raycastManager, uint32_t capacity, float quantum);
+
+	// Function to throw rays and only output the hits, returns the number of hits written
+	RCU_EXPORT uint32_t rcu_raycast_manager_run_compact(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* hitDataArray, uint32_t numRays);
+
+	// Function to throw rays and write the attributes at the given byte offsets (-1 to skip, see rcu::IntersectionAttribute) of each stride-sized record
+	RCU_EXPORT uint32_t rcu_raycast_manager_run_layout(RCURaycastManagerObject* raycastManager, float* rayArrayData, void* outputData, uint32_t stride, const int32_t* attributeOffsets, int hitsOnly, uint32_t numRays);
+
+	// Function to throw rays with a kernel specialized for the attribute mask and packet width (1, 4, 8 or 16)
+	RCU_EXPORT void rcu_raycast_manager_run_specialized(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* intersectionDataArray, uint32_t numRays, uint32_t attributeMask, uint32_t packetWidth);
+
+	// Function to collect up to maxHits sorted intersections per ray, intersectionDataArray holds numRays * maxHits intersections, needs enable_multi_hit before the setup
+	RCU_EXPORT void rcu_raycast_manager_run_multi_hit(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* intersectionDataArray, uint32_t* hitCountArray, uint32_t numRays, uint32_t maxHits);
+
+	// Function to find the closest surface point of each query (position + max distance)
+	RCU_EXPORT void rcu_raycast_manager_closest_points(RCURaycastManagerObject* raycastManager, float* queryDataArray, int* resultDataArray, uint32_t numQueries);
+
+	// Functions to list the triangles (mode 0) or geometries (mode 1) touching boxes (min + max) or spheres (center + radius), returns the total overlap count
+	RCU_EXPORT uint32_t rcu_raycast_manager_overlap_boxes(RCURaycastManagerObject* raycastManager, float* queryDataArray, uint32_t numQueries, uint32_t mode, uint32_t* overlapDataArray, uint32_t capacity);
+	RCU_EXPORT uint32_t rcu_raycast_manager_overlap_spheres(RCURaycastManagerObject* raycastManager, float* queryDataArray, uint32_t numQueries, uint32_t mode, uint32_t* overlapDataArray, uint32_t capacity);
+
+	// Functions to sweep spheres (origin, direction, radius, max distance) or capsules (point a, point b, direction, radius, max distance) against the scene
+	RCU_EXPORT void rcu_raycast_manager_sphere_casts(RCURaycastManagerObject* raycastManager, float* castDataArray, int* hitDataArray, uint32_t numCasts);
+	RCU_EXPORT void rcu_raycast_manager_capsule_casts(RCURaycastManagerObject* raycastManager, float* castDataArray, int* hitDataArray, uint32_t numCasts);
+
+	// Function to only run the traversal and output a minimal hit record per ray
+	RCU_EXPORT void rcu_raycast_manager_run_records(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* recordDataArray, uint32_t numRays);
+
+	// Function to resolve a subset of hit records into intersections (indexArray can be null)
+	RCU_EXPORT void rcu_raycast_manager_resolve(RCURaycastManagerObject* raycastManager, int* recordDataArray, uint32_t* indexArray, uint32_t numIndices, uint32_t attributeMask, int* intersectionDataArray);
+
+	// Function to interpolate the custom vertex attributes of a subset of hit records (indexArray can be null)
+	RCU_EXPORT void rcu_raycast_manager_resolve_attributes(RCURaycastManagerObject* raycastManager, int* recordDataArray, uint32_t* indexArray, uint32_t numIndices, float* attributeDataArray, uint32_t numComponents);
+
 	// Function to destroy a rcu raycast manager
 	RCU_EXPORT void rcu_destroy_raycast_manager(RCURaycastManagerObject* raycastManager);
 }
\ No newline at end of file
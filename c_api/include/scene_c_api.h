@@ -8,7 +8,40 @@ extern "C"
 	RCU_EXPORT RCUSceneObject* rcu_create_scene(RCUAllocatorObject* allocator);
 
 	// Function to push a new object to the scene
-	RCU_EXPORT void rcu_scene_append_geometry(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, int32_t numTriangles, float* transformMatrix);
+	RCU_EXPORT void rcu_scene_append_geometry(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, int32_t numTriangles, float* transformMatrix, uint32_t layerMask);
+
+	// Function to push a mesh that keeps its local space data and can be moved after the setup through rcu_scene_set_geometry_transform
+	RCU_EXPORT void rcu_scene_append_instanced_geometry(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, int32_t numTriangles, float* transformMatrix, uint32_t layerMask);
+
+	// Function to change the transform of an instanced geometry
+	RCU_EXPORT void rcu_scene_set_geometry_transform(RCUSceneObject* scene, uint32_t geometryIdx, float* transformMatrix);
+
+	// Function to push a quad mesh, the quads are traced natively and reported as two triangles (q0, q1, q3) and (q2, q3, q1)
+	RCU_EXPORT void rcu_scene_append_quad_geometry(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* quadIndexArray, int32_t numQuads, float* transformMatrix, uint32_t layerMask);
+
+	// Function to push an analytic sphere, capsule or box, the parameters are 3 floats
+	RCU_EXPORT void rcu_scene_append_primitive(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, uint32_t primitiveType, float* parameters, float* transformMatrix, uint32_t layerMask);
+
+	// Function to flag a geometry whose vertices will be updated after the setup (refit instead of rebuild)
+	RCU_EXPORT void rcu_scene_set_geometry_deformable(RCUSceneObject* scene, uint32_t geometryIdx, int deformable);
+
+	// Function to overwrite the vertices of a deformable geometry, normalArray can be null to keep the normals
+	RCU_EXPORT void rcu_scene_update_geometry_vertices(RCUSceneObject* scene, uint32_t geometryIdx, float* positionArray, float* normalArray, float* transformMatrix);
+
+	// Function to set the fraction of the energy kept by the reflection paths bouncing on a geometry or a primitive
+	RCU_EXPORT void rcu_scene_set_geometry_reflection(RCUSceneObject* scene, uint32_t geometryIdx, float reflectionCoefficient);
+	RCU_EXPORT void rcu_scene_set_primitive_reflection(RCUSceneObject* scene, uint32_t primitiveIdx, float reflectionCoefficient);
+
+	// Function to attach custom per-vertex attributes to a previously appended geometry
+	RCU_EXPORT void rcu_scene_set_geometry_attributes(RCUSceneObject* scene, uint32_t geometryIdx, float* attributeArray, uint32_t numComponents);
+
+	// Function to store the normals and texture coordinates of a geometry (or of all the non deformable ones) in a compressed form,
+	// must be called before the setup
+	RCU_EXPORT void rcu_scene_pack_geometry_attributes(RCUSceneObject* scene, uint32_t geometryIdx);
+	RCU_EXPORT void rcu_scene_pack_attributes(RCUSceneObject* scene);
+
+	// Function to write the content of a scene in a tile cache file that the tiled world can load on demand, returns 0 on failure
+	RCU_EXPORT int rcu_scene_write_tile_cache(RCUSceneObject* scene, const char* path);
 
 	// Function to destroy a rcu scene
 	RCU_EXPORT void rcu_destroy_scene(RCUSceneObject* scene);
@@ -26,6 +26,206 @@ void rcu_raycast_manager_setup(RCURaycastManagerObject* raycastManager, RCUScene
 
 }
 
+void rcu_raycast_manager_setup_async(RCURaycastManagerObject* raycastManager, RCUSceneObject* scene)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	raycastManagerPtr->setup_async(*scenePtr);
+}
+
+void rcu_raycast_manager_cancel_setup(RCURaycastManagerObject* raycastManager)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->cancel_setup();
+}
+
+int rcu_raycast_manager_setup_status(RCURaycastManagerObject* raycastManager)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	return (int)raycastManagerPtr->setup_status();
+}
+
+float rcu_raycast_manager_setup_progress(RCURaycastManagerObject* raycastManager)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	return raycastManagerPtr->setup_progress();
+}
+
+void rcu_raycast_manager_enable_spatial_queries(RCURaycastManagerObject* raycastManager, int enabled)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->enable_spatial_queries(enabled != 0);
+}
+
+void rcu_raycast_manager_enable_multi_hit(RCURaycastManagerObject* raycastManager, int enabled)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->enable_multi_hit(enabled != 0);
+}
+
+void rcu_raycast_manager_enable_occupancy_culling(RCURaycastManagerObject* raycastManager, float voxelSize, uint64_t memoryBudget)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->enable_occupancy_culling(voxelSize, memoryBudget);
+}
+
+void rcu_raycast_manager_enable_distance_field(RCURaycastManagerObject* raycastManager, float voxelSize, uint64_t memoryBudget)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->enable_distance_field(voxelSize, memoryBudget);
+}
+
+void rcu_raycast_manager_enable_geometry_merging(RCURaycastManagerObject* raycastManager, uint32_t maxTriangles)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->enable_geometry_merging(maxTriangles);
+}
+
+void rcu_raycast_manager_update_geometry(RCURaycastManagerObject* raycastManager, uint32_t geometryIdx)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->update_geometry(geometryIdx);
+}
+
+void rcu_raycast_manager_update_geometry_transform(RCURaycastManagerObject* raycastManager, uint32_t geometryIdx)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->update_geometry_transform(geometryIdx);
+}
+
+void rcu_raycast_manager_trace_reflection_paths(RCURaycastManagerObject* raycastManager, float* emitterDataArray, int* endpointDataArray, uint32_t numPaths, uint32_t maxBounces, float minEnergy)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->trace_reflection_paths((rcu::TRay*)emitterDataArray, (rcu::TPathEndpoint*)endpointDataArray, numPaths, maxBounces, minEnergy);
+}
+
+void rcu_raycast_manager_ambient_occlusion(RCURaycastManagerObject* raycastManager, float* pointDataArray, float* visibilityArray, uint32_t numPoints, uint32_t numSamples, float radius, uint32_t mask)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->ambient_occlusion((rcu::TOcclusionPoint*)pointDataArray, visibilityArray, numPoints, numSamples, radius, mask);
+}
+
+void rcu_raycast_manager_bake_visibility(RCURaycastManagerObject* raycastManager, uint32_t geometryIdx, uint32_t width, uint32_t height, float* lightDataArray, uint32_t numLights, uint32_t mask, float* atlas)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->bake_visibility(geometryIdx, width, height, (rcu::TBakeLight*)lightDataArray, numLights, mask, atlas);
+}
+
+void rcu_raycast_manager_line_of_sight(RCURaycastManagerObject* raycastManager, float* sourceDataArray, uint32_t numSources, float* targetDataArray, uint32_t numTargets, uint32_t mask, uint32_t* bitMatrix)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->line_of_sight((bento::Vector3*)sourceDataArray, numSources, (bento::Vector3*)targetDataArray, numTargets, mask, bitMatrix);
+}
+
+void rcu_raycast_manager_distance_samples(RCURaycastManagerObject* raycastManager, float* pointDataArray, float* sampleDataArray, uint32_t numPoints)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->distance_samples((bento::Vector3*)pointDataArray, (rcu::TDistanceSample*)sampleDataArray, numPoints);
+}
+
+void rcu_raycast_manager_approximate_raycasts(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* hitDataArray, uint32_t numRays)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->approximate_raycasts((rcu::TRay*)rayArrayData, (rcu::TDistanceHit*)hitDataArray, numRays);
+}
+
+void rcu_raycast_manager_bake_visibility_grid(RCURaycastManagerObject* raycastManager, float* originData, float* cellSizeData, uint32_t* resolution, uint32_t numSamples, uint32_t mask)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->bake_visibility_grid(*(bento::Vector3*)originData, *(bento::Vector3*)cellSizeData, resolution, numSamples, mask);
+}
+
+uint32_t rcu_raycast_manager_cell_visibility(RCURaycastManagerObject* raycastManager, uint32_t cellA, uint32_t cellB)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	return raycastManagerPtr->cell_visibility(cellA, cellB);
+}
+
+void rcu_raycast_manager_potential_visibility(RCURaycastManagerObject* raycastManager, float* sourceDataArray, float* targetDataArray, uint32_t numPairs, uint32_t mask, uint8_t* visibleArray)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->potential_visibility((bento::Vector3*)sourceDataArray, (bento::Vector3*)targetDataArray, numPairs, mask, visibleArray);
+}
+
+void rcu_raycast_manager_setup_world(RCURaycastManagerObject* raycastManager, uint64_t memoryBudget)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->setup_world(memoryBudget);
+}
+
+void rcu_raycast_manager_release_world(RCURaycastManagerObject* raycastManager)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->release_world();
+}
+
+uint32_t rcu_raycast_manager_add_world_tile(RCURaycastManagerObject* raycastManager, float* boundsData, RCUSceneObject* scene, const char* cachePath)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	assert_msg(scene != nullptr || cachePath != nullptr, "The tile has no content");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	const bento::Vector3* bounds = (const bento::Vector3*)boundsData;
+	return raycastManagerPtr->add_world_tile(bounds[0], bounds[1], (rcu::TScene*)scene, cachePath);
+}
+
+void rcu_raycast_manager_request_world_tile(RCURaycastManagerObject* raycastManager, uint32_t tileIdx)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->request_world_tile(tileIdx);
+}
+
+void rcu_raycast_manager_request_world_region(RCURaycastManagerObject* raycastManager, float* centerData, float radius)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->request_world_region(*(bento::Vector3*)centerData, radius);
+}
+
+void rcu_raycast_manager_evict_world_tile(RCURaycastManagerObject* raycastManager, uint32_t tileIdx)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->evict_world_tile(tileIdx);
+}
+
+uint32_t rcu_raycast_manager_world_tile_status(RCURaycastManagerObject* raycastManager, uint32_t tileIdx)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	return raycastManagerPtr->world_tile_status(tileIdx);
+}
+
+void rcu_raycast_manager_run_world(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* intersectionDataArray, uint32_t* tileArray, uint32_t numRays)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->run_world((rcu::TRay*)rayArrayData, (rcu::TIntersection*)intersectionDataArray, tileArray, numRays);
+}
+
 void rcu_raycast_manager_release(RCURaycastManagerObject* raycastManager)
 {
 	assert_msg(raycastManager != nullptr, "RaycastManager was null");
@@ -40,6 +240,103 @@ void rcu_raycast_manager_run(RCURaycastManagerObject* raycastManager, float* ray
 	raycastManagerPtr->run((rcu::TRay*)rayArrayData, (rcu::TIntersection*)intersectionDataArray, numRays);
 }
 
+void rcu_raycast_manager_enable_result_cache(RCURaycastManagerObject* raycastManager, uint32_t capacity, float quantum)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->enable_result_cache(capacity, quantum);
+}
+
+uint32_t rcu_raycast_manager_run_compact(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* hitDataArray, uint32_t numRays)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	return raycastManagerPtr->run_compact((rcu::TRay*)rayArrayData, (rcu::TCompactHit*)hitDataArray, numRays);
+}
+
+uint32_t rcu_raycast_manager_run_layout(RCURaycastManagerObject* raycastManager, float* rayArrayData, void* outputData, uint32_t stride, const int32_t* attributeOffsets, int hitsOnly, uint32_t numRays)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	assert_msg(outputData != nullptr, "Output data was null");
+	assert_msg(attributeOffsets != nullptr, "Attribute offsets were null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+
+	rcu::TOutputLayout layout;
+	rcu::init_output_layout(layout, outputData, stride, hitsOnly != 0);
+	memcpy(layout.offsets, attributeOffsets, sizeof(int32_t) * rcu::IntersectionAttribute::Count);
+	return raycastManagerPtr->run_layout((rcu::TRay*)rayArrayData, layout, numRays);
+}
+
+void rcu_raycast_manager_run_specialized(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* intersectionDataArray, uint32_t numRays, uint32_t attributeMask, uint32_t packetWidth)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->run_specialized((rcu::TRay*)rayArrayData, (rcu::TIntersection*)intersectionDataArray, numRays, attributeMask, packetWidth);
+}
+
+void rcu_raycast_manager_run_multi_hit(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* intersectionDataArray, uint32_t* hitCountArray, uint32_t numRays, uint32_t maxHits)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->run_multi_hit((rcu::TRay*)rayArrayData, (rcu::TIntersection*)intersectionDataArray, hitCountArray, numRays, maxHits);
+}
+
+void rcu_raycast_manager_closest_points(RCURaycastManagerObject* raycastManager, float* queryDataArray, int* resultDataArray, uint32_t numQueries)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->closest_points((rcu::TPointQuery*)queryDataArray, (rcu::TClosestPoint*)resultDataArray, numQueries);
+}
+
+uint32_t rcu_raycast_manager_overlap_boxes(RCURaycastManagerObject* raycastManager, float* queryDataArray, uint32_t numQueries, uint32_t mode, uint32_t* overlapDataArray, uint32_t capacity)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	return raycastManagerPtr->overlap_boxes((rcu::TBoxQuery*)queryDataArray, numQueries, (rcu::OverlapMode::Type)mode, (rcu::TOverlap*)overlapDataArray, capacity);
+}
+
+uint32_t rcu_raycast_manager_overlap_spheres(RCURaycastManagerObject* raycastManager, float* queryDataArray, uint32_t numQueries, uint32_t mode, uint32_t* overlapDataArray, uint32_t capacity)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	return raycastManagerPtr->overlap_spheres((rcu::TSphereQuery*)queryDataArray, numQueries, (rcu::OverlapMode::Type)mode, (rcu::TOverlap*)overlapDataArray, capacity);
+}
+
+void rcu_raycast_manager_sphere_casts(RCURaycastManagerObject* raycastManager, float* castDataArray, int* hitDataArray, uint32_t numCasts)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->sphere_casts((rcu::TSphereCast*)castDataArray, (rcu::TShapeHit*)hitDataArray, numCasts);
+}
+
+void rcu_raycast_manager_capsule_casts(RCURaycastManagerObject* raycastManager, float* castDataArray, int* hitDataArray, uint32_t numCasts)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->capsule_casts((rcu::TCapsuleCast*)castDataArray, (rcu::TShapeHit*)hitDataArray, numCasts);
+}
+
+void rcu_raycast_manager_run_records(RCURaycastManagerObject* raycastManager, float* rayArrayData, int* recordDataArray, uint32_t numRays)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->run_records((rcu::TRay*)rayArrayData, (rcu::THitRecord*)recordDataArray, numRays);
+}
+
+void rcu_raycast_manager_resolve(RCURaycastManagerObject* raycastManager, int* recordDataArray, uint32_t* indexArray, uint32_t numIndices, uint32_t attributeMask, int* intersectionDataArray)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->resolve((rcu::THitRecord*)recordDataArray, indexArray, numIndices, attributeMask, (rcu::TIntersection*)intersectionDataArray);
+}
+
+void rcu_raycast_manager_resolve_attributes(RCURaycastManagerObject* raycastManager, int* recordDataArray, uint32_t* indexArray, uint32_t numIndices, float* attributeDataArray, uint32_t numComponents)
+{
+	assert_msg(raycastManager != nullptr, "RaycastManager was null");
+	rcu::TRaycastManager* raycastManagerPtr = (rcu::TRaycastManager*)raycastManager;
+	raycastManagerPtr->resolve_attributes((rcu::THitRecord*)recordDataArray, indexArray, numIndices, attributeDataArray, numComponents);
+}
+
 void rcu_destroy_raycast_manager(RCURaycastManagerObject* raycastManager)
 {
 	assert_msg(raycastManager != nullptr, "RaycastManager was null");
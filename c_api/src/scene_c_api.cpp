@@ -5,6 +5,7 @@
 
 // Internal includes
 #include "rcu_model/scene.h"
+#include "rcu_model/tile_cache.h"
 #include "scene_c_api.h"
 
 static bento::SystemAllocator _base_allocator;
@@ -17,11 +18,97 @@ RCUSceneObject* rcu_create_scene(RCUAllocatorObject* allocator)
 	return (RCUSceneObject*) newScene;
 }
 
-void rcu_scene_append_geometry(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, int32_t numTriangles, float* transformMatrix)
+void rcu_scene_append_geometry(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, int32_t numTriangles, float* transformMatrix, uint32_t layerMask)
 {
 	assert_msg(scene != nullptr, "Scene was null");
 	rcu::TScene* scenePtr = (rcu::TScene*)scene;
-	rcu::append_geometry(*scenePtr, geoID, submeshID, positionArray, normalArray, texCoordArray, numVerts, indexArray, numTriangles, transformMatrix);
+	rcu::append_geometry(*scenePtr, geoID, submeshID, positionArray, normalArray, texCoordArray, numVerts, indexArray, numTriangles, transformMatrix, layerMask);
+}
+
+void rcu_scene_append_instanced_geometry(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, int32_t numTriangles, float* transformMatrix, uint32_t layerMask)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::append_instanced_geometry(*scenePtr, geoID, submeshID, positionArray, normalArray, texCoordArray, numVerts, indexArray, numTriangles, transformMatrix, layerMask);
+}
+
+void rcu_scene_set_geometry_transform(RCUSceneObject* scene, uint32_t geometryIdx, float* transformMatrix)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::set_geometry_transform(*scenePtr, geometryIdx, transformMatrix);
+}
+
+void rcu_scene_append_quad_geometry(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* quadIndexArray, int32_t numQuads, float* transformMatrix, uint32_t layerMask)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::append_quad_geometry(*scenePtr, geoID, submeshID, positionArray, normalArray, texCoordArray, numVerts, quadIndexArray, numQuads, transformMatrix, layerMask);
+}
+
+void rcu_scene_append_primitive(RCUSceneObject* scene, uint32_t geoID, uint32_t submeshID, uint32_t primitiveType, float* parameters, float* transformMatrix, uint32_t layerMask)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	assert_msg(primitiveType <= rcu::PrimitiveType::Box, "Unknown primitive type");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::append_primitive(*scenePtr, geoID, submeshID, (rcu::PrimitiveType::Type)primitiveType, parameters, transformMatrix, layerMask);
+}
+
+void rcu_scene_set_geometry_deformable(RCUSceneObject* scene, uint32_t geometryIdx, int deformable)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::set_geometry_deformable(*scenePtr, geometryIdx, deformable != 0);
+}
+
+void rcu_scene_update_geometry_vertices(RCUSceneObject* scene, uint32_t geometryIdx, float* positionArray, float* normalArray, float* transformMatrix)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::update_geometry_vertices(*scenePtr, geometryIdx, positionArray, normalArray, transformMatrix);
+}
+
+void rcu_scene_set_geometry_reflection(RCUSceneObject* scene, uint32_t geometryIdx, float reflectionCoefficient)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::set_geometry_reflection(*scenePtr, geometryIdx, reflectionCoefficient);
+}
+
+void rcu_scene_set_primitive_reflection(RCUSceneObject* scene, uint32_t primitiveIdx, float reflectionCoefficient)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::set_primitive_reflection(*scenePtr, primitiveIdx, reflectionCoefficient);
+}
+
+void rcu_scene_set_geometry_attributes(RCUSceneObject* scene, uint32_t geometryIdx, float* attributeArray, uint32_t numComponents)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::set_geometry_attributes(*scenePtr, geometryIdx, attributeArray, numComponents);
+}
+
+void rcu_scene_pack_geometry_attributes(RCUSceneObject* scene, uint32_t geometryIdx)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::pack_geometry_attributes(*scenePtr, geometryIdx);
+}
+
+void rcu_scene_pack_attributes(RCUSceneObject* scene)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	rcu::pack_scene_attributes(*scenePtr);
+}
+
+int rcu_scene_write_tile_cache(RCUSceneObject* scene, const char* path)
+{
+	assert_msg(scene != nullptr, "Scene was null");
+	assert_msg(path != nullptr, "Path was null");
+	rcu::TScene* scenePtr = (rcu::TScene*)scene;
+	return rcu::write_tile_cache(*scenePtr, path) ? 1 : 0;
 }
 
 void rcu_destroy_scene(RCUSceneObject* scene)
@@ -13,18 +13,58 @@ namespace rcu
 	{
 		ALLOCATOR_BASED;
 		TGeometry(bento::IAllocator& allocator)
-		: vertexArray(allocator)
+		: layerMask(0xffffffff)
+		, quadTopology(false)
+		, deformable(false)
+		, instanced(false)
+		, reflectionCoefficient(1.0f)
+		, vertexArray(allocator)
 		, normalArray(allocator)
 		, texCoordArray(allocator)
+		, packedAttributes(false)
+		, packedNormalArray(allocator)
+		, packedTexCoordArray(allocator)
 		, indexArray(allocator)
+		, numAttributeComponents(0)
+		, attributeArray(allocator)
 		{
 
 		}
 		uint32_t gameObjectID;
 		uint32_t subMeshID;
+
+		// Rays only see the geometries that share a bit with their mask
+		uint32_t layerMask;
+
+		// The triangles come in pairs (v0, v1, v3) (v2, v3, v1) that embree traces as quads
+		bool quadTopology;
+
+		// The vertices can be updated after the setup, embree refits the hierarchy of the geometry instead of rebuilding it
+		bool deformable;
+
+		// The vertices and normals are kept in local space and traced through an embree instance, moving the geometry
+		// only changes the transform. normalMatrix is the inverse transpose of the transform.
+		bool instanced;
+		bento::Matrix4 transform;
+		bento::Matrix4 normalMatrix;
+
+		// Fraction of the energy kept by the reflection paths bouncing on the geometry
+		float reflectionCoefficient;
+
 		bento::Vector<bento::Vector3> vertexArray;
 		bento::Vector<bento::Vector3> normalArray;
 		bento::Vector<bento::Vector2> texCoordArray;
+
+		// Compressed normals (octahedral, 2x16 bits) and texture coordinates (2 half floats) that replace normalArray and texCoordArray
+		// once the geometry is packed, read them through vertex_normal and vertex_tex_coord
+		bool packedAttributes;
+		bento::Vector<uint32_t> packedNormalArray;
+		bento::Vector<uint32_t> packedTexCoordArray;
+
 		bento::Vector<bento::IVector3> indexArray;
+
+		// Optional custom per-vertex attributes, numAttributeComponents floats per vertex
+		uint32_t numAttributeComponents;
+		bento::Vector<float> attributeArray;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+// SDK includes
+#include "rcu_model/geometry_instance.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+#include <bento_math/vector2.h>
+
+// External includes
+#include <math.h>
+#include <string.h>
+
+namespace rcu
+{
+	// 2^112, moves the exponent of a half float shifted in a float to the float bias
+	#define RCU_HALF_EXPONENT_SCALE 5.192296858534828e+33f
+
+	// Octahedral mapping of a unit vector, 16 bits per coordinate (x in the low bits)
+	inline uint32_t encode_octahedral(const bento::Vector3& normal)
+	{
+		float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+		if (l1 == 0.0f)
+			return 0x7fff7fff;
+		float x = normal.x / l1;
+		float y = normal.y / l1;
+
+		// The lower hemisphere is folded over the diagonals
+		if (normal.z < 0.0f)
+		{
+			float foldedX = copysignf(1.0f - fabsf(y), x);
+			y = copysignf(1.0f - fabsf(x), y);
+			x = foldedX;
+		}
+		uint32_t qx = (uint32_t)lrintf((x * 0.5f + 0.5f) * 65535.0f);
+		uint32_t qy = (uint32_t)lrintf((y * 0.5f + 0.5f) * 65535.0f);
+		return qx | (qy << 16);
+	}
+
+	inline bento::Vector3 decode_octahedral(uint32_t packed)
+	{
+		float x = (float)(packed & 0xffff) * (2.0f / 65535.0f) - 1.0f;
+		float y = (float)(packed >> 16) * (2.0f / 65535.0f) - 1.0f;
+		float z = 1.0f - fabsf(x) - fabsf(y);
+		float t = fmaxf(-z, 0.0f);
+		x -= copysignf(t, x);
+		y -= copysignf(t, y);
+		float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+		return bento::vector3(x * invLength, y * invLength, z * invLength);
+	}
+
+	// Round to nearest, the values out of range are clamped to the largest half
+	inline uint16_t float_to_half(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		uint32_t sign = (bits >> 16) & 0x8000;
+		uint32_t magnitude = bits & 0x7fffffff;
+		if (!(magnitude <= 0x477fe000))
+			return (uint16_t)(sign | 0x7bff);
+		if (magnitude < 0x38800000)
+			return (uint16_t)(sign | (uint32_t)lrintf(fabsf(value) * 16777216.0f));
+		return (uint16_t)(sign | ((magnitude - 0x38000000 + 0xfff + ((magnitude >> 13) & 1)) >> 13));
+	}
+
+	inline float half_to_float(uint16_t half)
+	{
+		uint32_t bits = (uint32_t)(half & 0x7fff) << 13;
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		value *= RCU_HALF_EXPONENT_SCALE;
+		return (half & 0x8000) != 0 ? -value : value;
+	}
+
+	// Two half floats, x in the low bits
+	inline uint32_t encode_half2(const bento::Vector2& value)
+	{
+		return (uint32_t)float_to_half(value.x) | ((uint32_t)float_to_half(value.y) << 16);
+	}
+
+	inline bento::Vector2 decode_half2(uint32_t packed)
+	{
+		return bento::vector2(half_to_float((uint16_t)(packed & 0xffff)), half_to_float((uint16_t)(packed >> 16)));
+	}
+
+	// Per vertex attributes of a geometry, whatever their storage
+	inline bento::Vector3 vertex_normal(const TGeometry& geometry, uint32_t vertexIdx)
+	{
+		return geometry.packedAttributes ? decode_octahedral(geometry.packedNormalArray[vertexIdx]) : geometry.normalArray[vertexIdx];
+	}
+
+	inline bento::Vector2 vertex_tex_coord(const TGeometry& geometry, uint32_t vertexIdx)
+	{
+		return geometry.packedAttributes ? decode_half2(geometry.packedTexCoordArray[vertexIdx]) : geometry.texCoordArray[vertexIdx];
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// Bento includes
+#include <bento_math/types.h>
+
+// External includes
+#include <stdint.h>
+
+namespace rcu
+{
+	namespace PrimitiveType
+	{
+		enum Type
+		{
+			// Radius in parameters.x
+			Sphere = 0,
+			// Radius in parameters.x, half height of the segment along the local Y axis in parameters.y
+			Capsule = 1,
+			// Half extents in parameters
+			Box = 2
+		};
+	}
+
+	// Parts of the primitives, reported in place of the triangle index
+	namespace PrimitivePart
+	{
+		enum Type
+		{
+			// Sphere surface, capsule cylinder
+			Body = 0,
+			// Capsule caps
+			BottomCap = 1,
+			TopCap = 2,
+			// Box faces, -X, +X, -Y, +Y, -Z, +Z
+			FirstFace = 0
+		};
+	}
+
+	// Number of bits of the embree primitive index used to store the part
+	#define RCU_PRIMITIVE_PART_BITS 3
+
+	// Analytic shape intersected without tessellation
+	struct TPrimitive
+	{
+		uint32_t gameObjectID;
+		uint32_t subMeshID;
+		uint32_t layerMask;
+		PrimitiveType::Type type;
+		bento::Vector3 parameters;
+
+		// Local to world transform and its inverse
+		bento::Matrix4 transform;
+		bento::Matrix4 inverseTransform;
+
+		// Fraction of the energy kept by the reflection paths bouncing on the primitive
+		float reflectionCoefficient;
+	};
+
+	// Intersects a world space ray with the primitive, u and v receive the surface parameters of the hit part
+	bool intersect_primitive(const TPrimitive& primitive, const bento::Vector3& origin, const bento::Vector3& direction, float tnear, float tfar, float& t, uint32_t& part, float& u, float& v);
+
+	// Rebuilds the world space position, normal and texture coordinate of a hit from its part and surface parameters
+	void evaluate_primitive(const TPrimitive& primitive, uint32_t part, float u, float v, bento::Vector3& position, bento::Vector3& normal, bento::Vector2& texCoord);
+
+	// World space bounds of the primitive
+	void primitive_bounds(const TPrimitive& primitive, bento::Vector3& minBound, bento::Vector3& maxBound);
+}
@@ -2,6 +2,8 @@
 
 // SDK includes
 #include "rcu_model/geometry_instance.h"
+#include "rcu_model/packed_attributes.h"
+#include "rcu_model/primitive.h"
 
 // bento includes
 #include <bento_collection/dynamic_string.h>
@@ -19,8 +21,55 @@ namespace rcu
 		// Scene Data
 		bento::DynamicString sceneName;
 		bento::Vector<TGeometry> geometryArray;
+		bento::Vector<TPrimitive> primitiveArray;
 	};
 
+	// Embree slot shared by all the analytic primitives, it follows the meshes
+	inline uint32_t primitive_slot(const TScene& scene) { return scene.geometryArray.size(); }
+
+	// Number of embree slots of the scene
+	inline uint32_t scene_slot_count(const TScene& scene) { return scene.geometryArray.size() + (scene.primitiveArray.size() > 0 ? 1 : 0); }
+
 	// Function to append	
-	void append_geometry(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, uint32_t numTriangles, const float* transformMatrix);
+	void append_geometry(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, uint32_t numTriangles, const float* transformMatrix, uint32_t layerMask = 0xffffffff);
+
+	// Function to append a quad mesh, every quad (v0, v1, v2, v3) is kept as the triangles (v0, v1, v3) and (v2, v3, v1)
+	void append_quad_geometry(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* quadIndexArray, uint32_t numQuads, const float* transformMatrix, uint32_t layerMask = 0xffffffff);
+
+	// Function to append a mesh that keeps its local space data, its transform can be changed after the setup with set_geometry_transform
+	void append_instanced_geometry(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, uint32_t numTriangles, const float* transformMatrix, uint32_t layerMask = 0xffffffff);
+
+	// Function to move an instanced geometry, the raycast manager only sees the change after update_geometry_transform
+	void set_geometry_transform(TScene& targetScene, uint32_t geometryIdx, const float* transformMatrix);
+
+	// Moves a local space position or normal of an instanced geometry to world space
+	bento::Vector3 instance_position(const TGeometry& geometry, const bento::Vector3& position);
+	bento::Vector3 instance_normal(const TGeometry& geometry, const bento::Vector3& normal);
+
+	// World space bounds of the current vertices of a geometry
+	void geometry_world_bounds(const TGeometry& geometry, bento::Vector3& minBound, bento::Vector3& maxBound);
+
+	// Function to append an analytic primitive (PrimitiveType), see TPrimitive for the meaning of the parameters
+	void append_primitive(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, PrimitiveType::Type type, const float* parameters, const float* transformMatrix, uint32_t layerMask = 0xffffffff);
+
+	// Function to flag a geometry whose vertices will be updated after the setup, must be called before the setup
+	void set_geometry_deformable(TScene& targetScene, uint32_t geometryIdx, bool deformable);
+
+	// Function to overwrite the vertices of a geometry with the same number of vertices, normalArray can be null to keep the normals.
+	// Instanced geometries take local space vertices and ignore the transform. The raycast manager only sees the change after update_geometry.
+	void update_geometry_vertices(TScene& targetScene, uint32_t geometryIdx, const float* positionArray, const float* normalArray, const float* transformMatrix);
+
+	// Function to set the fraction of the energy kept by the reflection paths on a geometry or a primitive (1 by default)
+	void set_geometry_reflection(TScene& targetScene, uint32_t geometryIdx, float reflectionCoefficient);
+	void set_primitive_reflection(TScene& targetScene, uint32_t primitiveIdx, float reflectionCoefficient);
+
+	// Function to replace the normals and texture coordinates of a geometry with their compressed form (see TGeometry), the
+	// deformable geometries can't be packed. Must be called before the setup.
+	void pack_geometry_attributes(TScene& targetScene, uint32_t geometryIdx);
+
+	// Function to pack the attributes of all the geometries that are not deformable
+	void pack_scene_attributes(TScene& targetScene);
+
+	// Function to attach custom per-vertex attributes (up to 16 floats per vertex) to a geometry
+	void set_geometry_attributes(TScene& targetScene, uint32_t geometryIdx, const float* attributeArray, uint32_t numComponents);
 }
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+// SDK includes
+#include "rcu_model/scene.h"
+
+namespace rcu
+{
+	// Magic number and version of the tile cache files
+	#define RCU_TILE_CACHE_MAGIC 0x54554352
+	#define RCU_TILE_CACHE_VERSION 2
+
+	// Writes the geometries and primitives of a scene in a binary file that read_tile_cache can map back. Returns false if the file
+	// could not be written.
+	bool write_tile_cache(const TScene& scene, const char* path);
+
+	// Maps a file written by write_tile_cache and appends its content to the scene. Returns false if the file can't be mapped or is not
+	// a valid cache, the scene is left untouched in that case.
+	bool read_tile_cache(const char* path, TScene& scene);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// SDK includes
+#include <rcu_raycast/scene_version.h>
+
+// bento includes
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	// Surface point around which the hemisphere is sampled, the normal does not need to be normalized
+	struct TOcclusionPoint
+	{
+		bento::Vector3 position;
+		bento::Vector3 normal;
+	};
+
+	// Traces numSamples stratified cosine-weighted rays of length radius over the hemisphere of every point with occlusion-only packets.
+	// visibilityArray receives the fraction of the rays that escaped, 1 for a fully open point and 0 for a fully occluded one.
+	void estimate_ambient_occlusion(const TSceneVersion& version, const TOcclusionPoint* pointArray, uint32_t numPoints, uint32_t numSamples, float radius, uint32_t mask, float* visibilityArray);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+// SDK includes
+#include <rcu_model/scene.h>
+
+// Bento includes
+#include <bento_collection/vector.h>
+
+namespace rcu
+{
+	namespace ResolveAttribute
+	{
+		enum Type
+		{
+			Position = 0x1,
+			Normal = 0x2,
+			TexCoord = 0x4,
+			Barycentrics = 0x8,
+			All = 0xf
+		};
+	}
+
+	// Raw traversal hits stored as a structure of arrays
+	struct THitBuffer
+	{
+		ALLOCATOR_BASED;
+		THitBuffer(bento::IAllocator& allocator);
+		void resize(uint32_t numHits);
+		uint32_t size() const { return rayIndexArray.size(); }
+
+		bento::Vector<uint32_t> rayIndexArray;
+		bento::Vector<uint32_t> geometryArray;
+		bento::Vector<uint32_t> primitiveArray;
+		bento::Vector<float> tArray;
+		bento::Vector<float> uArray;
+		bento::Vector<float> vArray;
+	};
+
+	// Interpolated attributes of a hit buffer, one channel per component
+	struct TAttributeBuffer
+	{
+		ALLOCATOR_BASED;
+		TAttributeBuffer(bento::IAllocator& allocator);
+		void resize(uint32_t numHits);
+
+		enum Channel
+		{
+			PositionX = 0, PositionY, PositionZ,
+			NormalX, NormalY, NormalZ,
+			TexCoordX, TexCoordY,
+			NumChannels
+		};
+		float* channel(uint32_t channelIdx) { return dataArray.begin() + channelIdx * numHits; }
+		const float* channel(uint32_t channelIdx) const { return dataArray.begin() + channelIdx * numHits; }
+
+		uint32_t numHits;
+		bento::Vector<float> dataArray;
+	};
+
+	// Embree parametrizes quad hits over the whole quad, this converts them to one of the two triangles kept in the geometry
+	inline void quad_hit_to_triangle(uint32_t& primID, float& u, float& v)
+	{
+		if (u + v <= 1.0f)
+		{
+			primID = 2 * primID;
+		}
+		else
+		{
+			primID = 2 * primID + 1;
+			u = 1.0f - u;
+			v = 1.0f - v;
+		}
+	}
+
+	// Inverse of quad_hit_to_triangle, used to hand the hits back to embree
+	inline void triangle_hit_to_quad(uint32_t& primID, float& u, float& v)
+	{
+		if (primID & 1)
+		{
+			u = 1.0f - u;
+			v = 1.0f - v;
+		}
+		primID = primID / 2;
+	}
+
+	// Brings a raw embree hit to the conventions of the scene
+	inline void canonical_hit(const TScene& scene, uint32_t geomID, uint32_t& primID, float& u, float& v)
+	{
+		if (geomID < scene.geometryArray.size() && scene.geometryArray[geomID].quadTopology)
+			quad_hit_to_triangle(primID, u, v);
+	}
+
+	// Game object and submesh of a hit, the reported triangle is the part for the analytic primitives
+	inline void hit_owner(const TScene& scene, uint32_t geomID, uint32_t primID, uint32_t& gameObjectID, uint32_t& subMeshID, uint32_t& triangleID)
+	{
+		if (geomID == primitive_slot(scene))
+		{
+			const TPrimitive& primitive = scene.primitiveArray[primID >> RCU_PRIMITIVE_PART_BITS];
+			gameObjectID = primitive.gameObjectID;
+			subMeshID = primitive.subMeshID;
+			triangleID = primID & ((1 << RCU_PRIMITIVE_PART_BITS) - 1);
+		}
+		else
+		{
+			const TGeometry& geometry = scene.geometryArray[geomID];
+			gameObjectID = geometry.gameObjectID;
+			subMeshID = geometry.subMeshID;
+			triangleID = primID;
+		}
+	}
+
+	// Position, normal and texCoord of a hit on an analytic primitive
+	inline void resolve_primitive_hit(const TScene& scene, uint32_t primID, float u, float v, bento::Vector3& position, bento::Vector3& normal, bento::Vector2& texCoord)
+	{
+		const TPrimitive& primitive = scene.primitiveArray[primID >> RCU_PRIMITIVE_PART_BITS];
+		evaluate_primitive(primitive, primID & ((1 << RCU_PRIMITIVE_PART_BITS) - 1), u, v, position, normal, texCoord);
+	}
+
+	// Reorders the hits so that the hits of a geometry are contiguous
+	void sort_hits_by_geometry(const THitBuffer& hits, uint32_t numGeometries, bento::Vector<uint32_t>& counterArray, THitBuffer& sortedHits);
+
+	// Interpolates the requested attributes (ResolveAttribute flags) of every hit. Uses AVX2 gathers when available.
+	void resolve_hits(const TScene& scene, const THitBuffer& hits, uint32_t attributeMask, TAttributeBuffer& attributes);
+}
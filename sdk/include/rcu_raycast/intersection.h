@@ -11,6 +11,7 @@ namespace rcu
 		bento::Vector3 direction;
 		float tmin;
 		float tmax;
+		uint32_t mask;
 	};
 
 	struct TIntersection
@@ -25,4 +26,27 @@ namespace rcu
 		bento::Vector3 normal;
 		bento::Vector2 texCoord;
 	};
+
+	// Compact record written only for the rays that hit something
+	struct TCompactHit
+	{
+		uint32_t rayIndex;
+		float t;
+		uint32_t geometryID;
+		uint32_t subMeshID;
+		uint32_t triangleID;
+		float u;
+		float v;
+	};
+
+	// Minimal traversal result that can be resolved later. geometryIndex is (uint32_t)-1 for a miss and refers to
+	// the scene the manager was querying, the record is only valid until the next scene swap.
+	struct THitRecord
+	{
+		uint32_t geometryIndex;
+		uint32_t triangleID;
+		float u;
+		float v;
+		float t;
+	};
 }
\ No newline at end of file
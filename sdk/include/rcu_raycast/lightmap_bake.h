@@ -0,0 +1,49 @@
+#pragma once
+
+// SDK includes
+#include <rcu_raycast/scene_version.h>
+
+// bento includes
+#include <bento_collection/vector.h>
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	namespace BakeLightType
+	{
+		enum Type
+		{
+			// vector is the position of the light
+			Point = 0,
+			// vector is the direction towards the light, maxDistance bounds the shadow rays
+			Directional = 1
+		};
+	}
+
+	struct TBakeLight
+	{
+		uint32_t type;
+		bento::Vector3 vector;
+		float maxDistance;
+	};
+
+	// World space surface of the texels of a geometry, filled by the UV rasterization
+	struct TTexelBuffer
+	{
+		ALLOCATOR_BASED;
+		TTexelBuffer(bento::IAllocator& allocator);
+
+		bento::Vector<bento::Vector3> positionArray;
+		bento::Vector<bento::Vector3> normalArray;
+		// Zero for the texels that no triangle covers
+		bento::Vector<uint8_t> coveredArray;
+	};
+
+	// Rasterizes the texCoordArray of a geometry into a width x height grid of texel centers (world space positions and normals)
+	void rasterize_texels(const TGeometry& geometry, uint32_t width, uint32_t height, TTexelBuffer& texels);
+
+	// Traces an occlusion ray from every covered texel to every light. The atlas holds one width x height plane per light, the
+	// texel (x, y) of light l is atlas[(l * height + y) * width + x]: 1 if the light is visible, 0 if it is occluded or behind the
+	// surface, -1 if no triangle covers the texel.
+	void bake_texel_visibility(const TSceneVersion& version, const TTexelBuffer& texels, uint32_t width, uint32_t height, const TBakeLight* lightArray, uint32_t numLights, uint32_t mask, float* atlas);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// SDK includes
+#include <rcu_raycast/scene_version.h>
+
+// bento includes
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	// Number of 32 bit words of a row of the line of sight matrix
+	inline uint32_t line_of_sight_row_words(uint32_t numTargets) { return (numTargets + 31) / 32; }
+
+	// Tests the segment between every source and every target with occlusion packets. Row i of bitMatrix starts at word
+	// i * line_of_sight_row_words(numTargets) and its bit j (word j / 32, bit j % 32) is set if target j is visible from source i.
+	// When targetArray is null the sources are tested against each other and only half of the pairs are traced.
+	void line_of_sight_matrix(const TSceneVersion& version, const bento::Vector3* sourceArray, uint32_t numSources, const bento::Vector3* targetArray, uint32_t numTargets, uint32_t mask, uint32_t* bitMatrix);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// External includes
+#include <stdint.h>
+
+namespace rcu
+{
+	namespace IntersectionAttribute
+	{
+		enum Type
+		{
+			Validity = 0,		// int32
+			Distance,			// float
+			GeometryID,			// uint32
+			SubMeshID,			// uint32
+			TriangleID,			// uint32
+			Barycentrics,		// float3
+			Position,			// float3
+			Normal,				// float3
+			TexCoord,			// float2
+			RayIndex,			// uint32
+			Count
+		};
+	}
+
+	// Describes where each requested attribute of an intersection has to be written in a caller owned buffer.
+	// The i-th record starts at base + i * stride, attributes with a negative offset are not written.
+	struct TOutputLayout
+	{
+		void* base;
+		uint32_t stride;
+		int32_t offsets[IntersectionAttribute::Count];
+
+		// When set, only the hits are written and packed at the start of the buffer
+		bool hitsOnly;
+	};
+
+	// Resets a layout so that no attribute is written
+	void init_output_layout(TOutputLayout& layout, void* base, uint32_t stride, bool hitsOnly);
+}
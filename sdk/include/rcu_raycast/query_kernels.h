@@ -0,0 +1,14 @@
+#pragma once
+
+// SDK includes
+#include <rcu_raycast/intersection.h>
+#include <rcu_raycast/scene_version.h>
+
+namespace rcu
+{
+	// A query kernel is fully specialized for a packet width and a set of ResolveAttribute flags
+	typedef void (*TQueryKernel)(const TSceneVersion& version, const TRay* rayArray, TIntersection* intersectionArray, uint32_t numRays);
+
+	// Returns the kernel instantiated for the given packet width (1, 4, 8 or 16) and attribute mask
+	TQueryKernel query_kernel(uint32_t packetWidth, uint32_t attributeMask);
+}
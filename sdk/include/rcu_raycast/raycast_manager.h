@@ -3,9 +3,25 @@
 // SDK includes
 #include <rcu_model/scene.h>
 #include <rcu_raycast/intersection.h>
+#include <rcu_raycast/output_layout.h>
+#include <rcu_raycast/hit_resolve.h>
+#include <rcu_raycast/query_kernels.h>
+#include <rcu_raycast/reflection_paths.h>
+#include <rcu_raycast/ambient_occlusion.h>
+#include <rcu_raycast/lightmap_bake.h>
+#include <rcu_raycast/line_of_sight.h>
+#include <rcu_raycast/result_cache.h>
+#include <rcu_raycast/visibility_grid.h>
+#include <rcu_raycast/tiled_world.h>
+#include <rcu_spatial/spatial_query.h>
+#include <rcu_spatial/triangle_bvh.h>
+#include <rcu_spatial/shape_cast.h>
+#include <rcu_raycast/scene_version.h>
 
 // External includes
 #include <embree/include/embree3/rtcore.h>
+#include <atomic>
+#include <thread>
 
 namespace rcu
 {
@@ -16,22 +32,198 @@ namespace rcu
 		TRaycastManager(bento::IAllocator& allocator);
 		~TRaycastManager();
 
+		// Builds the scene and makes it active before returning
 		void setup(const TScene& targetScene);
+
+		// Builds the scene on a background thread, queries keep using the previous version until the new one is ready
+		void setup_async(const TScene& targetScene);
+		void cancel_setup();
+		void wait_setup();
+		SetupStatus::Type setup_status() const;
+		float setup_progress() const;
+
+		// Makes the pending version active if its build is done. Called automatically by run.
+		bool swap_scene_version();
+
 		void release();
 
+		// Pushes the vertices of a deformable geometry (see update_geometry_vertices) to the active version. The hierarchies are
+		// refitted before the next query. Waits for the background build if there is one so that the update is not lost.
+		void update_geometry(uint32_t geometryIdx);
+
+		// Pushes the transform of an instanced geometry (see set_geometry_transform) to the active version, only the top level
+		// hierarchy is updated before the next query.
+		void update_geometry_transform(uint32_t geometryIdx);
+
+		// Builds the triangle hierarchy needed by the spatial queries during the next setups
+		void enable_spatial_queries(bool enabled);
+
+		// Builds the scenes with context filter support during the next setups, run_multi_hit needs it but it slows down
+		// every other traversal
+		void enable_multi_hit(bool enabled);
+
+		// Bakes a sparse occupancy grid of voxelSize voxels (coarsened to fit in memoryBudget bytes) during the next setups. The rays
+		// that only cross empty voxels skip the traversal and the others stop at the last occupied voxel. A voxel size of 0 disables it.
+		void enable_occupancy_culling(float voxelSize, uint64_t memoryBudget);
+
+		// Bakes a sparse signed distance field of voxelSize voxels (coarsened to fit in memoryBudget bytes) during the next setups for the
+		// approximate queries. The updates of the geometries resample the distances around them, a geometry that leaves the field makes
+		// it stale (errors of FLT_MAX) until the next setup. A voxel size of 0 disables it.
+		void enable_distance_field(float voxelSize, uint64_t memoryBudget);
+
+		// Merges the static geometries of at most maxTriangles triangles (not deformable, not instanced, no quads nor custom attributes)
+		// in batched meshes during the next setups. The hits are still reported on the source geometries. 0 disables it.
+		void enable_geometry_merging(uint32_t maxTriangles);
+
 		void run(const TRay* rayArray,  TIntersection* intersectionArray, uint32_t numRays);
 
+		// Lets run reuse the intersections of the rays it already traced (see TResultCache), capacity 0 disables the cache.
+		// Rays that only differ by less than quantum may get the intersection of one another.
+		void enable_result_cache(uint32_t capacity, float quantum);
+
+		// Only writes the rays that hit something, hitArray must be able to hold numRays entries. Returns the number of hits.
+		uint32_t run_compact(const TRay* rayArray, TCompactHit* hitArray, uint32_t numRays);
+
+		// Writes the requested attributes directly into a caller defined structure. Returns the number of records written.
+		uint32_t run_layout(const TRay* rayArray, const TOutputLayout& layout, uint32_t numRays);
+
+		// Runs the kernel specialized for the packet width (1, 4, 8 or 16) and the ResolveAttribute flags.
+		// Attributes that are not requested are left untouched in the intersections.
+		void run_specialized(const TRay* rayArray, TIntersection* intersectionArray, uint32_t numRays, uint32_t attributeMask, uint32_t packetWidth);
+
+		// Collects up to maxHits intersections per ray in a single traversal. The hits of ray i are sorted by distance in
+		// intersectionArray[i * maxHits, (i + 1) * maxHits[, hitCountArray[i] tells how many are valid. Needs enable_multi_hit before the setup.
+		void run_multi_hit(const TRay* rayArray, TIntersection* intersectionArray, uint32_t* hitCountArray, uint32_t numRays, uint32_t maxHits);
+
+		// Finds the closest surface point within each query's max distance. Requires the spatial queries to be enabled.
+		void closest_points(const TPointQuery* queryArray, TClosestPoint* resultArray, uint32_t numQueries);
+
+		// Lists what touches each region as (queryIndex, geometryID, subMeshID, triangleID) entries grouped by query.
+		// At most capacity entries are written, the total number of overlaps is returned. Requires the spatial queries to be enabled.
+		uint32_t overlap_boxes(const TBoxQuery* queryArray, uint32_t numQueries, OverlapMode::Type mode, TOverlap* overlapArray, uint32_t capacity);
+		uint32_t overlap_spheres(const TSphereQuery* queryArray, uint32_t numQueries, OverlapMode::Type mode, TOverlap* overlapArray, uint32_t capacity);
+
+		// Sweeps spheres and capsules against the scene triangles and reports the first contact of each. Requires the spatial queries to be enabled.
+		void sphere_casts(const TSphereCast* castArray, TShapeHit* hitArray, uint32_t numCasts);
+		void capsule_casts(const TCapsuleCast* castArray, TShapeHit* hitArray, uint32_t numCasts);
+
+		// Follows the specular reflections of the emitter rays natively for up to maxBounces bounces and writes where each path stopped.
+		// The energy of a path is the product of the reflection coefficients it met, paths under minEnergy stop early.
+		void trace_reflection_paths(const TRay* emitterArray, TPathEndpoint* endpointArray, uint32_t numPaths, uint32_t maxBounces, float minEnergy);
+
+		// Estimates the ambient visibility of every point with numSamples cosine-weighted occlusion rays of length radius (see estimate_ambient_occlusion)
+		void ambient_occlusion(const TOcclusionPoint* pointArray, float* visibilityArray, uint32_t numPoints, uint32_t numSamples, float radius, uint32_t mask);
+
+		// Rasterizes the texture coordinates of a geometry into a width x height lightmap and writes the visibility of every light from
+		// every texel into atlas, one plane per light (see bake_texel_visibility for the layout and the values)
+		void bake_visibility(uint32_t geometryIdx, uint32_t width, uint32_t height, const TBakeLight* lightArray, uint32_t numLights, uint32_t mask, float* atlas);
+
+		// Writes the numSources x numTargets visibility bit matrix between two point sets, a null targetArray tests the sources
+		// against each other (see line_of_sight_matrix for the layout)
+		void line_of_sight(const bento::Vector3* sourceArray, uint32_t numSources, const bento::Vector3* targetArray, uint32_t numTargets, uint32_t mask, uint32_t* bitMatrix);
+
+		// Approximate distances and raycasts answered from the distance field, each result carries the bound of its error.
+		// Without a distance field the samples are FLT_MAX and the rays miss.
+		void distance_samples(const bento::Vector3* pointArray, TDistanceSample* sampleArray, uint32_t numPoints);
+		void approximate_raycasts(const TRay* rayArray, TDistanceHit* hitArray, uint32_t numRays);
+
+		// Bakes the potentially visible set of a grid of resolution[0] x resolution[1] x resolution[2] cells against the active version
+		// (see bake_visibility_grid). The set is kept across the scene swaps until the next bake or release.
+		void bake_visibility_grid(const bento::Vector3& origin, const bento::Vector3& cellSize, const uint32_t* resolution, uint32_t numSamples, uint32_t mask);
+
+		// Baked state of a pair of cells (CellVisibility values) for the mask of the bake, cells are indexed x + resolution[0] * (y + resolution[1] * z)
+		CellVisibility::Type cell_visibility(uint32_t cellA, uint32_t cellB) const;
+
+		// Writes 1 in visibleArray for the visible segments, only the pairs of cells baked as Visible skip the tracing (none of them
+		// if mask differs from the one of the bake)
+		void potential_visibility(const bento::Vector3* sourceArray, const bento::Vector3* targetArray, uint32_t numPairs, uint32_t mask, uint8_t* visibleArray);
+
+		// Tiled world mode, independent from the scene of setup: release leaves it alone, release_world stops the loading and drops
+		// the tiles. setup_world drops the previous tiles and sets the memory budget of the resident ones.
+		void setup_world(uint64_t memoryBudget);
+		void release_world();
+
+		// Declares a tile of the world, its content is either a caller owned scene or a tile cache file (see add_world_tile)
+		uint32_t add_world_tile(const bento::Vector3& minBound, const bento::Vector3& maxBound, const TScene* scene, const char* cachePath);
+
+		// Loads and builds tiles in the background, evicts a tile
+		void request_world_tile(uint32_t tileIdx);
+		void request_world_region(const bento::Vector3& center, float radius);
+		void evict_world_tile(uint32_t tileIdx);
+		TileStatus::Type world_tile_status(uint32_t tileIdx) const;
+
+		// Traces the rays through the resident tiles. tileArray receives the tile of each hit, RCU_WORLD_NO_TILE for a miss or the
+		// tile with RCU_WORLD_TILE_PENDING for the rays that entered a tile that is not resident yet. Those are reported as misses whose
+		// t is where they entered the tile, the tile is requested and the ray can be retried once it is resident. A tile that failed to
+		// load also has RCU_WORLD_TILE_FAILED, it is only retried after request_world_tile or evict_world_tile.
+		void run_world(const TRay* rayArray, TIntersection* intersectionArray, uint32_t* tileArray, uint32_t numRays);
+
+		// Only runs the traversal and writes a hit record per ray
+		void run_records(const TRay* rayArray, THitRecord* recordArray, uint32_t numRays);
+
+		// Resolves the records recordArray[indexArray[i]] into intersectionArray[i]. If indexArray is null the first numIndices records are resolved.
+		// Only the attributes of attributeMask (ResolveAttribute flags) are interpolated, the other ones are left untouched.
+		void resolve(const THitRecord* recordArray, const uint32_t* indexArray, uint32_t numIndices, uint32_t attributeMask, TIntersection* intersectionArray);
+
+		// Interpolates the custom vertex attributes of the records through embree, numComponents floats are written per index (zeros for misses)
+		void resolve_attributes(const THitRecord* recordArray, const uint32_t* indexArray, uint32_t numIndices, float* attributeArray, uint32_t numComponents);
+
+	private:
+		TSceneVersion* acquire_version();
+		void run_traced(const TSceneVersion& version, const TRay* rayArray, TIntersection* intersectionArray, uint32_t numRays);
+		void trace(const TSceneVersion& version, const TRay* rayArray, uint32_t numRays, RTCIntersectContext* customContext = nullptr);
+		void scatter_hits(const TScene& targetScene, uint32_t attributeMask, TIntersection* intersectionArray);
+		void join_build();
+
 	private:
 		// Embree structures
 		RTCDevice _device;
-		RTCScene _scene;
 
-		const TScene* _targetScene;
-		bento::Vector<uint32_t> _geometriesIndexes;
+		// Scene versions
+		std::atomic<TSceneVersion*> _activeVersion;
+		TSceneVersion* _pendingVersion;
+		std::atomic<uint32_t> _pendingStatus;
+		std::thread _buildThread;
+		bool _spatialQueries;
+		bool _multiHit;
+		float _occupancyVoxelSize;
+		uint64_t _occupancyBudget;
+		float _distanceFieldVoxelSize;
+		uint64_t _distanceFieldBudget;
+		uint32_t _mergeTriangleLimit;
+
 		bento::Vector<RTCRayHit16> _rayHitGroupArray;
 		bento::Vector<RTCRayHit> _rayHitSingleArray;
+
+		// Resolve stage
+		THitBuffer _hitBuffer;
+		THitBuffer _sortedHitBuffer;
+		bento::Vector<uint32_t> _sortCounterArray;
+		TAttributeBuffer _attributeBuffer;
+
+		// Per-ray hit lists of the multi-hit queries
+		bento::Vector<THitRecord> _multiHitArray;
+
+		// Per-query offsets of the overlap queries
+		bento::Vector<uint32_t> _overlapOffsetArray;
+
+		// Ray queues of the reflection paths
+		TPathQueues _pathQueues;
+
+		// Texels of the lightmap being baked
+		TTexelBuffer _texelBuffer;
+
+		// Intersections memoized across the calls to run
+		TResultCache _resultCache;
+
+		// Potentially visible set of the cell grid
+		TVisibilityGrid _visibilityGrid;
+
+		// Tiles of the world mode and their raw hits
+		TTiledWorld _world;
+		bento::Vector<TWorldHit> _worldHitArray;
 	public:
 		bento::IAllocator& _allocator;
 
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// SDK includes
+#include <rcu_raycast/intersection.h>
+#include <rcu_raycast/scene_version.h>
+
+// bento includes
+#include <bento_collection/vector.h>
+
+namespace rcu
+{
+	// State of a reflection path once it stopped
+	struct TPathEndpoint
+	{
+		// Number of reflections along the path
+		uint32_t numBounces;
+		// 1 if the path left the scene (missed or ran out of range), 0 if it stopped on a surface
+		int escaped;
+		// Product of the reflection coefficients of the surfaces along the path
+		float energy;
+		// Length of the path from the emitter to the last surface
+		float distance;
+		// Owner of the last surface, (uint32_t)-1 if the emitter ray did not hit anything
+		uint32_t geometryID;
+		uint32_t subMeshID;
+		// Last surface point (the emitter origin if nothing was hit) and direction leaving it
+		bento::Vector3 position;
+		bento::Vector3 direction;
+	};
+
+	// Rays of the paths that are still bouncing, reused between calls
+	struct TPathQueues
+	{
+		ALLOCATOR_BASED;
+		TPathQueues(bento::IAllocator& allocator);
+
+		// Next segment of every active path and the path it belongs to
+		bento::Vector<TRay> rayArray;
+		bento::Vector<uint32_t> pathArray;
+		// Set by the workers for the paths that go on after the current bounce
+		bento::Vector<uint8_t> aliveArray;
+	};
+
+	// Follows the specular reflections of the emitter rays for up to maxBounces bounces. The tmax of an emitter ray bounds the
+	// length of the whole path, the paths whose energy drops under minEnergy stop early. Without a version every path escapes.
+	void trace_reflection_paths(const TSceneVersion* version, const TRay* emitterArray, uint32_t numPaths, uint32_t maxBounces, float minEnergy, TPathQueues& queues, TPathEndpoint* endpointArray);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// SDK includes
+#include <rcu_model/scene.h>
+#include <rcu_raycast/intersection.h>
+
+// bento includes
+#include <bento_collection/vector.h>
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	struct TResultCacheEntry
+	{
+		// Quantized origin, direction, tmin, tmax and the mask of the ray
+		int32_t key[9];
+		// Change epoch the ray was traced at, 0 for an empty entry
+		uint32_t epoch;
+		TIntersection intersection;
+	};
+
+	// Space a geometry occupied before and after one of its updates
+	struct TGeometryChange
+	{
+		uint32_t epoch;
+		bento::Vector3 minBound;
+		bento::Vector3 maxBound;
+	};
+
+	// Opt-in memoization of the intersections of the rays that are cast frame after frame. An entry stays valid as long as none
+	// of the geometries updated since it was traced overlapped its ray segment, before or after the update.
+	struct TResultCache
+	{
+		ALLOCATOR_BASED;
+		TResultCache(bento::IAllocator& allocator);
+
+		// Rays whose parameters round to the same multiples of quantum share their result, 0 only matches identical rays
+		float quantum;
+		// Power of two number of entries, 0 when the cache is disabled
+		bento::Vector<TResultCacheEntry> entryArray;
+
+		// Change log, the entries older than minValidEpoch missed some of the trimmed changes
+		uint32_t currentEpoch;
+		uint32_t minValidEpoch;
+		bento::Vector<TGeometryChange> changeArray;
+		bento::Vector<bento::Vector3> geometryMinArray;
+		bento::Vector<bento::Vector3> geometryMaxArray;
+
+		// Rays that missed the cache and their fresh intersections
+		bento::Vector<uint32_t> missIndexArray;
+		bento::Vector<TRay> missRayArray;
+		bento::Vector<TIntersection> missIntersectionArray;
+	};
+
+	// Allocates capacity entries (rounded up to a power of two) and starts tracking the geometries of the scene (can be null)
+	void reset_result_cache(TResultCache& cache, const TScene* scene, uint32_t capacity, float quantum);
+
+	// Drops every entry and the change log, used when a new scene version is published
+	void clear_result_cache(TResultCache& cache, const TScene* scene);
+
+	// Logs the update of a geometry, must be called once its new vertices or transform are visible to the queries
+	void record_geometry_change(TResultCache& cache, const TScene& scene, uint32_t geometryIdx);
+
+	// Writes the still valid cached intersections and gathers the other rays into missRayArray. Returns the number of misses.
+	uint32_t lookup_cached_results(TResultCache& cache, const TRay* rayArray, uint32_t numRays, TIntersection* intersectionArray);
+
+	// Stores the intersections of the missed rays and scatters them to intersectionArray
+	void store_cached_results(TResultCache& cache, TIntersection* intersectionArray);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+// SDK includes
+#include <rcu_model/scene.h>
+#include <rcu_spatial/triangle_bvh.h>
+#include <rcu_spatial/occupancy_grid.h>
+#include <rcu_spatial/distance_field.h>
+
+// External includes
+#include <embree/include/embree3/rtcore.h>
+#include <atomic>
+
+namespace rcu
+{
+	namespace SetupStatus
+	{
+		enum Type
+		{
+			Idle = 0,
+			Building = 1,
+			Ready = 2,
+			Cancelled = 3,
+			Failed = 4
+		};
+	}
+
+	// Geometry slot of the versions that do not merge it
+	#define RCU_NOT_MERGED 0xffffffff
+	// Upper bound of the triangles of a merged batch, keeps the batches spatially compact
+	#define RCU_MERGE_BATCH_TRIANGLES 65536
+
+	// Triangle of a merged batch, with the geometry and the triangle it comes from
+	struct TMergedTriangle
+	{
+		uint32_t geometryIdx;
+		uint32_t triangleIdx;
+	};
+
+	// A committed (or being committed) embree scene built from a TScene. The raycast manager queries
+	// the active version while the next one builds in the background.
+	struct TSceneVersion
+	{
+		ALLOCATOR_BASED;
+		TSceneVersion(bento::IAllocator& allocator);
+		bento::IAllocator& _allocator;
+
+		// Embree structures
+		RTCScene scene;
+
+		// Source data of this version, must not be modified while the version is alive
+		const TScene* targetScene;
+		bento::Vector<uint32_t> geometriesIndexes;
+
+		// Child scene of every instanced geometry (null for the other ones), the top level scene holds their instances
+		bento::Vector<RTCScene> instanceScenes;
+		bool hasInstances;
+
+		// Embree geometry of the analytic primitives, RTC_INVALID_GEOMETRY_ID if the scene has none
+		uint32_t primitiveGeometryID;
+
+		// Deformable geometries whose vertices changed since the last commit, one flag per geometry
+		bento::Vector<uint8_t> dirtyGeometries;
+		bool refitPending;
+
+		// Optional merging of the small static geometries, 0 disables it. Every batch is attached at the slot of one of its geometries,
+		// mergedOffsetArray holds for that slot the first triangle of the batch in mergedTriangleArray (RCU_NOT_MERGED for the other slots)
+		uint32_t mergeTriangleLimit;
+		bento::Vector<uint32_t> mergedOffsetArray;
+		bento::Vector<TMergedTriangle> mergedTriangleArray;
+
+		// The scenes accept the context filters of the multi-hit queries
+		bool contextFilter;
+
+		// Optional hierarchy for the spatial queries (closest point, overlaps, sweeps)
+		bool buildTriangleBVH;
+		TTriangleBVH* triangleBVH;
+
+		// Optional occupancy grid that culls the rays crossing empty space, a voxel size of 0 disables it
+		float occupancyVoxelSize;
+		uint64_t occupancyBudget;
+		TOccupancyGrid* occupancyGrid;
+
+		// Optional signed distance field for the approximate queries, resampled around the updated geometries, a voxel size of 0 disables it
+		float distanceFieldVoxelSize;
+		uint64_t distanceFieldBudget;
+		TDistanceField* distanceField;
+
+		// Build tracking, the embree commit and each of the bakes that follow it get an equal share of the progress
+		std::atomic<float> progress;
+		std::atomic<bool> cancelRequested;
+		uint32_t numBuildStages;
+	};
+
+	// Instanced geometries are traced through a child scene, their hits carry the slot of the instance in instID
+	inline uint32_t hit_slot(uint32_t geomID, uint32_t instID)
+	{
+		return instID != RTC_INVALID_GEOMETRY_ID ? instID : geomID;
+	}
+
+	// Sends the hits of a merged batch back to the geometry and the triangle they come from
+	inline void unmerge_hit(const TSceneVersion& version, uint32_t& geomID, uint32_t& primID)
+	{
+		if (geomID >= version.mergedOffsetArray.size() || version.mergedOffsetArray[geomID] == RCU_NOT_MERGED)
+			return;
+		const TMergedTriangle& source = version.mergedTriangleArray[version.mergedOffsetArray[geomID] + primID];
+		geomID = source.geometryIdx;
+		primID = source.triangleIdx;
+	}
+
+	// Embree geometry that holds the triangles of a geometry of the scene, must not be called for the merged geometries
+	RTCGeometry mesh_geometry(const TSceneVersion& version, uint32_t geometryIdx);
+
+	// Creates the embree geometries of the target scene and commits them. Returns the resulting status.
+	SetupStatus::Type build_scene_version(RTCDevice device, TSceneVersion& version);
+
+	// Uploads the current vertices of a deformable geometry, the change is visible after refit_scene_version
+	void update_version_geometry(TSceneVersion& version, uint32_t geometryIdx);
+
+	// Uploads the current transform of an instanced geometry, the change is visible after refit_scene_version
+	void update_version_transform(TSceneVersion& version, uint32_t geometryIdx);
+
+	// Recommits the scene (refitting the updated geometries) and the triangle hierarchy if geometries were updated
+	void refit_scene_version(TSceneVersion& version);
+
+	// Releases the embree scene of a version
+	void release_scene_version(TSceneVersion& version);
+}
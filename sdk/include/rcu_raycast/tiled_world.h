@@ -0,0 +1,138 @@
+#pragma once
+
+// SDK includes
+#include <rcu_raycast/intersection.h>
+#include <rcu_raycast/scene_version.h>
+
+// bento includes
+#include <bento_collection/vector.h>
+#include <bento_math/types.h>
+
+// External includes
+#include <embree/include/embree3/rtcore.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace rcu
+{
+	namespace TileStatus
+	{
+		enum Type
+		{
+			Unloaded = 0,
+			// Waiting for the loader thread
+			Queued = 1,
+			Loading = 2,
+			// Built, becomes resident at the next query
+			Loaded = 3,
+			Resident = 4,
+			// The cache could not be read or the tile holds instanced geometries (embree traces a single instance level). The tile
+			// stops the rays like a pending one until a request or an eviction resets it.
+			Failed = 5
+		};
+	}
+
+	// Tile reported for the rays that hit nothing
+	#define RCU_WORLD_NO_TILE 0xffffffff
+	// Flag of the tile reported for the rays that entered a tile which is not resident, their result is not known yet
+	#define RCU_WORLD_TILE_PENDING 0x80000000
+	// Flag added to RCU_WORLD_TILE_PENDING when that tile failed to load, it is only retried once it is requested again
+	#define RCU_WORLD_TILE_FAILED 0x40000000
+	// Rough size of the embree hierarchy per triangle, used to estimate the memory of a tile
+	#define RCU_WORLD_BVH_BYTES_PER_TRIANGLE 64
+
+	// A spatial tile of the world, traced through its own embree scene once resident
+	struct TWorldTile
+	{
+		ALLOCATOR_BASED;
+		TWorldTile(bento::IAllocator& allocator);
+
+		// World space bounds of the content of the tile
+		bento::Vector3 minBound;
+		bento::Vector3 maxBound;
+
+		// Content of the tile, either a caller owned scene or a tile cache file (see write_tile_cache) loaded on demand
+		const TScene* sourceScene;
+		bento::Vector<char> cachePath;
+
+		// Owned by the loader thread until the status is Loaded
+		TScene* cachedScene;
+		TSceneVersion* version;
+		uint64_t memorySize;
+
+		// Last request or hit, the least recently used tiles are evicted first
+		uint64_t lastUsed;
+		bool evictRequested;
+		std::atomic<uint32_t> status;
+	};
+
+	// Hit of a ray in the tiled world. For the rays that entered a pending tile, tile has the RCU_WORLD_TILE_PENDING flag (and
+	// RCU_WORLD_TILE_FAILED if it failed to load) and t is where they entered it.
+	struct TWorldHit
+	{
+		uint32_t tile;
+		uint32_t geomID;
+		uint32_t primID;
+		float t;
+		float u;
+		float v;
+	};
+
+	// World split in tiles that are loaded and built asynchronously under a memory budget. The resident tiles are instanced in
+	// a top level scene next to a user geometry made of the bounds of the other ones, so a ray stops where it enters a missing tile.
+	struct TTiledWorld
+	{
+		ALLOCATOR_BASED;
+		TTiledWorld(bento::IAllocator& allocator);
+		bento::IAllocator& _allocator;
+
+		RTCDevice device;
+		bento::Vector<TWorldTile*> tileArray;
+
+		// Estimated memory of the resident tiles, the least recently used ones are evicted past the budget
+		uint64_t memoryBudget;
+		uint64_t residentMemory;
+		uint64_t useCounter;
+
+		// Top level scene, rebuilt when the residency changes
+		RTCScene scene;
+		bool topLevelDirty;
+		bento::Vector<uint32_t> instanceTileArray;
+		uint32_t proxyGeometryID;
+		bento::Vector<uint32_t> proxyTileArray;
+
+		// Loader thread, tileMutex guards tileArray and the queued tiles
+		std::thread loaderThread;
+		std::mutex tileMutex;
+		std::condition_variable loaderCondition;
+		uint32_t numQueued;
+		bool stopLoader;
+
+		bento::Vector<RTCRayHit16> rayHitGroupArray;
+	};
+
+	// Drops all the tiles and sets the device and the memory budget of the world
+	void reset_tiled_world(TTiledWorld& world, RTCDevice device, uint64_t memoryBudget);
+
+	// Stops the loader thread and releases every tile
+	void release_tiled_world(TTiledWorld& world);
+
+	// Declares a tile, exactly one of scene and cachePath must be set. The caller owned scene must outlive the world. Returns the tile index.
+	uint32_t add_world_tile(TTiledWorld& world, const bento::Vector3& minBound, const bento::Vector3& maxBound, const TScene* scene, const char* cachePath);
+
+	// Queues the load of a tile (or of the tiles overlapping a sphere), the most recent requests are loaded first. Failed tiles are retried.
+	void request_world_tile(TTiledWorld& world, uint32_t tileIdx);
+	void request_world_region(TTiledWorld& world, const bento::Vector3& center, float radius);
+
+	// Unloads a tile, a tile being loaded is dropped as soon as its build is done and a failed tile goes back to Unloaded
+	void evict_world_tile(TTiledWorld& world, uint32_t tileIdx);
+
+	// Makes the loaded tiles resident, evicts the least recently used ones past the budget and rebuilds the top level scene if needed.
+	// Must be called on the querying thread.
+	void update_tiled_world(TTiledWorld& world);
+
+	// Traces the rays through the resident tiles, the pending tiles they entered are requested (not the failed ones)
+	void trace_tiled_world(TTiledWorld& world, const TRay* rayArray, uint32_t numRays, TWorldHit* hitArray);
+}
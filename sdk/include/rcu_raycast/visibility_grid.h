@@ -0,0 +1,84 @@
+#pragma once
+
+// SDK includes
+#include <rcu_raycast/scene_version.h>
+
+// bento includes
+#include <bento_collection/vector.h>
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	namespace CellVisibility
+	{
+		enum Type
+		{
+			// The pair was not baked (no grid or a point outside of it)
+			Unknown = 0,
+			// None of the sampled segments between the cells got through, an unsampled one still may
+			Hidden = 1,
+			// All of them got through
+			Visible = 2,
+			// Some of them got through, the exact answer depends on the points
+			Partial = 3
+		};
+	}
+
+	// Number of cell pairs packed in a 32 bit word, two bits per pair
+	#define RCU_PVS_PAIRS_PER_WORD 16
+
+	// Potentially visible set between the cells of a regular grid. Only the pairs (a, b) with a <= b are stored, the pairs of a cell
+	// start on a word of their own so that the rows can be baked in parallel.
+	struct TVisibilityGrid
+	{
+		ALLOCATOR_BASED;
+		TVisibilityGrid(bento::IAllocator& allocator);
+
+		// World space corner of the cell (0, 0, 0) and size of a cell
+		bento::Vector3 origin;
+		bento::Vector3 cellSize;
+		uint32_t resolution[3];
+
+		// Layer mask of the baked segments, the states only hold for the queries with the same mask
+		uint32_t mask;
+
+		// First word of the pairs of every cell in stateArray
+		bento::Vector<uint32_t> rowOffsetArray;
+		bento::Vector<uint32_t> stateArray;
+
+		// Random points of every cell during the bake
+		bento::Vector<bento::Vector3> sampleArray;
+		// Segments that the lookups could not answer, traced in a single batch
+		bento::Vector<uint32_t> pendingIndexArray;
+	};
+
+	// Traces numSamples segments between random points of every pair of cells with occlusion packets. The cost grows with the
+	// square of the number of cells. Hidden and Visible are estimates, the more samples the less likely a sampled verdict is wrong.
+	// A thin gap between two cells is easily missed by the samples, so Hidden is only a hint and never skips the exact test.
+	void bake_visibility_grid(const TSceneVersion& version, const bento::Vector3& origin, const bento::Vector3& cellSize, const uint32_t* resolution, uint32_t numSamples, uint32_t mask, TVisibilityGrid& grid);
+
+	void clear_visibility_grid(TVisibilityGrid& grid);
+
+	// Index of the cell that contains a point, -1 outside of the grid
+	int32_t visibility_grid_cell(const TVisibilityGrid& grid, const bento::Vector3& point);
+
+	// Constant time lookup of the baked state of a pair of cells (CellVisibility values)
+	inline CellVisibility::Type visibility_grid_state(const TVisibilityGrid& grid, int32_t cellA, int32_t cellB)
+	{
+		if (cellA < 0 || cellB < 0 || grid.rowOffsetArray.size() == 0)
+			return CellVisibility::Unknown;
+		if (cellA > cellB)
+		{
+			int32_t cell = cellA;
+			cellA = cellB;
+			cellB = cell;
+		}
+		uint32_t pairIdx = (uint32_t)(cellB - cellA);
+		uint32_t word = grid.stateArray[grid.rowOffsetArray[cellA] + pairIdx / RCU_PVS_PAIRS_PER_WORD];
+		return (CellVisibility::Type)((word >> (2 * (pairIdx % RCU_PVS_PAIRS_PER_WORD))) & 3);
+	}
+
+	// Writes 1 in visibleArray for the segments [sourceArray[i], targetArray[i]] that are visible. When mask is the one of the bake, the
+	// baked state answers the pairs of Visible cells and only the other ones are traced. Any other mask traces every pair.
+	void potential_visibility(const TSceneVersion* version, TVisibilityGrid& grid, const bento::Vector3* sourceArray, const bento::Vector3* targetArray, uint32_t numPairs, uint32_t mask, uint8_t* visibleArray);
+}
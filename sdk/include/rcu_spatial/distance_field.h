@@ -0,0 +1,76 @@
+#pragma once
+
+// SDK includes
+#include <rcu_model/scene.h>
+#include <rcu_raycast/intersection.h>
+#include <rcu_spatial/triangle_bvh.h>
+
+// bento includes
+#include <bento_collection/vector.h>
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	// Samples per axis of a brick, neighbouring bricks share their border samples so a brick covers 7x7x7 voxels
+	#define RCU_SDF_BRICK_SAMPLES 8
+	#define RCU_SDF_COARSE_BRICK 0xffffffff
+
+	// Sparse signed distance field of a scene. The bricks near the surfaces hold exact samples, the other ones only their center distance.
+	struct TDistanceField
+	{
+		ALLOCATOR_BASED;
+		TDistanceField(bento::IAllocator& allocator);
+		bento::IAllocator& _allocator;
+
+		// World space position of the sample (0, 0, 0) and spacing of the samples
+		bento::Vector3 origin;
+		float voxelSize;
+		int32_t brickResolution[3];
+
+		// Index of the samples of every brick in sampleArray (in bricks), RCU_SDF_COARSE_BRICK for the bricks far from the surfaces
+		bento::Vector<uint32_t> brickIndexArray;
+		// Signed distance at the center of every brick
+		bento::Vector<float> coarseDistanceArray;
+		bento::Vector<float> sampleArray;
+
+		// World space bounds of every geometry as last sampled, the refits only resample around the geometries that moved
+		bento::Vector<TBoxQuery> geometryBoundsArray;
+		// Set once a geometry left the field, it can't bound the distances anymore and every sample reports an error of FLT_MAX
+		bool stale;
+	};
+
+	// Approximate distance to the closest surface, the exact one is within error of it. Negative behind the surfaces.
+	struct TDistanceSample
+	{
+		float distance;
+		float error;
+	};
+
+	// Result of a sphere traced ray. The surface is within error of position, clearance is the smallest distance met along the ray
+	// before the hit (the whole segment for a miss), which gives the penumbra of soft shadows.
+	struct TDistanceHit
+	{
+		int validity;
+		float t;
+		float error;
+		float clearance;
+		bento::Vector3 position;
+		bento::Vector3 normal;
+	};
+
+	// Bakes the signed distance to the triangles of the bvh and the primitives of the scene, the sign comes from the angle weighted
+	// pseudo normal of the closest feature. The voxel size is doubled until the field fits in memoryBudget bytes. Returns false for an empty scene
+	// or if the monitor cancelled the bake.
+	bool build_distance_field(const TScene& scene, const TTriangleBVH& bvh, float voxelSize, uint64_t memoryBudget, TDistanceField& field, TBuildMonitor monitor = nullptr, void* monitorData = nullptr);
+
+	// Resamples the distances that the geometries flagged in dirtyGeometryArray may have changed, bvh must be refit to their current
+	// vertices. The bricks keep their resolution, a surface that moved into a coarse brick is only seen through its center.
+	void refit_distance_field(const TScene& scene, const TTriangleBVH& bvh, const uint8_t* dirtyGeometryArray, TDistanceField& field);
+
+	// Interpolated signed distance at a point and the bound of its error
+	TDistanceSample sample_distance_field(const TDistanceField& field, const bento::Vector3& point);
+
+	// Marches the ray by the distance to the surfaces until it gets within a fraction of a voxel of one. A stale field reports a miss
+	// with an error of FLT_MAX.
+	void sphere_trace(const TDistanceField& field, const TRay& ray, TDistanceHit& hit);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// SDK includes
+#include <rcu_model/scene.h>
+#include <rcu_spatial/spatial_query.h>
+
+// bento includes
+#include <bento_collection/vector.h>
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	// Bricks group 4x4x4 voxels, one bit per voxel
+	#define RCU_OCCUPANCY_BRICK_SIZE 4
+	#define RCU_OCCUPANCY_EMPTY_BRICK 0xffffffff
+	// Past this many deformable or instanced geometries the grid is not baked
+	#define RCU_OCCUPANCY_MAX_DYNAMIC 16
+
+	// Sparse voxelization of the static content of a scene, used to skip the traversal of the rays that only cross empty space
+	struct TOccupancyGrid
+	{
+		ALLOCATOR_BASED;
+		TOccupancyGrid(bento::IAllocator& allocator);
+
+		// World space corner of the voxel (0, 0, 0) and edge of a voxel
+		bento::Vector3 origin;
+		float voxelSize;
+		int32_t brickResolution[3];
+
+		// Index in brickMaskArray of every brick, RCU_OCCUPANCY_EMPTY_BRICK for the empty ones
+		bento::Vector<uint32_t> brickIndexArray;
+		bento::Vector<uint64_t> brickMaskArray;
+
+		// Deformable and instanced geometries are not voxelized, their current bounds are tested instead
+		bento::Vector<uint32_t> dynamicGeometryArray;
+		bento::Vector<TBoxQuery> dynamicBoundsArray;
+	};
+
+	// Voxelizes the triangles and primitives of the scene. The voxel size is doubled until the grid fits in memoryBudget bytes.
+	// Returns false if the grid would not help (empty scene, too many dynamic geometries) or if the monitor cancelled the bake.
+	bool build_occupancy_grid(const TScene& scene, float voxelSize, uint64_t memoryBudget, TOccupancyGrid& grid, TBuildMonitor monitor = nullptr, void* monitorData = nullptr);
+
+	// Refreshes the bounds of the dynamic geometries flagged in dirtyGeometryArray
+	void refit_occupancy_grid(const TScene& scene, const uint8_t* dirtyGeometryArray, TOccupancyGrid& grid);
+
+	// Returns false if the segment [tmin, tmax] of the ray only crosses empty space, otherwise pulls tmax back to the exit of the last
+	// occupied voxel it crosses
+	bool occupancy_clip_segment(const TOccupancyGrid& grid, const bento::Vector3& origin, const bento::Vector3& direction, float tmin, float& tmax);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// SDK includes
+#include <rcu_spatial/triangle_bvh.h>
+
+namespace rcu
+{
+	// Result of a sweep against the triangle BVH
+	struct TBVHSweepHit
+	{
+		float distance;
+		uint32_t geometryIndex;
+		uint32_t triangleIndex;
+		bento::Vector3 position;
+		bento::Vector3 normal;
+	};
+
+	// Finds the first triangle touched by the moving sphere, returns false if there is none. Shapes that already overlap
+	// a triangle report it at distance zero.
+	bool bvh_sweep_sphere(const TTriangleBVH& bvh, const TSphereCast& sphereCast, TBVHSweepHit& sweepHit);
+
+	// Same for a capsule, the time of impact is found by conservative advancement
+	bool bvh_sweep_capsule(const TTriangleBVH& bvh, const TCapsuleCast& capsuleCast, TBVHSweepHit& sweepHit);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// bento includes
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	// Reports the progress of a bake in [0, 1], returning false cancels it. Same contract as the embree progress monitors.
+	typedef bool (*TBuildMonitor)(void* userData, float progress);
+
+	struct TPointQuery
+	{
+		bento::Vector3 position;
+		float maxDistance;
+	};
+
+	struct TClosestPoint
+	{
+		int validity;
+		float distance;
+		uint32_t geometryID;
+		uint32_t subMeshID;
+		uint32_t triangleID;
+		bento::Vector3 barycentricCoordinates;
+		bento::Vector3 position;
+	};
+
+	struct TBoxQuery
+	{
+		bento::Vector3 minBound;
+		bento::Vector3 maxBound;
+	};
+
+	struct TSphereQuery
+	{
+		bento::Vector3 center;
+		float radius;
+	};
+
+	namespace OverlapMode
+	{
+		enum Type
+		{
+			// Reports every triangle touching the region
+			Triangles = 0,
+			// Only tests the bounds of the geometries, triangleID is (uint32_t)-1
+			Geometries = 1
+		};
+	}
+
+	struct TOverlap
+	{
+		uint32_t queryIndex;
+		uint32_t geometryID;
+		uint32_t subMeshID;
+		uint32_t triangleID;
+	};
+
+	// Sphere moved along direction for up to maxDistance
+	struct TSphereCast
+	{
+		bento::Vector3 origin;
+		bento::Vector3 direction;
+		float radius;
+		float maxDistance;
+	};
+
+	// Capsule of segment [pointA, pointB] moved along direction for up to maxDistance
+	struct TCapsuleCast
+	{
+		bento::Vector3 pointA;
+		bento::Vector3 pointB;
+		bento::Vector3 direction;
+		float radius;
+		float maxDistance;
+	};
+
+	struct TShapeHit
+	{
+		int validity;
+		// Distance travelled along the normalized direction before the contact
+		float distance;
+		uint32_t geometryID;
+		uint32_t subMeshID;
+		uint32_t triangleID;
+		// Contact point on the triangle and normal pointing towards the shape
+		bento::Vector3 position;
+		bento::Vector3 normal;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+// SDK includes
+#include <rcu_model/scene.h>
+#include <rcu_spatial/spatial_query.h>
+
+// bento includes
+#include <bento_collection/vector.h>
+#include <bento_math/types.h>
+
+namespace rcu
+{
+	// Width of the triangle blocks stored in the leaves
+	#define RCU_BVH_BLOCK_SIZE 4
+
+	struct TBVHNode
+	{
+		bento::Vector3 minBound;
+		// Index of the first child for inner nodes (the second one follows it), index of the triangle block for leaves
+		uint32_t childOrBlock;
+		bento::Vector3 maxBound;
+		// Zero for inner nodes, number of geometries in the leaves of the geometry hierarchy
+		uint32_t numTriangles;
+	};
+
+	// Up to four triangles stored as a structure of arrays. Unused lanes repeat the last triangle.
+	struct TTriangleBlock
+	{
+		// a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z
+		float vertices[9][RCU_BVH_BLOCK_SIZE];
+		uint32_t geometryIndex[RCU_BVH_BLOCK_SIZE];
+		uint32_t triangleIndex[RCU_BVH_BLOCK_SIZE];
+	};
+
+	// World space triangle BVH of a scene, used by the queries that embree does not offer
+	struct TTriangleBVH
+	{
+		ALLOCATOR_BASED;
+		TTriangleBVH(bento::IAllocator& allocator);
+		bento::IAllocator& _allocator;
+
+		bento::Vector<TBVHNode> nodeArray;
+		bento::Vector<TTriangleBlock> blockArray;
+
+		// World space bounds of every geometry of the scene
+		bento::Vector<TBoxQuery> geometryBoundsArray;
+
+		// Hierarchy over the bounds of the non empty geometries, its leaves point into geometryIndexArray
+		bento::Vector<TBVHNode> geometryNodeArray;
+		bento::Vector<uint32_t> geometryIndexArray;
+	};
+
+	// Geometry and triangle index of an overlap
+	struct TBVHOverlap
+	{
+		uint32_t geometryIndex;
+		uint32_t triangleIndex;
+	};
+
+	// Result of a closest point search
+	struct TBVHClosestHit
+	{
+		float distanceSq;
+		uint32_t geometryIndex;
+		uint32_t triangleIndex;
+		float u;
+		float v;
+		bento::Vector3 position;
+	};
+
+	// Builds the hierarchy over all the triangles of the scene
+	void build_triangle_bvh(const TScene& scene, TTriangleBVH& bvh);
+
+	// Refreshes the triangles of the geometries flagged in dirtyGeometryArray and the bounds of the nodes, the topology is kept
+	void refit_triangle_bvh(const TScene& scene, const uint8_t* dirtyGeometryArray, TTriangleBVH& bvh);
+
+	// Finds the closest triangle within maxDistance of the point, returns false if there is none
+	bool bvh_closest_point(const TTriangleBVH& bvh, const bento::Vector3& point, float maxDistance, TBVHClosestHit& closestHit);
+
+	// Collects the triangles that overlap the region. At most capacity overlaps are written, the total count is returned.
+	uint32_t bvh_overlap_box(const TTriangleBVH& bvh, const TBoxQuery& box, TBVHOverlap* overlapArray, uint32_t capacity);
+	uint32_t bvh_overlap_sphere(const TTriangleBVH& bvh, const TSphereQuery& sphere, TBVHOverlap* overlapArray, uint32_t capacity);
+
+	// Same as above but only against the bounds of the geometries, triangleIndex is (uint32_t)-1
+	uint32_t bvh_overlap_box_geometries(const TTriangleBVH& bvh, const TBoxQuery& box, TBVHOverlap* overlapArray, uint32_t capacity);
+	uint32_t bvh_overlap_sphere_geometries(const TTriangleBVH& bvh, const TSphereQuery& sphere, TBVHOverlap* overlapArray, uint32_t capacity);
+}
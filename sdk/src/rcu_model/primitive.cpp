@@ -0,0 +1,252 @@
+// sdk includes
+#include "rcu_model/primitive.h"
+
+// bento includes
+#include <bento_math/matrix4.h>
+#include <bento_math/vector3.h>
+
+// External includes
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+namespace rcu
+{
+	static const float PI = 3.14159265358979f;
+
+	static inline float component(const bento::Vector3& vector, uint32_t axis)
+	{
+		return (&vector.x)[axis];
+	}
+
+	static inline float& component(bento::Vector3& vector, uint32_t axis)
+	{
+		return (&vector.x)[axis];
+	}
+
+	// Keeps the closest root of a*t^2 + 2*b*t + c that lies in [tnear, t[ and passes the part test
+	template<typename TAcceptFunction>
+	static inline bool closest_root(float a, float b, float c, float tnear, float& t, const TAcceptFunction& accept)
+	{
+		float discriminant = b * b - a * c;
+		if (a == 0.0f || discriminant < 0.0f)
+			return false;
+		float root = sqrtf(discriminant);
+		float t0 = (-b - root) / a;
+		float t1 = (-b + root) / a;
+		if (t0 >= tnear && t0 < t && accept(t0))
+		{
+			t = t0;
+			return true;
+		}
+		if (t1 >= tnear && t1 < t && accept(t1))
+		{
+			t = t1;
+			return true;
+		}
+		return false;
+	}
+
+	// Spherical parameters of a point relative to the center of a sphere
+	static inline void sphere_parameters(const bento::Vector3& point, float radius, float& u, float& v)
+	{
+		float cosTheta = point.y / radius;
+		cosTheta = cosTheta < -1.0f ? -1.0f : (cosTheta > 1.0f ? 1.0f : cosTheta);
+		u = atan2f(point.z, point.x) / (2.0f * PI) + 0.5f;
+		v = acosf(cosTheta) / PI;
+	}
+
+	static inline bento::Vector3 sphere_direction(float u, float v)
+	{
+		float phi = (u - 0.5f) * 2.0f * PI;
+		float theta = v * PI;
+		return { sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) };
+	}
+
+	bool intersect_primitive(const TPrimitive& primitive, const bento::Vector3& origin, const bento::Vector3& direction, float tnear, float tfar, float& t, uint32_t& part, float& u, float& v)
+	{
+		// Intersect in local space, the transform is affine so the distances are preserved
+		bento::Vector3 o = primitive.inverseTransform * origin;
+		bento::Vector4 localDirection = primitive.inverseTransform * bento::vector4(direction.x, direction.y, direction.z, 0.0f);
+		bento::Vector3 d = bento::vector3(localDirection.x, localDirection.y, localDirection.z);
+		float radius = primitive.parameters.x;
+		t = tfar;
+
+		switch (primitive.type)
+		{
+			case PrimitiveType::Sphere:
+			{
+				if (!closest_root(bento::dot(d, d), bento::dot(o, d), bento::dot(o, o) - radius * radius, tnear, t, [](float) { return true; }))
+					return false;
+				part = PrimitivePart::Body;
+				sphere_parameters(o + d * t, radius, u, v);
+				return true;
+			}
+			case PrimitiveType::Capsule:
+			{
+				float halfHeight = primitive.parameters.y;
+				bool found = false;
+
+				// Cylinder between the two caps
+				float a = d.x * d.x + d.z * d.z;
+				float b = o.x * d.x + o.z * d.z;
+				float c = o.x * o.x + o.z * o.z - radius * radius;
+				if (closest_root(a, b, c, tnear, t, [&](float root) { return fabsf(o.y + d.y * root) <= halfHeight; }))
+				{
+					found = true;
+					part = PrimitivePart::Body;
+				}
+
+				// Hemispheres, only their outer half counts
+				for (uint32_t capIdx = 0; capIdx < 2; ++capIdx)
+				{
+					float side = capIdx == 0 ? -1.0f : 1.0f;
+					bento::Vector3 capOrigin = { o.x, o.y - side * halfHeight, o.z };
+					if (closest_root(bento::dot(d, d), bento::dot(capOrigin, d), bento::dot(capOrigin, capOrigin) - radius * radius, tnear, t, [&](float root) { return (capOrigin.y + d.y * root) * side >= 0.0f; }))
+					{
+						found = true;
+						part = capIdx == 0 ? PrimitivePart::BottomCap : PrimitivePart::TopCap;
+					}
+				}
+				if (!found)
+					return false;
+
+				bento::Vector3 point = o + d * t;
+				if (part == PrimitivePart::Body)
+				{
+					u = atan2f(point.z, point.x) / (2.0f * PI) + 0.5f;
+					v = halfHeight > 0.0f ? (point.y + halfHeight) / (2.0f * halfHeight) : 0.5f;
+				}
+				else
+				{
+					point.y -= (part == PrimitivePart::BottomCap ? -halfHeight : halfHeight);
+					sphere_parameters(point, radius, u, v);
+				}
+				return true;
+			}
+			case PrimitiveType::Box:
+			{
+				const bento::Vector3& extent = primitive.parameters;
+				float tEnter = -FLT_MAX, tExit = FLT_MAX;
+				uint32_t enterAxis = 0, exitAxis = 0;
+				for (uint32_t axis = 0; axis < 3; ++axis)
+				{
+					float axisOrigin = component(o, axis), axisDirection = component(d, axis), axisExtent = component(extent, axis);
+					if (axisDirection == 0.0f)
+					{
+						if (fabsf(axisOrigin) > axisExtent)
+							return false;
+						continue;
+					}
+					float t0 = (-axisExtent - axisOrigin) / axisDirection;
+					float t1 = (axisExtent - axisOrigin) / axisDirection;
+					if (t0 > t1)
+						std::swap(t0, t1);
+					if (t0 > tEnter)
+					{
+						tEnter = t0;
+						enterAxis = axis;
+					}
+					if (t1 < tExit)
+					{
+						tExit = t1;
+						exitAxis = axis;
+					}
+				}
+				if (tEnter > tExit)
+					return false;
+
+				// Rays starting inside the box hit its back faces
+				bool entering = tEnter >= tnear;
+				float candidate = entering ? tEnter : tExit;
+				if (candidate < tnear || candidate >= tfar)
+					return false;
+				t = candidate;
+
+				uint32_t axis = entering ? enterAxis : exitAxis;
+				bool positiveFace = entering ? component(d, axis) < 0.0f : component(d, axis) > 0.0f;
+				part = PrimitivePart::FirstFace + axis * 2 + (positiveFace ? 1 : 0);
+
+				bento::Vector3 point = o + d * t;
+				uint32_t uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+				u = (component(point, uAxis) + component(extent, uAxis)) / (2.0f * component(extent, uAxis));
+				v = (component(point, vAxis) + component(extent, vAxis)) / (2.0f * component(extent, vAxis));
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void evaluate_primitive(const TPrimitive& primitive, uint32_t part, float u, float v, bento::Vector3& position, bento::Vector3& normal, bento::Vector2& texCoord)
+	{
+		float radius = primitive.parameters.x;
+		bento::Vector3 localPosition = { 0, 0, 0 };
+		bento::Vector3 localNormal = { 0, 1, 0 };
+		switch (primitive.type)
+		{
+			case PrimitiveType::Sphere:
+			{
+				localNormal = sphere_direction(u, v);
+				localPosition = localNormal * radius;
+			}
+			break;
+			case PrimitiveType::Capsule:
+			{
+				float halfHeight = primitive.parameters.y;
+				if (part == PrimitivePart::Body)
+				{
+					float phi = (u - 0.5f) * 2.0f * PI;
+					localNormal = { cosf(phi), 0.0f, sinf(phi) };
+					localPosition = { localNormal.x * radius, v * 2.0f * halfHeight - halfHeight, localNormal.z * radius };
+				}
+				else
+				{
+					localNormal = sphere_direction(u, v);
+					localPosition = localNormal * radius;
+					localPosition.y += part == PrimitivePart::BottomCap ? -halfHeight : halfHeight;
+				}
+			}
+			break;
+			case PrimitiveType::Box:
+			{
+				const bento::Vector3& extent = primitive.parameters;
+				uint32_t face = part - PrimitivePart::FirstFace;
+				uint32_t axis = face / 2;
+				float side = (face & 1) ? 1.0f : -1.0f;
+				uint32_t uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+				localNormal = { 0, 0, 0 };
+				component(localNormal, axis) = side;
+				component(localPosition, axis) = side * component(extent, axis);
+				component(localPosition, uAxis) = (u * 2.0f - 1.0f) * component(extent, uAxis);
+				component(localPosition, vAxis) = (v * 2.0f - 1.0f) * component(extent, vAxis);
+			}
+			break;
+		}
+
+		position = primitive.transform * localPosition;
+		bento::Vector4 worldNormal = bento::transpose(primitive.inverseTransform) * bento::vector4(localNormal.x, localNormal.y, localNormal.z, 0.0f);
+		normal = bento::normalize(bento::vector3(worldNormal.x, worldNormal.y, worldNormal.z));
+		texCoord = { u, v };
+	}
+
+	void primitive_bounds(const TPrimitive& primitive, bento::Vector3& minBound, bento::Vector3& maxBound)
+	{
+		float radius = primitive.parameters.x;
+		bento::Vector3 halfExtent = primitive.type == PrimitiveType::Box ? primitive.parameters
+			: (primitive.type == PrimitiveType::Capsule ? bento::vector3(radius, primitive.parameters.y + radius, radius) : bento::vector3(radius, radius, radius));
+
+		// Bounds of the transformed corners of the local box
+		minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+		maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t cornerIdx = 0; cornerIdx < 8; ++cornerIdx)
+		{
+			bento::Vector3 corner = { (cornerIdx & 1) ? halfExtent.x : -halfExtent.x, (cornerIdx & 2) ? halfExtent.y : -halfExtent.y, (cornerIdx & 4) ? halfExtent.z : -halfExtent.z };
+			bento::Vector3 worldCorner = primitive.transform * corner;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				component(minBound, axis) = fminf(component(minBound, axis), component(worldCorner, axis));
+				component(maxBound, axis) = fmaxf(component(maxBound, axis), component(worldCorner, axis));
+			}
+		}
+	}
+}
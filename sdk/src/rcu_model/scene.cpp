@@ -3,6 +3,11 @@
 
 // bento includes
 #include <bento_math/matrix4.h>
+#include <bento_base/security.h>
+
+// External includes
+#include <float.h>
+#include <math.h>
 
 namespace rcu
 {
@@ -10,39 +15,190 @@ namespace rcu
 	: _allocator(allocator)
 	, sceneName(allocator)
 	, geometryArray(allocator)
+	, primitiveArray(allocator)
+	{
+	}
+
+	static const float identityMatrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+	// Copies the positions (and normals if any) of a mesh and moves them to world space
+	static void transform_vertices(TGeometry& geometry, const float* positionArray, const float* normalArray, const float* transformMatrix)
 	{
+		uint32_t numVerts = geometry.vertexArray.size();
+		memcpy(geometry.vertexArray.begin(), positionArray, sizeof(bento::Vector3) * numVerts);
+
+		bento::Matrix4 transform;
+		memcpy(transform.m, transformMatrix, 16 * sizeof(float));
+		for (uint32_t vertIdx = 0; vertIdx < numVerts; ++vertIdx)
+		{
+			geometry.vertexArray[vertIdx] = transform * geometry.vertexArray[vertIdx];
+		}
+
+		if (normalArray == nullptr)
+			return;
+		memcpy(geometry.normalArray.begin(), normalArray, sizeof(bento::Vector3) * numVerts);
+
+		bento::Matrix4 normalMatrix;
+		normalMatrix = bento::Inverse(transform);
+		normalMatrix = bento::transpose(normalMatrix);
+		for (uint32_t vertIdx = 0; vertIdx < numVerts; ++vertIdx)
+		{
+			bento::Vector4 normalTransformed = normalMatrix * bento::vector4(geometry.normalArray[vertIdx].x, geometry.normalArray[vertIdx].y, geometry.normalArray[vertIdx].z, 0.0f);
+			geometry.normalArray[vertIdx] = bento::vector3(normalTransformed.x, normalTransformed.y, normalTransformed.z);
+			geometry.normalArray[vertIdx] = bento::normalize(geometry.normalArray[vertIdx]);
+		}
 	}
 
-	void append_geometry(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, uint32_t numTriangles, const float* transformMatrix)
+	// Copies the vertices of a mesh and moves them to world space
+	static TGeometry& append_vertices(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, const float* transformMatrix, uint32_t layerMask)
 	{
 		TGeometry& newGeometry = targetScene.geometryArray.extend();
 		newGeometry.gameObjectID = objectID;
 		newGeometry.subMeshID = subMeshID;
+		newGeometry.layerMask = layerMask;
 		newGeometry.vertexArray.resize(numVerts);
 		newGeometry.normalArray.resize(numVerts);
 		newGeometry.texCoordArray.resize(numVerts);
-		memcpy(newGeometry.vertexArray.begin(), positionArray, sizeof(bento::Vector3) * numVerts);
-		memcpy(newGeometry.normalArray.begin(), normalArray, sizeof(bento::Vector3) * numVerts);
 		memcpy(newGeometry.texCoordArray.begin(), texCoordArray, sizeof(bento::Vector2) * numVerts);
+		transform_vertices(newGeometry, positionArray, normalArray, transformMatrix);
+		return newGeometry;
+	}
+
+	void append_geometry(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, uint32_t numTriangles, const float* transformMatrix, uint32_t layerMask)
+	{
+		TGeometry& newGeometry = append_vertices(targetScene, objectID, subMeshID, positionArray, normalArray, texCoordArray, numVerts, transformMatrix, layerMask);
 		newGeometry.indexArray.resize(numTriangles);
 		memcpy(newGeometry.indexArray.begin(), indexArray, sizeof(bento::IVector3) * numTriangles);
+	}
 
-		bento::Matrix4 transform;
-		memcpy(transform.m, transformMatrix, 16 * sizeof(float));
+	void append_instanced_geometry(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* indexArray, uint32_t numTriangles, const float* transformMatrix, uint32_t layerMask)
+	{
+		// Keep the local space data
+		TGeometry& newGeometry = append_vertices(targetScene, objectID, subMeshID, positionArray, normalArray, texCoordArray, numVerts, identityMatrix, layerMask);
+		newGeometry.indexArray.resize(numTriangles);
+		memcpy(newGeometry.indexArray.begin(), indexArray, sizeof(bento::IVector3) * numTriangles);
+		newGeometry.instanced = true;
+		set_geometry_transform(targetScene, targetScene.geometryArray.size() - 1, transformMatrix);
+	}
+
+	void set_geometry_transform(TScene& targetScene, uint32_t geometryIdx, const float* transformMatrix)
+	{
+		TGeometry& targetGeometry = targetScene.geometryArray[geometryIdx];
+		assert_msg(targetGeometry.instanced, "The geometry is not instanced");
+		memcpy(targetGeometry.transform.m, transformMatrix, 16 * sizeof(float));
+		targetGeometry.normalMatrix = bento::transpose(bento::Inverse(targetGeometry.transform));
+	}
+
+	bento::Vector3 instance_position(const TGeometry& geometry, const bento::Vector3& position)
+	{
+		return geometry.transform * position;
+	}
+
+	bento::Vector3 instance_normal(const TGeometry& geometry, const bento::Vector3& normal)
+	{
+		bento::Vector4 normalTransformed = geometry.normalMatrix * bento::vector4(normal.x, normal.y, normal.z, 0.0f);
+		return bento::normalize(bento::vector3(normalTransformed.x, normalTransformed.y, normalTransformed.z));
+	}
+
+	void geometry_world_bounds(const TGeometry& geometry, bento::Vector3& minBound, bento::Vector3& maxBound)
+	{
+		minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+		maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t numVerts = geometry.vertexArray.size();
 		for (uint32_t vertIdx = 0; vertIdx < numVerts; ++vertIdx)
 		{
-			newGeometry.vertexArray[vertIdx] = transform * newGeometry.vertexArray[vertIdx];
+			bento::Vector3 position = geometry.instanced ? instance_position(geometry, geometry.vertexArray[vertIdx]) : geometry.vertexArray[vertIdx];
+			minBound = { fminf(minBound.x, position.x), fminf(minBound.y, position.y), fminf(minBound.z, position.z) };
+			maxBound = { fmaxf(maxBound.x, position.x), fmaxf(maxBound.y, position.y), fmaxf(maxBound.z, position.z) };
 		}
+	}
 
-		bento::Matrix4 normalMatrix;
-		normalMatrix = bento::Inverse(transform);
-		normalMatrix = bento::transpose(normalMatrix);
+	void append_quad_geometry(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, float* positionArray, float* normalArray, float* texCoordArray, uint32_t numVerts, int32_t* quadIndexArray, uint32_t numQuads, const float* transformMatrix, uint32_t layerMask)
+	{
+		TGeometry& newGeometry = append_vertices(targetScene, objectID, subMeshID, positionArray, normalArray, texCoordArray, numVerts, transformMatrix, layerMask);
+		newGeometry.quadTopology = true;
+		newGeometry.indexArray.resize(2 * numQuads);
+		for (uint32_t quadIdx = 0; quadIdx < numQuads; ++quadIdx)
+		{
+			const int32_t* quad = quadIndexArray + 4 * quadIdx;
+			newGeometry.indexArray[2 * quadIdx] = { quad[0], quad[1], quad[3] };
+			newGeometry.indexArray[2 * quadIdx + 1] = { quad[2], quad[3], quad[1] };
+		}
+	}
+
+	void append_primitive(TScene& targetScene, uint32_t objectID, uint32_t subMeshID, PrimitiveType::Type type, const float* parameters, const float* transformMatrix, uint32_t layerMask)
+	{
+		TPrimitive& newPrimitive = targetScene.primitiveArray.extend();
+		newPrimitive.gameObjectID = objectID;
+		newPrimitive.subMeshID = subMeshID;
+		newPrimitive.layerMask = layerMask;
+		newPrimitive.type = type;
+		newPrimitive.parameters = bento::vector3(parameters[0], parameters[1], parameters[2]);
+		memcpy(newPrimitive.transform.m, transformMatrix, 16 * sizeof(float));
+		newPrimitive.inverseTransform = bento::Inverse(newPrimitive.transform);
+		newPrimitive.reflectionCoefficient = 1.0f;
+	}
+
+	void set_geometry_deformable(TScene& targetScene, uint32_t geometryIdx, bool deformable)
+	{
+		assert_msg(!deformable || !targetScene.geometryArray[geometryIdx].packedAttributes, "The attributes of the geometry are packed");
+		targetScene.geometryArray[geometryIdx].deformable = deformable;
+	}
+
+	void update_geometry_vertices(TScene& targetScene, uint32_t geometryIdx, const float* positionArray, const float* normalArray, const float* transformMatrix)
+	{
+		TGeometry& targetGeometry = targetScene.geometryArray[geometryIdx];
+		assert_msg(targetGeometry.deformable, "The geometry was not flagged as deformable");
+		transform_vertices(targetGeometry, positionArray, normalArray, targetGeometry.instanced ? identityMatrix : transformMatrix);
+	}
+
+	void pack_geometry_attributes(TScene& targetScene, uint32_t geometryIdx)
+	{
+		TGeometry& targetGeometry = targetScene.geometryArray[geometryIdx];
+		assert_msg(!targetGeometry.deformable, "The normals of a deformable geometry are overwritten by its updates");
+		if (targetGeometry.packedAttributes)
+			return;
+
+		uint32_t numVerts = targetGeometry.normalArray.size();
+		targetGeometry.packedNormalArray.resize(numVerts);
+		targetGeometry.packedTexCoordArray.resize(numVerts);
 		for (uint32_t vertIdx = 0; vertIdx < numVerts; ++vertIdx)
 		{
-			bento::Vector4 normalTransformed = normalMatrix * bento::vector4(newGeometry.normalArray[vertIdx].x, newGeometry.normalArray[vertIdx].y, newGeometry.normalArray[vertIdx].z, 0.0f);
-			newGeometry.normalArray[vertIdx] = bento::vector3(normalTransformed.x, normalTransformed.y, normalTransformed.z);
-			newGeometry.normalArray[vertIdx] = bento::normalize(newGeometry.normalArray[vertIdx]);
+			targetGeometry.packedNormalArray[vertIdx] = encode_octahedral(targetGeometry.normalArray[vertIdx]);
+			targetGeometry.packedTexCoordArray[vertIdx] = encode_half2(targetGeometry.texCoordArray[vertIdx]);
+		}
+		targetGeometry.normalArray.clear();
+		targetGeometry.texCoordArray.clear();
+		targetGeometry.packedAttributes = true;
+	}
+
+	void pack_scene_attributes(TScene& targetScene)
+	{
+		uint32_t numGeometries = targetScene.geometryArray.size();
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			if (!targetScene.geometryArray[geoIdx].deformable)
+				pack_geometry_attributes(targetScene, geoIdx);
 		}
+	}
+
+	void set_geometry_reflection(TScene& targetScene, uint32_t geometryIdx, float reflectionCoefficient)
+	{
+		targetScene.geometryArray[geometryIdx].reflectionCoefficient = reflectionCoefficient;
+	}
 
+	void set_primitive_reflection(TScene& targetScene, uint32_t primitiveIdx, float reflectionCoefficient)
+	{
+		targetScene.primitiveArray[primitiveIdx].reflectionCoefficient = reflectionCoefficient;
+	}
+
+	void set_geometry_attributes(TScene& targetScene, uint32_t geometryIdx, const float* attributeArray, uint32_t numComponents)
+	{
+		assert_msg(numComponents <= 16, "Too many attribute components");
+		TGeometry& targetGeometry = targetScene.geometryArray[geometryIdx];
+		uint32_t numVerts = targetGeometry.vertexArray.size();
+		targetGeometry.numAttributeComponents = numComponents;
+		targetGeometry.attributeArray.resize(numVerts * numComponents);
+		memcpy(targetGeometry.attributeArray.begin(), attributeArray, sizeof(float) * numVerts * numComponents);
 	}
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+// sdk includes
+#include "rcu_model/tile_cache.h"
+
+// External includes
+#include <stdio.h>
+#include <string.h>
+#if defined(WINDOWSPC)
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace rcu
+{
+	struct TTileCacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t numGeometries;
+		uint32_t numPrimitives;
+	};
+
+	// Fixed part of a geometry, followed by its vertices, normals, texture coordinates, triangles and attributes. The normals and
+	// texture coordinates of the packed geometries are stored in their compressed form.
+	struct TTileGeometryHeader
+	{
+		uint32_t gameObjectID;
+		uint32_t subMeshID;
+		uint32_t layerMask;
+		uint32_t flags;
+		bento::Matrix4 transform;
+		bento::Matrix4 normalMatrix;
+		float reflectionCoefficient;
+		uint32_t numVerts;
+		uint32_t numNormals;
+		uint32_t numTexCoords;
+		uint32_t numTriangles;
+		uint32_t numAttributeComponents;
+		uint32_t numAttributes;
+	};
+
+	#define RCU_TILE_GEOMETRY_QUADS 0x1
+	#define RCU_TILE_GEOMETRY_DEFORMABLE 0x2
+	#define RCU_TILE_GEOMETRY_INSTANCED 0x4
+	#define RCU_TILE_GEOMETRY_PACKED 0x8
+
+	// Read only view of a whole file
+	struct TMappedFile
+	{
+		const uint8_t* data;
+		uint64_t size;
+	#if defined(WINDOWSPC)
+		HANDLE file;
+		HANDLE mapping;
+	#endif
+	};
+
+	static bool map_file(const char* path, TMappedFile& mappedFile)
+	{
+		mappedFile.data = nullptr;
+		mappedFile.size = 0;
+	#if defined(WINDOWSPC)
+		mappedFile.file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (mappedFile.file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		mappedFile.mapping = nullptr;
+		if (GetFileSizeEx(mappedFile.file, &fileSize) && fileSize.QuadPart > 0)
+			mappedFile.mapping = CreateFileMappingA(mappedFile.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappedFile.mapping == nullptr)
+		{
+			CloseHandle(mappedFile.file);
+			return false;
+		}
+		mappedFile.data = (const uint8_t*)MapViewOfFile(mappedFile.mapping, FILE_MAP_READ, 0, 0, 0);
+		if (mappedFile.data == nullptr)
+		{
+			CloseHandle(mappedFile.mapping);
+			CloseHandle(mappedFile.file);
+			return false;
+		}
+		mappedFile.size = (uint64_t)fileSize.QuadPart;
+	#else
+		int fileDescriptor = open(path, O_RDONLY);
+		if (fileDescriptor < 0)
+			return false;
+		struct stat fileStatus;
+		void* data = MAP_FAILED;
+		if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0)
+			data = mmap(nullptr, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		// The mapping keeps its own reference to the file
+		close(fileDescriptor);
+		if (data == MAP_FAILED)
+			return false;
+		mappedFile.data = (const uint8_t*)data;
+		mappedFile.size = (uint64_t)fileStatus.st_size;
+	#endif
+		return true;
+	}
+
+	static void unmap_file(TMappedFile& mappedFile)
+	{
+	#if defined(WINDOWSPC)
+		UnmapViewOfFile(mappedFile.data);
+		CloseHandle(mappedFile.mapping);
+		CloseHandle(mappedFile.file);
+	#else
+		munmap((void*)mappedFile.data, (size_t)mappedFile.size);
+	#endif
+		mappedFile.data = nullptr;
+		mappedFile.size = 0;
+	}
+
+	static bool write_block(FILE* file, const void* data, size_t size)
+	{
+		return size == 0 || fwrite(data, 1, size, file) == size;
+	}
+
+	bool write_tile_cache(const TScene& scene, const char* path)
+	{
+		FILE* file = fopen(path, "wb");
+		if (file == nullptr)
+			return false;
+
+		TTileCacheHeader header;
+		header.magic = RCU_TILE_CACHE_MAGIC;
+		header.version = RCU_TILE_CACHE_VERSION;
+		header.numGeometries = scene.geometryArray.size();
+		header.numPrimitives = scene.primitiveArray.size();
+		bool success = write_block(file, &header, sizeof(header));
+
+		for (uint32_t geoIdx = 0; geoIdx < header.numGeometries && success; ++geoIdx)
+		{
+			const TGeometry& geometry = scene.geometryArray[geoIdx];
+			TTileGeometryHeader geometryHeader;
+			memset(&geometryHeader, 0, sizeof(geometryHeader));
+			geometryHeader.gameObjectID = geometry.gameObjectID;
+			geometryHeader.subMeshID = geometry.subMeshID;
+			geometryHeader.layerMask = geometry.layerMask;
+			geometryHeader.flags = (geometry.quadTopology ? RCU_TILE_GEOMETRY_QUADS : 0) | (geometry.deformable ? RCU_TILE_GEOMETRY_DEFORMABLE : 0) | (geometry.instanced ? RCU_TILE_GEOMETRY_INSTANCED : 0)
+				| (geometry.packedAttributes ? RCU_TILE_GEOMETRY_PACKED : 0);
+			geometryHeader.transform = geometry.transform;
+			geometryHeader.normalMatrix = geometry.normalMatrix;
+			geometryHeader.reflectionCoefficient = geometry.reflectionCoefficient;
+			geometryHeader.numVerts = geometry.vertexArray.size();
+			geometryHeader.numNormals = geometry.packedAttributes ? geometry.packedNormalArray.size() : geometry.normalArray.size();
+			geometryHeader.numTexCoords = geometry.packedAttributes ? geometry.packedTexCoordArray.size() : geometry.texCoordArray.size();
+			geometryHeader.numTriangles = geometry.indexArray.size();
+			geometryHeader.numAttributeComponents = geometry.numAttributeComponents;
+			geometryHeader.numAttributes = geometry.attributeArray.size();
+
+			success = write_block(file, &geometryHeader, sizeof(geometryHeader))
+				&& write_block(file, geometry.vertexArray.begin(), sizeof(bento::Vector3) * geometryHeader.numVerts);
+			if (geometry.packedAttributes)
+			{
+				success = success
+					&& write_block(file, geometry.packedNormalArray.begin(), sizeof(uint32_t) * geometryHeader.numNormals)
+					&& write_block(file, geometry.packedTexCoordArray.begin(), sizeof(uint32_t) * geometryHeader.numTexCoords);
+			}
+			else
+			{
+				success = success
+					&& write_block(file, geometry.normalArray.begin(), sizeof(bento::Vector3) * geometryHeader.numNormals)
+					&& write_block(file, geometry.texCoordArray.begin(), sizeof(bento::Vector2) * geometryHeader.numTexCoords);
+			}
+			success = success
+				&& write_block(file, geometry.indexArray.begin(), sizeof(bento::IVector3) * geometryHeader.numTriangles)
+				&& write_block(file, geometry.attributeArray.begin(), sizeof(float) * geometryHeader.numAttributes);
+		}
+		success = success && write_block(file, scene.primitiveArray.begin(), sizeof(TPrimitive) * header.numPrimitives);
+		success = fclose(file) == 0 && success;
+		return success;
+	}
+
+	// Walks the mapped file, every read is checked against the end of the file
+	struct TCacheCursor
+	{
+		const uint8_t* data;
+		uint64_t remaining;
+
+		const void* take(uint64_t size)
+		{
+			if (size > remaining)
+				return nullptr;
+			const void* block = data;
+			data += size;
+			remaining -= size;
+			return block;
+		}
+	};
+
+	template<typename T>
+	static void read_array(TCacheCursor& cursor, uint32_t count, bento::Vector<T>& array)
+	{
+		const void* block = cursor.take(sizeof(T) * (uint64_t)count);
+		array.resize(count);
+		if (count > 0)
+			memcpy(array.begin(), block, sizeof(T) * count);
+	}
+
+	// Checks that all the blocks announced by the headers are in the file and that the geometries are consistent: per vertex arrays
+	// of the vertex count and triangles that only index existing vertices
+	static bool validate_tile_cache(TCacheCursor cursor)
+	{
+		const TTileCacheHeader* header = (const TTileCacheHeader*)cursor.take(sizeof(TTileCacheHeader));
+		if (header == nullptr || header->magic != RCU_TILE_CACHE_MAGIC || header->version != RCU_TILE_CACHE_VERSION)
+			return false;
+
+		for (uint32_t geoIdx = 0; geoIdx < header->numGeometries; ++geoIdx)
+		{
+			const TTileGeometryHeader* geometryHeader = (const TTileGeometryHeader*)cursor.take(sizeof(TTileGeometryHeader));
+			if (geometryHeader == nullptr)
+				return false;
+			uint32_t numVerts = geometryHeader->numVerts;
+			if (geometryHeader->numNormals != numVerts || geometryHeader->numTexCoords != numVerts)
+				return false;
+			if (geometryHeader->numAttributeComponents > 16 || (uint64_t)geometryHeader->numAttributes != (uint64_t)numVerts * geometryHeader->numAttributeComponents)
+				return false;
+			if ((geometryHeader->flags & RCU_TILE_GEOMETRY_QUADS) != 0 && (geometryHeader->numTriangles % 2) != 0)
+				return false;
+
+			bool packed = (geometryHeader->flags & RCU_TILE_GEOMETRY_PACKED) != 0;
+			uint64_t vertexSize = sizeof(bento::Vector3) + (packed ? 2 * sizeof(uint32_t) : sizeof(bento::Vector3) + sizeof(bento::Vector2));
+			if (cursor.take(vertexSize * numVerts) == nullptr)
+				return false;
+			const int32_t* indices = (const int32_t*)cursor.take(sizeof(bento::IVector3) * (uint64_t)geometryHeader->numTriangles);
+			if (indices == nullptr)
+				return false;
+			for (uint64_t indexIdx = 0; indexIdx < 3 * (uint64_t)geometryHeader->numTriangles; ++indexIdx)
+			{
+				int32_t index;
+				memcpy(&index, indices + indexIdx, sizeof(index));
+				if (index < 0 || (uint32_t)index >= numVerts)
+					return false;
+			}
+			if (cursor.take(sizeof(float) * (uint64_t)geometryHeader->numAttributes) == nullptr)
+				return false;
+		}
+		return cursor.take(sizeof(TPrimitive) * (uint64_t)header->numPrimitives) != nullptr;
+	}
+
+	bool read_tile_cache(const char* path, TScene& scene)
+	{
+		TMappedFile mappedFile;
+		if (!map_file(path, mappedFile))
+			return false;
+
+		// Nothing is appended unless the whole file is valid
+		TCacheCursor cursor = { mappedFile.data, mappedFile.size };
+		if (!validate_tile_cache(cursor))
+		{
+			unmap_file(mappedFile);
+			return false;
+		}
+
+		const TTileCacheHeader* header = (const TTileCacheHeader*)cursor.take(sizeof(TTileCacheHeader));
+		for (uint32_t geoIdx = 0; geoIdx < header->numGeometries; ++geoIdx)
+		{
+			const TTileGeometryHeader* geometryHeader = (const TTileGeometryHeader*)cursor.take(sizeof(TTileGeometryHeader));
+			TGeometry& geometry = scene.geometryArray.extend();
+			geometry.gameObjectID = geometryHeader->gameObjectID;
+			geometry.subMeshID = geometryHeader->subMeshID;
+			geometry.layerMask = geometryHeader->layerMask;
+			geometry.quadTopology = (geometryHeader->flags & RCU_TILE_GEOMETRY_QUADS) != 0;
+			geometry.deformable = (geometryHeader->flags & RCU_TILE_GEOMETRY_DEFORMABLE) != 0;
+			geometry.instanced = (geometryHeader->flags & RCU_TILE_GEOMETRY_INSTANCED) != 0;
+			geometry.transform = geometryHeader->transform;
+			geometry.normalMatrix = geometryHeader->normalMatrix;
+			geometry.reflectionCoefficient = geometryHeader->reflectionCoefficient;
+			geometry.numAttributeComponents = geometryHeader->numAttributeComponents;
+			read_array(cursor, geometryHeader->numVerts, geometry.vertexArray);
+			geometry.packedAttributes = (geometryHeader->flags & RCU_TILE_GEOMETRY_PACKED) != 0;
+			if (geometry.packedAttributes)
+			{
+				read_array(cursor, geometryHeader->numNormals, geometry.packedNormalArray);
+				read_array(cursor, geometryHeader->numTexCoords, geometry.packedTexCoordArray);
+			}
+			else
+			{
+				read_array(cursor, geometryHeader->numNormals, geometry.normalArray);
+				read_array(cursor, geometryHeader->numTexCoords, geometry.texCoordArray);
+			}
+			read_array(cursor, geometryHeader->numTriangles, geometry.indexArray);
+			read_array(cursor, geometryHeader->numAttributes, geometry.attributeArray);
+		}
+
+		uint32_t numPrimitives = header->numPrimitives;
+		if (numPrimitives > 0)
+		{
+			uint32_t previousPrimitives = scene.primitiveArray.size();
+			scene.primitiveArray.resize(previousPrimitives + numPrimitives);
+			memcpy(scene.primitiveArray.begin() + previousPrimitives, cursor.take(sizeof(TPrimitive) * numPrimitives), sizeof(TPrimitive) * numPrimitives);
+		}
+		unmap_file(mappedFile);
+		return true;
+	}
+}
@@ -0,0 +1,130 @@
+// sdk includes
+#include "rcu_raycast/ambient_occlusion.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+
+// External includes
+#include <math.h>
+
+namespace rcu
+{
+	// Distance the rays are pushed away from the surface, relative to the magnitude of the point position
+	#define RCU_OCCLUSION_RAY_OFFSET 1e-4f
+
+	static const float PI = 3.14159265358979f;
+
+	// Van der Corput sequence, pairs with (i + jitter) / n to stratify the two sample dimensions
+	static inline float radical_inverse(uint32_t bits)
+	{
+		bits = (bits << 16u) | (bits >> 16u);
+		bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+		bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+		bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+		bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+		return (float)bits * 2.3283064365386963e-10f;
+	}
+
+	// Decorrelates the sample patterns of neighbouring points
+	static inline uint32_t hash(uint32_t value)
+	{
+		value ^= value >> 16;
+		value *= 0x7feb352du;
+		value ^= value >> 15;
+		value *= 0x846ca68bu;
+		value ^= value >> 16;
+		return value;
+	}
+
+	static inline float to_unit_float(uint32_t value)
+	{
+		return (float)(value >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Orthonormal basis around a unit normal (Duff et al., Building an Orthonormal Basis, Revisited)
+	static inline void tangent_frame(const bento::Vector3& normal, bento::Vector3& tangent, bento::Vector3& bitangent)
+	{
+		float sign = copysignf(1.0f, normal.z);
+		float a = -1.0f / (sign + normal.z);
+		float b = normal.x * normal.y * a;
+		tangent = { 1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x };
+		bitangent = { b, sign + normal.y * normal.y * a, -normal.y };
+	}
+
+	void estimate_ambient_occlusion(const TSceneVersion& version, const TOcclusionPoint* pointArray, uint32_t numPoints, uint32_t numSamples, float radius, uint32_t mask, float* visibilityArray)
+	{
+		#pragma omp parallel for
+		for (int32_t pointIdx = 0; pointIdx < (int32_t)numPoints; ++pointIdx)
+		{
+			if (numSamples == 0)
+			{
+				visibilityArray[pointIdx] = 1.0f;
+				continue;
+			}
+
+			const TOcclusionPoint& point = pointArray[pointIdx];
+			bento::Vector3 normal = bento::normalize(point.normal);
+			bento::Vector3 tangent, bitangent;
+			tangent_frame(normal, tangent, bitangent);
+			float magnitude = fmaxf(1.0f, fmaxf(fabsf(point.position.x), fmaxf(fabsf(point.position.y), fabsf(point.position.z))));
+			bento::Vector3 origin = point.position + normal * (RCU_OCCLUSION_RAY_OFFSET * magnitude);
+
+			// Per point rotation of the stratified pattern
+			uint32_t seed = hash((uint32_t)pointIdx);
+			float rotation = to_unit_float(seed);
+			float invNumSamples = 1.0f / (float)numSamples;
+
+			RTCIntersectContext context;
+			rtcInitIntersectContext(&context);
+
+			uint32_t numOccluded = 0;
+			for (uint32_t firstSample = 0; firstSample < numSamples; firstSample += 16)
+			{
+				alignas(64) RTCRay16 rays;
+				alignas(64) int valid[16];
+				uint32_t numLanes = numSamples - firstSample < 16 ? numSamples - firstSample : 16;
+				for (uint32_t laneIdx = 0; laneIdx < 16; ++laneIdx)
+				{
+					if (laneIdx >= numLanes)
+					{
+						valid[laneIdx] = 0;
+						continue;
+					}
+					valid[laneIdx] = -1;
+
+					// Stratum i along the elevation, jittered, and a rotated van der Corput value along the azimuth
+					uint32_t sampleIdx = firstSample + laneIdx;
+					float u1 = ((float)sampleIdx + to_unit_float(hash(seed + sampleIdx))) * invNumSamples;
+					float u2 = radical_inverse(sampleIdx) + rotation;
+					u2 -= floorf(u2);
+
+					// Cosine-weighted direction
+					float sinTheta = sqrtf(u1);
+					float cosTheta = sqrtf(fmaxf(0.0f, 1.0f - u1));
+					float phi = 2.0f * PI * u2;
+					bento::Vector3 direction = tangent * (sinTheta * cosf(phi)) + bitangent * (sinTheta * sinf(phi)) + normal * cosTheta;
+
+					rays.org_x[laneIdx] = origin.x;
+					rays.org_y[laneIdx] = origin.y;
+					rays.org_z[laneIdx] = origin.z;
+					rays.dir_x[laneIdx] = direction.x;
+					rays.dir_y[laneIdx] = direction.y;
+					rays.dir_z[laneIdx] = direction.z;
+					rays.tnear[laneIdx] = 0.0f;
+					rays.tfar[laneIdx] = radius;
+					rays.mask[laneIdx] = mask;
+					rays.time[laneIdx] = 0.0f;
+					rays.id[laneIdx] = sampleIdx;
+					rays.flags[laneIdx] = 0;
+				}
+
+				rtcOccluded16(valid, version.scene, &context, &rays);
+
+				// Occluded rays come back with a negative infinite tfar
+				for (uint32_t laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+					numOccluded += rays.tfar[laneIdx] < 0.0f ? 1 : 0;
+			}
+			visibilityArray[pointIdx] = 1.0f - (float)numOccluded * invNumSamples;
+		}
+	}
+}
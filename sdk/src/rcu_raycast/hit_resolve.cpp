@@ -0,0 +1,330 @@
+// sdk includes
+#include "rcu_raycast/hit_resolve.h"
+
+// External includes
+#include <immintrin.h>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#define RCU_TARGET_AVX2
+#else
+	#include <cpuid.h>
+	#define RCU_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace rcu
+{
+	THitBuffer::THitBuffer(bento::IAllocator& allocator)
+	: rayIndexArray(allocator)
+	, geometryArray(allocator)
+	, primitiveArray(allocator)
+	, tArray(allocator)
+	, uArray(allocator)
+	, vArray(allocator)
+	{
+	}
+
+	void THitBuffer::resize(uint32_t numHits)
+	{
+		rayIndexArray.resize(numHits);
+		geometryArray.resize(numHits);
+		primitiveArray.resize(numHits);
+		tArray.resize(numHits);
+		uArray.resize(numHits);
+		vArray.resize(numHits);
+	}
+
+	TAttributeBuffer::TAttributeBuffer(bento::IAllocator& allocator)
+	: numHits(0)
+	, dataArray(allocator)
+	{
+	}
+
+	void TAttributeBuffer::resize(uint32_t hitCount)
+	{
+		numHits = hitCount;
+		dataArray.resize(NumChannels * hitCount);
+	}
+
+	void sort_hits_by_geometry(const THitBuffer& hits, uint32_t numGeometries, bento::Vector<uint32_t>& counterArray, THitBuffer& sortedHits)
+	{
+		uint32_t numHits = hits.size();
+		sortedHits.resize(numHits);
+
+		// Counting sort, the number of geometries is small compared to the number of hits
+		counterArray.resize(numGeometries + 1);
+		memset(counterArray.begin(), 0, sizeof(uint32_t) * (numGeometries + 1));
+		for (uint32_t hitIdx = 0; hitIdx < numHits; ++hitIdx)
+			counterArray[hits.geometryArray[hitIdx] + 1]++;
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+			counterArray[geoIdx + 1] += counterArray[geoIdx];
+
+		for (uint32_t hitIdx = 0; hitIdx < numHits; ++hitIdx)
+		{
+			uint32_t targetIdx = counterArray[hits.geometryArray[hitIdx]]++;
+			sortedHits.rayIndexArray[targetIdx] = hits.rayIndexArray[hitIdx];
+			sortedHits.geometryArray[targetIdx] = hits.geometryArray[hitIdx];
+			sortedHits.primitiveArray[targetIdx] = hits.primitiveArray[hitIdx];
+			sortedHits.tArray[targetIdx] = hits.tArray[hitIdx];
+			sortedHits.uArray[targetIdx] = hits.uArray[hitIdx];
+			sortedHits.vArray[targetIdx] = hits.vArray[hitIdx];
+		}
+	}
+
+	static void resolve_hits_scalar(const TScene& scene, const THitBuffer& hits, uint32_t attributeMask, uint32_t firstHit, uint32_t lastHit, TAttributeBuffer& attributes)
+	{
+		for (uint32_t hitIdx = firstHit; hitIdx < lastHit; ++hitIdx)
+		{
+			// Analytic primitives are evaluated from their surface parameters
+			if (hits.geometryArray[hitIdx] == primitive_slot(scene))
+			{
+				bento::Vector3 position, normal;
+				bento::Vector2 texCoord;
+				resolve_primitive_hit(scene, hits.primitiveArray[hitIdx], hits.uArray[hitIdx], hits.vArray[hitIdx], position, normal, texCoord);
+				attributes.channel(TAttributeBuffer::PositionX)[hitIdx] = position.x;
+				attributes.channel(TAttributeBuffer::PositionY)[hitIdx] = position.y;
+				attributes.channel(TAttributeBuffer::PositionZ)[hitIdx] = position.z;
+				attributes.channel(TAttributeBuffer::NormalX)[hitIdx] = normal.x;
+				attributes.channel(TAttributeBuffer::NormalY)[hitIdx] = normal.y;
+				attributes.channel(TAttributeBuffer::NormalZ)[hitIdx] = normal.z;
+				attributes.channel(TAttributeBuffer::TexCoordX)[hitIdx] = texCoord.x;
+				attributes.channel(TAttributeBuffer::TexCoordY)[hitIdx] = texCoord.y;
+				continue;
+			}
+
+			const TGeometry& targetGeometry = scene.geometryArray[hits.geometryArray[hitIdx]];
+			const bento::IVector3& currentFace = targetGeometry.indexArray[hits.primitiveArray[hitIdx]];
+			float u = hits.uArray[hitIdx];
+			float v = hits.vArray[hitIdx];
+			float w = 1.0f - u - v;
+
+			// Interpolate the position
+			if (attributeMask & ResolveAttribute::Position)
+			{
+				const bento::Vector3& p0 = targetGeometry.vertexArray[currentFace.x];
+				const bento::Vector3& p1 = targetGeometry.vertexArray[currentFace.y];
+				const bento::Vector3& p2 = targetGeometry.vertexArray[currentFace.z];
+				attributes.channel(TAttributeBuffer::PositionX)[hitIdx] = p0.x * w + p1.x * u + p2.x * v;
+				attributes.channel(TAttributeBuffer::PositionY)[hitIdx] = p0.y * w + p1.y * u + p2.y * v;
+				attributes.channel(TAttributeBuffer::PositionZ)[hitIdx] = p0.z * w + p1.z * u + p2.z * v;
+			}
+
+			// Interpolate the normal
+			if (attributeMask & ResolveAttribute::Normal)
+			{
+				bento::Vector3 n0 = vertex_normal(targetGeometry, currentFace.x);
+				bento::Vector3 n1 = vertex_normal(targetGeometry, currentFace.y);
+				bento::Vector3 n2 = vertex_normal(targetGeometry, currentFace.z);
+				attributes.channel(TAttributeBuffer::NormalX)[hitIdx] = n0.x * w + n1.x * u + n2.x * v;
+				attributes.channel(TAttributeBuffer::NormalY)[hitIdx] = n0.y * w + n1.y * u + n2.y * v;
+				attributes.channel(TAttributeBuffer::NormalZ)[hitIdx] = n0.z * w + n1.z * u + n2.z * v;
+			}
+
+			// Interpolate the texCoord
+			if (attributeMask & ResolveAttribute::TexCoord)
+			{
+				bento::Vector2 t0 = vertex_tex_coord(targetGeometry, currentFace.x);
+				bento::Vector2 t1 = vertex_tex_coord(targetGeometry, currentFace.y);
+				bento::Vector2 t2 = vertex_tex_coord(targetGeometry, currentFace.z);
+				attributes.channel(TAttributeBuffer::TexCoordX)[hitIdx] = t0.x * w + t1.x * u + t2.x * v;
+				attributes.channel(TAttributeBuffer::TexCoordY)[hitIdx] = t0.y * w + t1.y * u + t2.y * v;
+			}
+		}
+	}
+
+	// Interpolates numComponents interleaved floats of the three vertices of 8 triangles
+	RCU_TARGET_AVX2 static inline void interpolate_8(const float* data, uint32_t numComponents, __m256i i0, __m256i i1, __m256i i2, __m256 w, __m256 u, __m256 v, float** outChannels, uint32_t hitIdx)
+	{
+		__m256i stride = _mm256_set1_epi32((int)numComponents);
+		__m256i base0 = _mm256_mullo_epi32(i0, stride);
+		__m256i base1 = _mm256_mullo_epi32(i1, stride);
+		__m256i base2 = _mm256_mullo_epi32(i2, stride);
+		for (uint32_t compIdx = 0; compIdx < numComponents; ++compIdx)
+		{
+			__m256i offset = _mm256_set1_epi32((int)compIdx);
+			__m256 a0 = _mm256_i32gather_ps(data, _mm256_add_epi32(base0, offset), 4);
+			__m256 a1 = _mm256_i32gather_ps(data, _mm256_add_epi32(base1, offset), 4);
+			__m256 a2 = _mm256_i32gather_ps(data, _mm256_add_epi32(base2, offset), 4);
+			__m256 result = _mm256_add_ps(_mm256_mul_ps(a0, w), _mm256_add_ps(_mm256_mul_ps(a1, u), _mm256_mul_ps(a2, v)));
+			_mm256_storeu_ps(outChannels[compIdx] + hitIdx, result);
+		}
+	}
+
+	// Decodes 8 octahedral normals, same steps as decode_octahedral
+	RCU_TARGET_AVX2 static inline void decode_octahedral_8(__m256i packed, __m256& x, __m256& y, __m256& z)
+	{
+		const __m256 scale = _mm256_set1_ps(2.0f / 65535.0f);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+		x = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(packed, _mm256_set1_epi32(0xffff))), scale), one);
+		y = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(packed, 16)), scale), one);
+		z = _mm256_sub_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signMask, x)), _mm256_andnot_ps(signMask, y));
+		__m256 t = _mm256_max_ps(_mm256_sub_ps(_mm256_setzero_ps(), z), _mm256_setzero_ps());
+		x = _mm256_sub_ps(x, _mm256_or_ps(t, _mm256_and_ps(x, signMask)));
+		y = _mm256_sub_ps(y, _mm256_or_ps(t, _mm256_and_ps(y, signMask)));
+		__m256 invLength = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z))));
+		x = _mm256_mul_ps(x, invLength);
+		y = _mm256_mul_ps(y, invLength);
+		z = _mm256_mul_ps(z, invLength);
+	}
+
+	// Decodes 8 half floats held in the low 16 bits of the lanes, same steps as half_to_float
+	RCU_TARGET_AVX2 static inline __m256 half_to_float_8(__m256i half)
+	{
+		__m256i magnitude = _mm256_slli_epi32(_mm256_and_si256(half, _mm256_set1_epi32(0x7fff)), 13);
+		__m256i sign = _mm256_slli_epi32(_mm256_and_si256(half, _mm256_set1_epi32(0x8000)), 16);
+		__m256 value = _mm256_mul_ps(_mm256_castsi256_ps(magnitude), _mm256_set1_ps(RCU_HALF_EXPONENT_SCALE));
+		return _mm256_or_ps(value, _mm256_castsi256_ps(sign));
+	}
+
+	RCU_TARGET_AVX2 static inline __m256 barycentric_8(__m256 a0, __m256 a1, __m256 a2, __m256 w, __m256 u, __m256 v)
+	{
+		return _mm256_add_ps(_mm256_mul_ps(a0, w), _mm256_add_ps(_mm256_mul_ps(a1, u), _mm256_mul_ps(a2, v)));
+	}
+
+	// Gathers, decodes and interpolates the packed normals of the three vertices of 8 triangles
+	RCU_TARGET_AVX2 static inline void interpolate_octahedral_8(const uint32_t* data, __m256i i0, __m256i i1, __m256i i2, __m256 w, __m256 u, __m256 v, float** outChannels, uint32_t hitIdx)
+	{
+		__m256 x0, y0, z0, x1, y1, z1, x2, y2, z2;
+		decode_octahedral_8(_mm256_i32gather_epi32((const int*)data, i0, 4), x0, y0, z0);
+		decode_octahedral_8(_mm256_i32gather_epi32((const int*)data, i1, 4), x1, y1, z1);
+		decode_octahedral_8(_mm256_i32gather_epi32((const int*)data, i2, 4), x2, y2, z2);
+		_mm256_storeu_ps(outChannels[0] + hitIdx, barycentric_8(x0, x1, x2, w, u, v));
+		_mm256_storeu_ps(outChannels[1] + hitIdx, barycentric_8(y0, y1, y2, w, u, v));
+		_mm256_storeu_ps(outChannels[2] + hitIdx, barycentric_8(z0, z1, z2, w, u, v));
+	}
+
+	// Gathers, decodes and interpolates the packed texture coordinates of the three vertices of 8 triangles
+	RCU_TARGET_AVX2 static inline void interpolate_half2_8(const uint32_t* data, __m256i i0, __m256i i1, __m256i i2, __m256 w, __m256 u, __m256 v, float** outChannels, uint32_t hitIdx)
+	{
+		__m256i p0 = _mm256_i32gather_epi32((const int*)data, i0, 4);
+		__m256i p1 = _mm256_i32gather_epi32((const int*)data, i1, 4);
+		__m256i p2 = _mm256_i32gather_epi32((const int*)data, i2, 4);
+		_mm256_storeu_ps(outChannels[0] + hitIdx, barycentric_8(half_to_float_8(p0), half_to_float_8(p1), half_to_float_8(p2), w, u, v));
+		_mm256_storeu_ps(outChannels[1] + hitIdx, barycentric_8(half_to_float_8(_mm256_srli_epi32(p0, 16)), half_to_float_8(_mm256_srli_epi32(p1, 16)), half_to_float_8(_mm256_srli_epi32(p2, 16)), w, u, v));
+	}
+
+	RCU_TARGET_AVX2 static void resolve_hits_avx2(const TScene& scene, const THitBuffer& hits, uint32_t attributeMask, TAttributeBuffer& attributes)
+	{
+		uint32_t numHits = hits.size();
+		float* positionChannels[3] = { attributes.channel(TAttributeBuffer::PositionX), attributes.channel(TAttributeBuffer::PositionY), attributes.channel(TAttributeBuffer::PositionZ) };
+		float* normalChannels[3] = { attributes.channel(TAttributeBuffer::NormalX), attributes.channel(TAttributeBuffer::NormalY), attributes.channel(TAttributeBuffer::NormalZ) };
+		float* texCoordChannels[2] = { attributes.channel(TAttributeBuffer::TexCoordX), attributes.channel(TAttributeBuffer::TexCoordY) };
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256i three = _mm256_set1_epi32(3);
+
+		uint32_t hitIdx = 0;
+		while (hitIdx < numHits)
+		{
+			// Find the run of hits that share the geometry, gathers need a single base pointer
+			uint32_t geometryIdx = hits.geometryArray[hitIdx];
+			uint32_t runEnd = hitIdx + 1;
+			while (runEnd < numHits && hits.geometryArray[runEnd] == geometryIdx)
+				runEnd++;
+
+			// Analytic primitives have no vertex data to gather
+			if (geometryIdx == primitive_slot(scene))
+			{
+				resolve_hits_scalar(scene, hits, attributeMask, hitIdx, runEnd, attributes);
+				hitIdx = runEnd;
+				continue;
+			}
+
+			const TGeometry& targetGeometry = scene.geometryArray[geometryIdx];
+			const int* indexData = (const int*)targetGeometry.indexArray.begin();
+			for (; hitIdx + 8 <= runEnd; hitIdx += 8)
+			{
+				// Fetch the face indexes
+				__m256i triangleBase = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(hits.primitiveArray.begin() + hitIdx)), three);
+				__m256i i0 = _mm256_i32gather_epi32(indexData, triangleBase, 4);
+				__m256i i1 = _mm256_i32gather_epi32(indexData, _mm256_add_epi32(triangleBase, _mm256_set1_epi32(1)), 4);
+				__m256i i2 = _mm256_i32gather_epi32(indexData, _mm256_add_epi32(triangleBase, _mm256_set1_epi32(2)), 4);
+
+				// Barycentrics
+				__m256 u = _mm256_loadu_ps(hits.uArray.begin() + hitIdx);
+				__m256 v = _mm256_loadu_ps(hits.vArray.begin() + hitIdx);
+				__m256 w = _mm256_sub_ps(_mm256_sub_ps(one, u), v);
+
+				if (attributeMask & ResolveAttribute::Position)
+					interpolate_8((const float*)targetGeometry.vertexArray.begin(), 3, i0, i1, i2, w, u, v, positionChannels, hitIdx);
+				// The packed attributes are decoded right after the gathers
+				if ((attributeMask & ResolveAttribute::Normal) && targetGeometry.packedAttributes)
+					interpolate_octahedral_8(targetGeometry.packedNormalArray.begin(), i0, i1, i2, w, u, v, normalChannels, hitIdx);
+				else if (attributeMask & ResolveAttribute::Normal)
+					interpolate_8((const float*)targetGeometry.normalArray.begin(), 3, i0, i1, i2, w, u, v, normalChannels, hitIdx);
+				if ((attributeMask & ResolveAttribute::TexCoord) && targetGeometry.packedAttributes)
+					interpolate_half2_8(targetGeometry.packedTexCoordArray.begin(), i0, i1, i2, w, u, v, texCoordChannels, hitIdx);
+				else if (attributeMask & ResolveAttribute::TexCoord)
+					interpolate_8((const float*)targetGeometry.texCoordArray.begin(), 2, i0, i1, i2, w, u, v, texCoordChannels, hitIdx);
+			}
+
+			// Tail of the run
+			resolve_hits_scalar(scene, hits, attributeMask, hitIdx, runEnd, attributes);
+			hitIdx = runEnd;
+		}
+	}
+
+	// Moves the attributes interpolated in the local space of the instanced geometries to world space
+	static void transform_instanced_hits(const TScene& scene, const THitBuffer& hits, uint32_t attributeMask, TAttributeBuffer& attributes)
+	{
+		if ((attributeMask & (ResolveAttribute::Position | ResolveAttribute::Normal)) == 0)
+			return;
+
+		uint32_t numHits = hits.size();
+		uint32_t numGeometries = scene.geometryArray.size();
+		for (uint32_t hitIdx = 0; hitIdx < numHits; ++hitIdx)
+		{
+			uint32_t geometryIdx = hits.geometryArray[hitIdx];
+			if (geometryIdx >= numGeometries || !scene.geometryArray[geometryIdx].instanced)
+				continue;
+
+			const TGeometry& targetGeometry = scene.geometryArray[geometryIdx];
+			if (attributeMask & ResolveAttribute::Position)
+			{
+				bento::Vector3 position = { attributes.channel(TAttributeBuffer::PositionX)[hitIdx], attributes.channel(TAttributeBuffer::PositionY)[hitIdx], attributes.channel(TAttributeBuffer::PositionZ)[hitIdx] };
+				position = instance_position(targetGeometry, position);
+				attributes.channel(TAttributeBuffer::PositionX)[hitIdx] = position.x;
+				attributes.channel(TAttributeBuffer::PositionY)[hitIdx] = position.y;
+				attributes.channel(TAttributeBuffer::PositionZ)[hitIdx] = position.z;
+			}
+			if (attributeMask & ResolveAttribute::Normal)
+			{
+				bento::Vector3 normal = { attributes.channel(TAttributeBuffer::NormalX)[hitIdx], attributes.channel(TAttributeBuffer::NormalY)[hitIdx], attributes.channel(TAttributeBuffer::NormalZ)[hitIdx] };
+				normal = instance_normal(targetGeometry, normal);
+				attributes.channel(TAttributeBuffer::NormalX)[hitIdx] = normal.x;
+				attributes.channel(TAttributeBuffer::NormalY)[hitIdx] = normal.y;
+				attributes.channel(TAttributeBuffer::NormalZ)[hitIdx] = normal.z;
+			}
+		}
+	}
+
+	static bool cpu_supports_avx2()
+	{
+	#if defined(_MSC_VER)
+		int registers[4];
+		__cpuid(registers, 0);
+		if (registers[0] < 7)
+			return false;
+		__cpuid(registers, 1);
+		bool osxsave = (registers[2] & (1 << 27)) != 0;
+		bool avx = (registers[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+			return false;
+		__cpuidex(registers, 7, 0);
+		return (registers[1] & (1 << 5)) != 0;
+	#else
+		return __builtin_cpu_supports("avx2");
+	#endif
+	}
+
+	void resolve_hits(const TScene& scene, const THitBuffer& hits, uint32_t attributeMask, TAttributeBuffer& attributes)
+	{
+		static const bool useAVX2 = cpu_supports_avx2();
+
+		attributes.resize(hits.size());
+		if (useAVX2)
+			resolve_hits_avx2(scene, hits, attributeMask, attributes);
+		else
+			resolve_hits_scalar(scene, hits, attributeMask, 0, hits.size(), attributes);
+		transform_instanced_hits(scene, hits, attributeMask, attributes);
+	}
+}
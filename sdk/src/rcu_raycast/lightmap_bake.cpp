@@ -0,0 +1,159 @@
+// sdk includes
+#include "rcu_raycast/lightmap_bake.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+#include <bento_math/vector2.h>
+
+// External includes
+#include <math.h>
+#include <string.h>
+
+namespace rcu
+{
+	// Distance the shadow rays are pushed away from the surface, relative to the magnitude of the texel position
+	#define RCU_BAKE_RAY_OFFSET 1e-4f
+
+	TTexelBuffer::TTexelBuffer(bento::IAllocator& allocator)
+	: positionArray(allocator)
+	, normalArray(allocator)
+	, coveredArray(allocator)
+	{
+	}
+
+	void rasterize_texels(const TGeometry& geometry, uint32_t width, uint32_t height, TTexelBuffer& texels)
+	{
+		uint32_t numTexels = width * height;
+		texels.positionArray.resize(numTexels);
+		texels.normalArray.resize(numTexels);
+		texels.coveredArray.resize(numTexels);
+		memset(texels.coveredArray.begin(), 0, numTexels);
+
+		uint32_t numTriangles = geometry.indexArray.size();
+		for (uint32_t triIdx = 0; triIdx < numTriangles; ++triIdx)
+		{
+			// Triangle in texel space, the texel (x, y) is sampled at its center (x + 0.5, y + 0.5)
+			const bento::IVector3& face = geometry.indexArray[triIdx];
+			bento::Vector2 t0 = vertex_tex_coord(geometry, face.x);
+			bento::Vector2 t1 = vertex_tex_coord(geometry, face.y);
+			bento::Vector2 t2 = vertex_tex_coord(geometry, face.z);
+			float x0 = t0.x * width, y0 = t0.y * height;
+			float x1 = t1.x * width, y1 = t1.y * height;
+			float x2 = t2.x * width, y2 = t2.y * height;
+			float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+			if (area == 0.0f)
+				continue;
+			float invArea = 1.0f / area;
+
+			// Texels whose center can fall inside the triangle
+			int32_t minX = (int32_t)floorf(fminf(x0, fminf(x1, x2)) - 0.5f), maxX = (int32_t)ceilf(fmaxf(x0, fmaxf(x1, x2)) - 0.5f);
+			int32_t minY = (int32_t)floorf(fminf(y0, fminf(y1, y2)) - 0.5f), maxY = (int32_t)ceilf(fmaxf(y0, fmaxf(y1, y2)) - 0.5f);
+			minX = minX < 0 ? 0 : minX;
+			minY = minY < 0 ? 0 : minY;
+			maxX = maxX >= (int32_t)width ? (int32_t)width - 1 : maxX;
+			maxY = maxY >= (int32_t)height ? (int32_t)height - 1 : maxY;
+
+			for (int32_t y = minY; y <= maxY; ++y)
+			{
+				for (int32_t x = minX; x <= maxX; ++x)
+				{
+					// Barycentrics of the texel center, the sign of the area handles both windings
+					float px = x + 0.5f, py = y + 0.5f;
+					float u = ((px - x0) * (y2 - y0) - (x2 - x0) * (py - y0)) * invArea;
+					float v = ((x1 - x0) * (py - y0) - (px - x0) * (y1 - y0)) * invArea;
+					float w = 1.0f - u - v;
+					if (u < 0.0f || v < 0.0f || w < 0.0f)
+						continue;
+
+					uint32_t texelIdx = y * width + x;
+					bento::Vector3 position = geometry.vertexArray[face.x] * w + geometry.vertexArray[face.y] * u + geometry.vertexArray[face.z] * v;
+					bento::Vector3 normal = vertex_normal(geometry, face.x) * w + vertex_normal(geometry, face.y) * u + vertex_normal(geometry, face.z) * v;
+					if (geometry.instanced)
+					{
+						position = instance_position(geometry, position);
+						normal = instance_normal(geometry, normal);
+					}
+					texels.positionArray[texelIdx] = position;
+					texels.normalArray[texelIdx] = bento::normalize(normal);
+					texels.coveredArray[texelIdx] = 1;
+				}
+			}
+		}
+	}
+
+	void bake_texel_visibility(const TSceneVersion& version, const TTexelBuffer& texels, uint32_t width, uint32_t height, const TBakeLight* lightArray, uint32_t numLights, uint32_t mask, float* atlas)
+	{
+		uint32_t numTexels = width * height;
+		int32_t numPackets = (int32_t)((numTexels + 15) / 16);
+
+		// Every worker takes packets of 16 consecutive texels and tests them against all the lights
+		#pragma omp parallel for
+		for (int32_t packetIdx = 0; packetIdx < numPackets; ++packetIdx)
+		{
+			RTCIntersectContext context;
+			rtcInitIntersectContext(&context);
+
+			uint32_t firstTexel = packetIdx * 16;
+			uint32_t numLanes = numTexels - firstTexel < 16 ? numTexels - firstTexel : 16;
+			for (uint32_t lightIdx = 0; lightIdx < numLights; ++lightIdx)
+			{
+				const TBakeLight& light = lightArray[lightIdx];
+				float* lightPlane = atlas + (size_t)lightIdx * numTexels;
+
+				alignas(64) RTCRay16 rays;
+				alignas(64) int valid[16];
+				for (uint32_t laneIdx = 0; laneIdx < 16; ++laneIdx)
+				{
+					valid[laneIdx] = 0;
+					if (laneIdx >= numLanes)
+						continue;
+
+					uint32_t texelIdx = firstTexel + laneIdx;
+					if (!texels.coveredArray[texelIdx])
+					{
+						lightPlane[texelIdx] = -1.0f;
+						continue;
+					}
+
+					// Point lights are reached at t = 1, directional lights at their max distance
+					const bento::Vector3& position = texels.positionArray[texelIdx];
+					const bento::Vector3& normal = texels.normalArray[texelIdx];
+					float magnitude = fmaxf(1.0f, fmaxf(fabsf(position.x), fmaxf(fabsf(position.y), fabsf(position.z))));
+					bento::Vector3 origin = position + normal * (RCU_BAKE_RAY_OFFSET * magnitude);
+					bento::Vector3 direction = light.type == BakeLightType::Point ? light.vector - origin : bento::normalize(light.vector);
+					float tfar = light.type == BakeLightType::Point ? 1.0f : light.maxDistance;
+
+					// The surface itself hides the lights behind it
+					if (bento::dot(direction, normal) <= 0.0f)
+					{
+						lightPlane[texelIdx] = 0.0f;
+						continue;
+					}
+					valid[laneIdx] = -1;
+
+					rays.org_x[laneIdx] = origin.x;
+					rays.org_y[laneIdx] = origin.y;
+					rays.org_z[laneIdx] = origin.z;
+					rays.dir_x[laneIdx] = direction.x;
+					rays.dir_y[laneIdx] = direction.y;
+					rays.dir_z[laneIdx] = direction.z;
+					rays.tnear[laneIdx] = 0.0f;
+					rays.tfar[laneIdx] = tfar;
+					rays.mask[laneIdx] = mask;
+					rays.time[laneIdx] = 0.0f;
+					rays.id[laneIdx] = texelIdx;
+					rays.flags[laneIdx] = 0;
+				}
+
+				rtcOccluded16(valid, version.scene, &context, &rays);
+
+				// Occluded rays come back with a negative infinite tfar
+				for (uint32_t laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+				{
+					if (valid[laneIdx] != 0)
+						lightPlane[firstTexel + laneIdx] = rays.tfar[laneIdx] < 0.0f ? 0.0f : 1.0f;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,95 @@
+// sdk includes
+#include "rcu_raycast/line_of_sight.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+
+// External includes
+#include <string.h>
+
+namespace rcu
+{
+	// Fraction of the segment ignored at both ends so that points lying on a surface can still see each other
+	#define RCU_LOS_SEGMENT_MARGIN 1e-4f
+
+	// Traces the segments from a source to the targets [firstTarget, numTargets[ and sets the bits of the visible ones
+	static void trace_row(const TSceneVersion& version, const bento::Vector3& source, const bento::Vector3* targetArray, uint32_t firstTarget, uint32_t numTargets, uint32_t mask, uint32_t* row)
+	{
+		RTCIntersectContext context;
+		rtcInitIntersectContext(&context);
+
+		// All the lanes of a packet share the origin, which keeps the traversal coherent
+		for (uint32_t packetStart = firstTarget; packetStart < numTargets; packetStart += 16)
+		{
+			alignas(64) RTCRay16 rays;
+			alignas(64) int valid[16];
+			uint32_t numLanes = numTargets - packetStart < 16 ? numTargets - packetStart : 16;
+			for (uint32_t laneIdx = 0; laneIdx < 16; ++laneIdx)
+			{
+				valid[laneIdx] = laneIdx < numLanes ? -1 : 0;
+				if (laneIdx >= numLanes)
+					continue;
+
+				bento::Vector3 segment = targetArray[packetStart + laneIdx] - source;
+				rays.org_x[laneIdx] = source.x;
+				rays.org_y[laneIdx] = source.y;
+				rays.org_z[laneIdx] = source.z;
+				rays.dir_x[laneIdx] = segment.x;
+				rays.dir_y[laneIdx] = segment.y;
+				rays.dir_z[laneIdx] = segment.z;
+				rays.tnear[laneIdx] = RCU_LOS_SEGMENT_MARGIN;
+				rays.tfar[laneIdx] = 1.0f - RCU_LOS_SEGMENT_MARGIN;
+				rays.mask[laneIdx] = mask;
+				rays.time[laneIdx] = 0.0f;
+				rays.id[laneIdx] = packetStart + laneIdx;
+				rays.flags[laneIdx] = 0;
+			}
+
+			rtcOccluded16(valid, version.scene, &context, &rays);
+
+			// Occluded rays come back with a negative infinite tfar
+			for (uint32_t laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+			{
+				uint32_t targetIdx = packetStart + laneIdx;
+				if (rays.tfar[laneIdx] >= 0.0f)
+					row[targetIdx / 32] |= 1u << (targetIdx % 32);
+			}
+		}
+	}
+
+	void line_of_sight_matrix(const TSceneVersion& version, const bento::Vector3* sourceArray, uint32_t numSources, const bento::Vector3* targetArray, uint32_t numTargets, uint32_t mask, uint32_t* bitMatrix)
+	{
+		bool symmetric = targetArray == nullptr;
+		if (symmetric)
+		{
+			targetArray = sourceArray;
+			numTargets = numSources;
+		}
+		uint32_t rowWords = line_of_sight_row_words(numTargets);
+		memset(bitMatrix, 0, sizeof(uint32_t) * rowWords * numSources);
+
+		// One row per task, the symmetric case only traces the upper triangle
+		#pragma omp parallel for schedule(dynamic, 4)
+		for (int32_t sourceIdx = 0; sourceIdx < (int32_t)numSources; ++sourceIdx)
+		{
+			uint32_t* row = bitMatrix + (size_t)sourceIdx * rowWords;
+			trace_row(version, sourceArray[sourceIdx], targetArray, symmetric ? sourceIdx + 1 : 0, numTargets, mask, row);
+		}
+		if (!symmetric)
+			return;
+
+		// Every point sees itself, the lower triangle mirrors the traced half. Serial: a row is written while the rows below read the
+		// words of its upper half, and this is only bit work next to the tracing.
+		for (int32_t sourceIdx = 0; sourceIdx < (int32_t)numSources; ++sourceIdx)
+		{
+			uint32_t* row = bitMatrix + (size_t)sourceIdx * rowWords;
+			row[sourceIdx / 32] |= 1u << (sourceIdx % 32);
+			for (int32_t otherIdx = 0; otherIdx < sourceIdx; ++otherIdx)
+			{
+				const uint32_t* otherRow = bitMatrix + (size_t)otherIdx * rowWords;
+				if (otherRow[sourceIdx / 32] & (1u << (sourceIdx % 32)))
+					row[otherIdx / 32] |= 1u << (otherIdx % 32);
+			}
+		}
+	}
+}
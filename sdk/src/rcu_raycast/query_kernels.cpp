@@ -0,0 +1,204 @@
+// sdk includes
+#include "rcu_raycast/query_kernels.h"
+#include "rcu_raycast/hit_resolve.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+#include <bento_math/vector2.h>
+#include <bento_base/security.h>
+
+// External includes
+#include <float.h>
+
+namespace rcu
+{
+	template<int N>
+	struct TPacketIntersector;
+
+	template<>
+	struct TPacketIntersector<1>
+	{
+		static void intersect(const int*, RTCScene scene, RTCIntersectContext* context, RTCRayHitNt<1>& rayHit) { rtcIntersect1(scene, context, (RTCRayHit*)&rayHit); }
+	};
+
+	template<>
+	struct TPacketIntersector<4>
+	{
+		static void intersect(const int* valid, RTCScene scene, RTCIntersectContext* context, RTCRayHitNt<4>& rayHit) { rtcIntersect4(valid, scene, context, (RTCRayHit4*)&rayHit); }
+	};
+
+	template<>
+	struct TPacketIntersector<8>
+	{
+		static void intersect(const int* valid, RTCScene scene, RTCIntersectContext* context, RTCRayHitNt<8>& rayHit) { rtcIntersect8(valid, scene, context, (RTCRayHit8*)&rayHit); }
+	};
+
+	template<>
+	struct TPacketIntersector<16>
+	{
+		static void intersect(const int* valid, RTCScene scene, RTCIntersectContext* context, RTCRayHitNt<16>& rayHit) { rtcIntersect16(valid, scene, context, (RTCRayHit16*)&rayHit); }
+	};
+
+	template<uint32_t AttributeMask>
+	static inline void write_kernel_miss(TIntersection& currentIntersection)
+	{
+		currentIntersection.validity = 0;
+		currentIntersection.t = FLT_MAX;
+		currentIntersection.geometryID = (uint32_t)-1;
+		currentIntersection.subMeshID = (uint32_t)-1;
+		currentIntersection.triangleID = (uint32_t)-1;
+		if (AttributeMask & ResolveAttribute::Barycentrics)
+			currentIntersection.barycentricCoordinates = { 0, 0, 0 };
+		if (AttributeMask & ResolveAttribute::Position)
+			currentIntersection.position = { 0, 0, 0 };
+		if (AttributeMask & ResolveAttribute::Normal)
+			currentIntersection.normal = { 0, 0, 0 };
+		if (AttributeMask & ResolveAttribute::TexCoord)
+			currentIntersection.texCoord = { 0, 0 };
+	}
+
+	template<uint32_t AttributeMask>
+	static inline void write_kernel_hit(const TScene& targetScene, uint32_t geomID, uint32_t primID, float t, float u, float v, TIntersection& currentIntersection)
+	{
+		canonical_hit(targetScene, geomID, primID, u, v);
+		const float w = 1.0f - u - v;
+		currentIntersection.validity = 1;
+		currentIntersection.t = t;
+		hit_owner(targetScene, geomID, primID, currentIntersection.geometryID, currentIntersection.subMeshID, currentIntersection.triangleID);
+		if (AttributeMask & ResolveAttribute::Barycentrics)
+			currentIntersection.barycentricCoordinates = { w, u, v };
+
+		// Nothing else to fetch if no vertex attribute is requested
+		if ((AttributeMask & (ResolveAttribute::Position | ResolveAttribute::Normal | ResolveAttribute::TexCoord)) == 0)
+			return;
+
+		// Analytic primitives are evaluated from their surface parameters
+		if (geomID == primitive_slot(targetScene))
+		{
+			bento::Vector3 position, normal;
+			bento::Vector2 texCoord;
+			resolve_primitive_hit(targetScene, primID, u, v, position, normal, texCoord);
+			if (AttributeMask & ResolveAttribute::Position)
+				currentIntersection.position = position;
+			if (AttributeMask & ResolveAttribute::Normal)
+				currentIntersection.normal = normal;
+			if (AttributeMask & ResolveAttribute::TexCoord)
+				currentIntersection.texCoord = texCoord;
+			return;
+		}
+
+		const TGeometry& targetGeometry = targetScene.geometryArray[geomID];
+		const bento::IVector3& currentFace = targetGeometry.indexArray[primID];
+		if (AttributeMask & ResolveAttribute::Position)
+		{
+			currentIntersection.position = targetGeometry.vertexArray[currentFace.x] * w
+				+ targetGeometry.vertexArray[currentFace.y] * u
+				+ targetGeometry.vertexArray[currentFace.z] * v;
+			if (targetGeometry.instanced)
+				currentIntersection.position = instance_position(targetGeometry, currentIntersection.position);
+		}
+		if (AttributeMask & ResolveAttribute::Normal)
+		{
+			currentIntersection.normal = vertex_normal(targetGeometry, currentFace.x) * w
+				+ vertex_normal(targetGeometry, currentFace.y) * u
+				+ vertex_normal(targetGeometry, currentFace.z) * v;
+			if (targetGeometry.instanced)
+				currentIntersection.normal = instance_normal(targetGeometry, currentIntersection.normal);
+		}
+		if (AttributeMask & ResolveAttribute::TexCoord)
+		{
+			currentIntersection.texCoord = vertex_tex_coord(targetGeometry, currentFace.x) * w
+				+ vertex_tex_coord(targetGeometry, currentFace.y) * u
+				+ vertex_tex_coord(targetGeometry, currentFace.z) * v;
+		}
+	}
+
+	template<int N, uint32_t AttributeMask>
+	static void query_kernel_impl(const TSceneVersion& version, const TRay* rayArray, TIntersection* intersectionArray, uint32_t numRays)
+	{
+		const TScene& targetScene = *version.targetScene;
+
+		// The last packet is partially filled, its unused lanes are masked out
+		int32_t numPackets = (int32_t)((numRays + N - 1) / N);
+
+		#pragma omp parallel for
+		for (int32_t packetIdx = 0; packetIdx < numPackets; ++packetIdx)
+		{
+			RTCIntersectContext context;
+			rtcInitIntersectContext(&context);
+
+			// Packets live on the worker's stack
+			alignas(64) RTCRayHitNt<N> rayHit;
+			alignas(64) int valid[N];
+
+			uint32_t firstRay = packetIdx * N;
+			uint32_t numLanes = numRays - firstRay < (uint32_t)N ? numRays - firstRay : (uint32_t)N;
+			for (uint32_t laneIdx = 0; laneIdx < (uint32_t)N; ++laneIdx)
+			{
+				if (laneIdx >= numLanes)
+				{
+					valid[laneIdx] = 0;
+					continue;
+				}
+				valid[laneIdx] = -1;
+
+				const TRay& currentRay = rayArray[firstRay + laneIdx];
+				rayHit.ray.org_x[laneIdx] = currentRay.origin.x;
+				rayHit.ray.org_y[laneIdx] = currentRay.origin.y;
+				rayHit.ray.org_z[laneIdx] = currentRay.origin.z;
+				rayHit.ray.dir_x[laneIdx] = currentRay.direction.x;
+				rayHit.ray.dir_y[laneIdx] = currentRay.direction.y;
+				rayHit.ray.dir_z[laneIdx] = currentRay.direction.z;
+				rayHit.ray.tnear[laneIdx] = currentRay.tmin;
+				rayHit.ray.tfar[laneIdx] = currentRay.tmax;
+				rayHit.ray.mask[laneIdx] = currentRay.mask;
+				rayHit.ray.time[laneIdx] = 0.0f;
+				rayHit.ray.flags[laneIdx] = 0;
+				rayHit.hit.instID[0][laneIdx] = RTC_INVALID_GEOMETRY_ID;
+				rayHit.hit.geomID[laneIdx] = RTC_INVALID_GEOMETRY_ID;
+			}
+
+			TPacketIntersector<N>::intersect(valid, version.scene, &context, rayHit);
+
+			for (uint32_t laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+			{
+				TIntersection& currentIntersection = intersectionArray[firstRay + laneIdx];
+				if (rayHit.hit.geomID[laneIdx] != RTC_INVALID_GEOMETRY_ID)
+				{
+					uint32_t geomID = hit_slot(rayHit.hit.geomID[laneIdx], rayHit.hit.instID[0][laneIdx]);
+					uint32_t primID = rayHit.hit.primID[laneIdx];
+					unmerge_hit(version, geomID, primID);
+					write_kernel_hit<AttributeMask>(targetScene, geomID, primID, rayHit.ray.tfar[laneIdx], rayHit.hit.u[laneIdx], rayHit.hit.v[laneIdx], currentIntersection);
+				}
+				else
+				{
+					write_kernel_miss<AttributeMask>(currentIntersection);
+				}
+			}
+		}
+	}
+
+	#define RCU_QUERY_KERNEL_ROW(N) \
+		{ &query_kernel_impl<N, 0x0>, &query_kernel_impl<N, 0x1>, &query_kernel_impl<N, 0x2>, &query_kernel_impl<N, 0x3>, \
+		  &query_kernel_impl<N, 0x4>, &query_kernel_impl<N, 0x5>, &query_kernel_impl<N, 0x6>, &query_kernel_impl<N, 0x7>, \
+		  &query_kernel_impl<N, 0x8>, &query_kernel_impl<N, 0x9>, &query_kernel_impl<N, 0xa>, &query_kernel_impl<N, 0xb>, \
+		  &query_kernel_impl<N, 0xc>, &query_kernel_impl<N, 0xd>, &query_kernel_impl<N, 0xe>, &query_kernel_impl<N, 0xf> }
+
+	static const TQueryKernel kernelTable[4][ResolveAttribute::All + 1] = { RCU_QUERY_KERNEL_ROW(1), RCU_QUERY_KERNEL_ROW(4), RCU_QUERY_KERNEL_ROW(8), RCU_QUERY_KERNEL_ROW(16) };
+
+	#undef RCU_QUERY_KERNEL_ROW
+
+	TQueryKernel query_kernel(uint32_t packetWidth, uint32_t attributeMask)
+	{
+		assert_msg(packetWidth == 1 || packetWidth == 4 || packetWidth == 8 || packetWidth == 16, "Packet width must be 1, 4, 8 or 16");
+		uint32_t widthIdx;
+		switch (packetWidth)
+		{
+			case 1: widthIdx = 0; break;
+			case 4: widthIdx = 1; break;
+			case 8: widthIdx = 2; break;
+			default: widthIdx = 3; break;
+		}
+		return kernelTable[widthIdx][attributeMask & ResolveAttribute::All];
+	}
+}
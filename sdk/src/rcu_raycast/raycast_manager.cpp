@@ -3,15 +3,21 @@
 
 // bento includes
 #include <bento_base/log.h>
+#include <bento_base/security.h>
 #include <bento_math/vector3.h>
 #include <bento_math/vector2.h>
 
 // External includes
 #include <embree/include/embree3/rtcore.h>
 #include <float.h>
+#include <math.h>
+#include <stddef.h>
 
 namespace rcu
 {
+	// Initial size of the per-thread overlap buffers, they double when a query outgrows them
+	#define RCU_OVERLAP_THREAD_BUFFER 256
+
 	void error_handler(void*, const RTCError code, const char* str = nullptr)
 	{
 		if (code == RTC_ERROR_NONE)
@@ -31,10 +37,31 @@ namespace rcu
 	}
 
 	TRaycastManager::TRaycastManager(bento::IAllocator& allocator)
-	: _allocator(allocator)
-	, _geometriesIndexes(allocator)
+	: _activeVersion(nullptr)
+	, _pendingVersion(nullptr)
+	, _pendingStatus(SetupStatus::Idle)
+	, _spatialQueries(false)
+	, _multiHit(false)
+	, _occupancyVoxelSize(0.0f)
+	, _occupancyBudget(0)
+	, _distanceFieldVoxelSize(0.0f)
+	, _distanceFieldBudget(0)
+	, _mergeTriangleLimit(0)
 	, _rayHitGroupArray(allocator)
 	, _rayHitSingleArray(allocator, 16)
+	, _hitBuffer(allocator)
+	, _sortedHitBuffer(allocator)
+	, _sortCounterArray(allocator)
+	, _attributeBuffer(allocator)
+	, _multiHitArray(allocator)
+	, _overlapOffsetArray(allocator)
+	, _pathQueues(allocator)
+	, _texelBuffer(allocator)
+	, _resultCache(allocator)
+	, _visibilityGrid(allocator)
+	, _world(allocator)
+	, _worldHitArray(allocator)
+	, _allocator(allocator)
 	{
 		// Create the device
 		_device = rtcNewDevice("");
@@ -47,82 +74,217 @@ namespace rcu
 
 	TRaycastManager::~TRaycastManager()
 	{
+		// Stop any build in flight and release all the versions
+		cancel_setup();
+		release();
+		release_world();
+
 		// Release the previously created device
 		rtcReleaseDevice(_device);
 	}
 
 	void TRaycastManager::setup(const TScene& scene)
 	{
-		// loop through the geometries
-		uint32_t numGeometries = scene.geometryArray.size();
-		_geometriesIndexes.resize(numGeometries);
+		setup_async(scene);
+		wait_setup();
+		swap_scene_version();
+	}
 
-		// Create a new scene
-		_scene = rtcNewScene(_device);
+	void TRaycastManager::setup_async(const TScene& scene)
+	{
+		// Only one version can be in flight, drop the previous one
+		cancel_setup();
 
-		// Set the target scene
-		_targetScene = &scene;
+		// Create the new version
+		_pendingVersion = bento::make_new<TSceneVersion>(_allocator, _allocator);
+		_pendingVersion->targetScene = &scene;
+		_pendingVersion->contextFilter = _multiHit;
+		_pendingVersion->buildTriangleBVH = _spatialQueries;
+		_pendingVersion->occupancyVoxelSize = _occupancyVoxelSize;
+		_pendingVersion->occupancyBudget = _occupancyBudget;
+		_pendingVersion->distanceFieldVoxelSize = _distanceFieldVoxelSize;
+		_pendingVersion->distanceFieldBudget = _distanceFieldBudget;
+		_pendingVersion->mergeTriangleLimit = _mergeTriangleLimit;
+		_pendingStatus.store(SetupStatus::Building);
 
-		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		// The thread only drives the build, embree spreads the BVH construction over its own task pool
+		_buildThread = std::thread([this]()
 		{
-			// Fetch the current geometry
-			const TGeometry& currentGeometry = scene.geometryArray[geoIdx];
+			_pendingStatus.store(build_scene_version(_device, *_pendingVersion));
+		});
+	}
 
-			// Create a new geometry
-			RTCGeometry newGeo = rtcNewGeometry(_device, RTC_GEOMETRY_TYPE_TRIANGLE);
+	void TRaycastManager::cancel_setup()
+	{
+		if (_pendingVersion == nullptr)
+			return;
 
-			// Upload the positions
-			bento::Vector3* vertices = (bento::Vector3*)rtcSetNewGeometryBuffer(newGeo, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, sizeof(bento::Vector3), currentGeometry.vertexArray.size());
-			memcpy(vertices, currentGeometry.vertexArray.begin(), sizeof(bento::Vector3) * currentGeometry.vertexArray.size());
+		_pendingVersion->cancelRequested.store(true);
+		join_build();
 
-			// Upload the triangles
-			bento::IVector3* triangles = (bento::IVector3*)rtcSetNewGeometryBuffer(newGeo, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, sizeof(bento::IVector3), currentGeometry.indexArray.size());
-			memcpy(triangles, currentGeometry.indexArray.begin(), sizeof(bento::IVector3) * currentGeometry.indexArray.size());
+		release_scene_version(*_pendingVersion);
+		bento::make_delete<TSceneVersion>(_allocator, _pendingVersion);
+		_pendingVersion = nullptr;
+		_pendingStatus.store(SetupStatus::Cancelled);
+	}
 
-			// Commit the geometry
-			rtcCommitGeometry(newGeo);
+	void TRaycastManager::wait_setup()
+	{
+		join_build();
+	}
 
-			// Attach it to the scene and keep track of the index
-			_geometriesIndexes[geoIdx] = rtcAttachGeometry(_scene, newGeo);
+	SetupStatus::Type TRaycastManager::setup_status() const
+	{
+		return (SetupStatus::Type)_pendingStatus.load();
+	}
+
+	float TRaycastManager::setup_progress() const
+	{
+		if (_pendingVersion == nullptr)
+			return _pendingStatus.load() == SetupStatus::Ready ? 1.0f : 0.0f;
+		return _pendingVersion->progress.load();
+	}
 
-			// Release the geometry
-			rtcReleaseGeometry(newGeo);
+	bool TRaycastManager::swap_scene_version()
+	{
+		if (_pendingVersion == nullptr || _pendingStatus.load() == SetupStatus::Building)
+			return false;
+
+		// Make sure the build thread is done before touching the version
+		join_build();
+
+		if (_pendingStatus.load() != SetupStatus::Ready)
+		{
+			// The build did not succeed, keep querying the current version
+			release_scene_version(*_pendingVersion);
+			bento::make_delete<TSceneVersion>(_allocator, _pendingVersion);
+			_pendingVersion = nullptr;
+			return false;
 		}
 
-		// Commit the scene
-		rtcCommitScene(_scene);
+		// Publish the new version and retire the previous one
+		TSceneVersion* previousVersion = _activeVersion.exchange(_pendingVersion);
+		clear_result_cache(_resultCache, _pendingVersion->targetScene);
+		_pendingVersion = nullptr;
+		if (previousVersion != nullptr)
+		{
+			release_scene_version(*previousVersion);
+			bento::make_delete<TSceneVersion>(_allocator, previousVersion);
+		}
+		return true;
 	}
 
 	void TRaycastManager::release()
 	{
-		rtcReleaseScene(_scene);
-		_scene = nullptr;
+		TSceneVersion* activeVersion = _activeVersion.exchange(nullptr);
+		clear_result_cache(_resultCache, nullptr);
+		clear_visibility_grid(_visibilityGrid);
+		if (activeVersion != nullptr)
+		{
+			release_scene_version(*activeVersion);
+			bento::make_delete<TSceneVersion>(_allocator, activeVersion);
+		}
+	}
+
+	void TRaycastManager::update_geometry(uint32_t geometryIdx)
+	{
+		wait_setup();
+		TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+			return;
+		update_version_geometry(*version, geometryIdx);
+		record_geometry_change(_resultCache, *version->targetScene, geometryIdx);
 	}
 
-	void TRaycastManager::run(const TRay* rayArray, TIntersection* intersectionArray, uint32_t numRays)
+	void TRaycastManager::update_geometry_transform(uint32_t geometryIdx)
+	{
+		wait_setup();
+		TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+			return;
+		update_version_transform(*version, geometryIdx);
+		record_geometry_change(_resultCache, *version->targetScene, geometryIdx);
+	}
+
+	void TRaycastManager::enable_result_cache(uint32_t capacity, float quantum)
+	{
+		const TSceneVersion* version = acquire_version();
+		reset_result_cache(_resultCache, version != nullptr ? version->targetScene : nullptr, capacity, quantum);
+	}
+
+	void TRaycastManager::enable_spatial_queries(bool enabled)
+	{
+		_spatialQueries = enabled;
+	}
+
+	void TRaycastManager::enable_multi_hit(bool enabled)
+	{
+		_multiHit = enabled;
+	}
+
+	void TRaycastManager::enable_occupancy_culling(float voxelSize, uint64_t memoryBudget)
+	{
+		_occupancyVoxelSize = voxelSize;
+		_occupancyBudget = memoryBudget;
+	}
+
+	void TRaycastManager::enable_distance_field(float voxelSize, uint64_t memoryBudget)
+	{
+		_distanceFieldVoxelSize = voxelSize;
+		_distanceFieldBudget = memoryBudget;
+	}
+
+	void TRaycastManager::enable_geometry_merging(uint32_t maxTriangles)
+	{
+		_mergeTriangleLimit = maxTriangles;
+	}
+
+	TSceneVersion* TRaycastManager::acquire_version()
+	{
+		// Swapping happens on the querying thread, so no query can still be running on the retired version
+		swap_scene_version();
+
+		// Refit the geometries updated since the last query
+		TSceneVersion* version = _activeVersion.load();
+		if (version != nullptr)
+			refit_scene_version(*version);
+		return version;
+	}
+
+	void TRaycastManager::join_build()
+	{
+		if (_buildThread.joinable())
+			_buildThread.join();
+	}
+
+	// Disables the rays of the packet that only cross empty voxels, they keep their invalid geomID. Returns the number of rays left.
+	static uint32_t occupancy_prepass(const TOccupancyGrid& grid, RTCRay16& rays, int* validityFlags)
+	{
+		uint32_t numValid = 0;
+		for (uint32_t rayIdx = 0; rayIdx < 16; ++rayIdx)
+		{
+			bento::Vector3 origin = { rays.org_x[rayIdx], rays.org_y[rayIdx], rays.org_z[rayIdx] };
+			bento::Vector3 direction = { rays.dir_x[rayIdx], rays.dir_y[rayIdx], rays.dir_z[rayIdx] };
+			if (validityFlags[rayIdx] != 0 && occupancy_clip_segment(grid, origin, direction, rays.tnear[rayIdx], rays.tfar[rayIdx]))
+				numValid++;
+			else
+				validityFlags[rayIdx] = 0;
+		}
+		return numValid;
+	}
+
+	void TRaycastManager::trace(const TSceneVersion& version, const TRay* rayArray, uint32_t numRays, RTCIntersectContext* customContext)
 	{
 		// Create an intersection context
-		RTCIntersectContext context;
-		rtcInitIntersectContext(&context);
+		RTCIntersectContext defaultContext;
+		rtcInitIntersectContext(&defaultContext);
+		RTCIntersectContext* context = customContext != nullptr ? customContext : &defaultContext;
 
+		// Compute the ray quotient and remain
 		int32_t numRayGroups = (uint32_t)(numRays / 16);
 		int32_t rayBatchGroupSize = (uint32_t)(numRayGroups * 16);
 		uint32_t rayRemain = numRays % 16;
 
-		// Compute the ray quotient and remain
-		if (true)
-		{
-			numRayGroups = (uint32_t)(numRays / 16);
-			rayBatchGroupSize = (uint32_t)(numRayGroups * 16);
-			rayRemain = numRays % 16;
-		}
-		else
-		{
-			numRayGroups = 0;
-			rayBatchGroupSize = 0;
-			rayRemain = numRays;
-		}
-
 		// Make sure the arrays are the right size
 		if (_rayHitGroupArray.size() < (uint32_t)numRayGroups)
 		{
@@ -158,10 +320,12 @@ namespace rcu
 				rayHitGroup.ray.tnear[rayIdx] = currentRay.tmin;
 				rayHitGroup.ray.tfar[rayIdx] = currentRay.tmax;
 
-				rayHitGroup.hit.instID[rayIdx][0] = RTC_INVALID_GEOMETRY_ID;
+				rayHitGroup.hit.instID[0][rayIdx] = RTC_INVALID_GEOMETRY_ID;
 				rayHitGroup.hit.geomID[rayIdx] = RTC_INVALID_GEOMETRY_ID;
-				rayHitGroup.ray.mask[rayIdx] = 0xffffffff;
+				rayHitGroup.ray.mask[rayIdx] = currentRay.mask;
 				rayHitGroup.ray.time[rayIdx] = 0.0f;
+				rayHitGroup.ray.id[rayIdx] = 16 * rayGroupIndex + rayIdx;
+				rayHitGroup.ray.flags[rayIdx] = 0;
 			}
 		}
 
@@ -190,77 +354,236 @@ namespace rcu
 
 			rayHitSingle.hit.instID[0] = RTC_INVALID_GEOMETRY_ID;
 			rayHitSingle.hit.geomID = RTC_INVALID_GEOMETRY_ID;
-			rayHitSingle.ray.mask = 0xffffffff;
+			rayHitSingle.ray.mask = currentRay.mask;
 			rayHitSingle.ray.time = 0.0f;
+			rayHitSingle.ray.id = rayBatchGroupSize + raySingleIndex;
+			rayHitSingle.ray.flags = 0;
 		}
 
 		// All the flags that
-		int validityFlags = 0xff;
+		int validityFlags[16];
+		for (uint32_t laneIdx = 0; laneIdx < 16; ++laneIdx)
+			validityFlags[laneIdx] = -1;
 
 		// Let's run all the SIMD rays
 		#pragma omp parallel for
 		for (int32_t rayGroupIndex = 0; rayGroupIndex < numRayGroups; ++rayGroupIndex)
 		{
-			rtcIntersect16(&validityFlags, _scene, &context, &_rayHitGroupArray[rayGroupIndex]);
+			RTCRayHit16& rayHitGroup = _rayHitGroupArray[rayGroupIndex];
+
+			// Cull the rays that only cross empty space and stop the other ones at their last occupied voxel
+			if (version.occupancyGrid != nullptr)
+			{
+				int groupValidityFlags[16];
+				memcpy(groupValidityFlags, validityFlags, sizeof(groupValidityFlags));
+				if (occupancy_prepass(*version.occupancyGrid, rayHitGroup.ray, groupValidityFlags) == 0)
+					continue;
+				rtcIntersect16(groupValidityFlags, version.scene, context, &rayHitGroup);
+			}
+			else
+			{
+				rtcIntersect16(validityFlags, version.scene, context, &rayHitGroup);
+			}
+
+			// Report the hits of the instanced geometries with the slot of their instance and the hits of the batches with their source geometry
+			if (version.hasInstances || version.mergedOffsetArray.size() > 0)
+			{
+				for (uint32_t rayIdx = 0; rayIdx < 16; ++rayIdx)
+				{
+					rayHitGroup.hit.geomID[rayIdx] = hit_slot(rayHitGroup.hit.geomID[rayIdx], rayHitGroup.hit.instID[0][rayIdx]);
+					unmerge_hit(version, rayHitGroup.hit.geomID[rayIdx], rayHitGroup.hit.primID[rayIdx]);
+				}
+			}
 		}
 
 		// Let's run all non-SIMD rays
 		for (uint32_t raySingleIndex = 0; raySingleIndex < rayRemain; ++raySingleIndex)
 		{
-			rtcIntersect1(_scene, &context, &_rayHitSingleArray[raySingleIndex]);
+			RTCRayHit& rayHitSingle = _rayHitSingleArray[raySingleIndex];
+			if (version.occupancyGrid != nullptr)
+			{
+				bento::Vector3 origin = { rayHitSingle.ray.org_x, rayHitSingle.ray.org_y, rayHitSingle.ray.org_z };
+				bento::Vector3 direction = { rayHitSingle.ray.dir_x, rayHitSingle.ray.dir_y, rayHitSingle.ray.dir_z };
+				if (!occupancy_clip_segment(*version.occupancyGrid, origin, direction, rayHitSingle.ray.tnear, rayHitSingle.ray.tfar))
+					continue;
+			}
+			rtcIntersect1(version.scene, context, &rayHitSingle);
+			rayHitSingle.hit.geomID = hit_slot(rayHitSingle.hit.geomID, rayHitSingle.hit.instID[0]);
+			unmerge_hit(version, rayHitSingle.hit.geomID, rayHitSingle.hit.primID);
+		}
+	}
+
+	static void write_miss(TIntersection& currentIntersection)
+	{
+		currentIntersection.validity = 0;
+		currentIntersection.t = FLT_MAX;
+		currentIntersection.geometryID = (uint32_t)-1;
+		currentIntersection.subMeshID = (uint32_t)-1;
+		currentIntersection.triangleID = (uint32_t)-1;
+		currentIntersection.barycentricCoordinates = { 0, 0, 0 };
+		currentIntersection.position = { 0, 0, 0 };
+		currentIntersection.normal = { 0, 0, 0 };
+		currentIntersection.texCoord = { 0, 0 };
+	}
+
+	static void write_miss(THitRecord& currentRecord)
+	{
+		currentRecord.geometryIndex = (uint32_t)-1;
+		currentRecord.triangleID = (uint32_t)-1;
+		currentRecord.u = 0.0f;
+		currentRecord.v = 0.0f;
+		currentRecord.t = FLT_MAX;
+	}
+
+	void init_output_layout(TOutputLayout& layout, void* base, uint32_t stride, bool hitsOnly)
+	{
+		layout.base = base;
+		layout.stride = stride;
+		for (uint32_t attributeIdx = 0; attributeIdx < IntersectionAttribute::Count; ++attributeIdx)
+			layout.offsets[attributeIdx] = -1;
+		layout.hitsOnly = hitsOnly;
+	}
+
+	template<typename T>
+	static inline void write_attribute(char* record, const TOutputLayout& layout, IntersectionAttribute::Type attribute, const T& value)
+	{
+		if (layout.offsets[attribute] >= 0)
+			memcpy(record + layout.offsets[attribute], &value, sizeof(T));
+	}
+
+	static void write_layout_miss(const TOutputLayout& layout, char* record, uint32_t rayIndex)
+	{
+		const bento::Vector3 zero3 = { 0, 0, 0 };
+		const bento::Vector2 zero2 = { 0, 0 };
+		write_attribute(record, layout, IntersectionAttribute::Validity, (int32_t)0);
+		write_attribute(record, layout, IntersectionAttribute::Distance, FLT_MAX);
+		write_attribute(record, layout, IntersectionAttribute::GeometryID, (uint32_t)-1);
+		write_attribute(record, layout, IntersectionAttribute::SubMeshID, (uint32_t)-1);
+		write_attribute(record, layout, IntersectionAttribute::TriangleID, (uint32_t)-1);
+		write_attribute(record, layout, IntersectionAttribute::Barycentrics, zero3);
+		write_attribute(record, layout, IntersectionAttribute::Position, zero3);
+		write_attribute(record, layout, IntersectionAttribute::Normal, zero3);
+		write_attribute(record, layout, IntersectionAttribute::TexCoord, zero2);
+		write_attribute(record, layout, IntersectionAttribute::RayIndex, rayIndex);
+	}
+
+	static void write_layout_hit(const TScene& targetScene, const TOutputLayout& layout, char* record, uint32_t rayIndex, uint32_t geomID, uint32_t primID, float t, float u, float v)
+	{
+		canonical_hit(targetScene, geomID, primID, u, v);
+		uint32_t gameObjectID, subMeshID, triangleID;
+		hit_owner(targetScene, geomID, primID, gameObjectID, subMeshID, triangleID);
+		const bento::Vector3 barycentrics = { 1.0f - u - v, u, v };
+		write_attribute(record, layout, IntersectionAttribute::Validity, (int32_t)1);
+		write_attribute(record, layout, IntersectionAttribute::Distance, t);
+		write_attribute(record, layout, IntersectionAttribute::GeometryID, gameObjectID);
+		write_attribute(record, layout, IntersectionAttribute::SubMeshID, subMeshID);
+		write_attribute(record, layout, IntersectionAttribute::TriangleID, triangleID);
+		write_attribute(record, layout, IntersectionAttribute::Barycentrics, barycentrics);
+		write_attribute(record, layout, IntersectionAttribute::RayIndex, rayIndex);
+
+		// Analytic primitives are evaluated from their surface parameters
+		if (geomID == primitive_slot(targetScene))
+		{
+			bento::Vector3 position, normal;
+			bento::Vector2 texCoord;
+			resolve_primitive_hit(targetScene, primID, u, v, position, normal, texCoord);
+			write_attribute(record, layout, IntersectionAttribute::Position, position);
+			write_attribute(record, layout, IntersectionAttribute::Normal, normal);
+			write_attribute(record, layout, IntersectionAttribute::TexCoord, texCoord);
+			return;
 		}
 
-		// Process the intersections
+		// Only fetch the vertex data that is requested
+		const TGeometry& targetGeometry = targetScene.geometryArray[geomID];
+		const bento::IVector3& currentFace = targetGeometry.indexArray[primID];
+		if (layout.offsets[IntersectionAttribute::Position] >= 0)
+		{
+			bento::Vector3 position = targetGeometry.vertexArray[currentFace.x] * barycentrics.x
+				+ targetGeometry.vertexArray[currentFace.y] * barycentrics.y
+				+ targetGeometry.vertexArray[currentFace.z] * barycentrics.z;
+			if (targetGeometry.instanced)
+				position = instance_position(targetGeometry, position);
+			write_attribute(record, layout, IntersectionAttribute::Position, position);
+		}
+		if (layout.offsets[IntersectionAttribute::Normal] >= 0)
+		{
+			bento::Vector3 normal = vertex_normal(targetGeometry, currentFace.x) * barycentrics.x
+				+ vertex_normal(targetGeometry, currentFace.y) * barycentrics.y
+				+ vertex_normal(targetGeometry, currentFace.z) * barycentrics.z;
+			if (targetGeometry.instanced)
+				normal = instance_normal(targetGeometry, normal);
+			write_attribute(record, layout, IntersectionAttribute::Normal, normal);
+		}
+		if (layout.offsets[IntersectionAttribute::TexCoord] >= 0)
+		{
+			bento::Vector2 texCoord = vertex_tex_coord(targetGeometry, currentFace.x) * barycentrics.x
+				+ vertex_tex_coord(targetGeometry, currentFace.y) * barycentrics.y
+				+ vertex_tex_coord(targetGeometry, currentFace.z) * barycentrics.z;
+			write_attribute(record, layout, IntersectionAttribute::TexCoord, texCoord);
+		}
+	}
+
+	void TRaycastManager::run(const TRay* rayArray, TIntersection* intersectionArray, uint32_t numRays)
+	{
+		// Fetch the version to query
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+		{
+			for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+				write_miss(intersectionArray[rayIdx]);
+			return;
+		}
+
+		if (_resultCache.entryArray.size() == 0)
+		{
+			run_traced(*version, rayArray, intersectionArray, numRays);
+			return;
+		}
+
+		// Only trace the rays whose cached intersection may have changed
+		uint32_t numMisses = lookup_cached_results(_resultCache, rayArray, numRays, intersectionArray);
+		if (numMisses == 0)
+			return;
+		run_traced(*version, _resultCache.missRayArray.begin(), _resultCache.missIntersectionArray.begin(), numMisses);
+		store_cached_results(_resultCache, intersectionArray);
+	}
+
+	void TRaycastManager::run_traced(const TSceneVersion& version, const TRay* rayArray, TIntersection* intersectionArray, uint32_t numRays)
+	{
+		const TScene& targetScene = *version.targetScene;
+
+		// Run the traversal
+		trace(version, rayArray, numRays);
+
+		int32_t numRayGroups = (uint32_t)(numRays / 16);
+		int32_t rayBatchGroupSize = (uint32_t)(numRayGroups * 16);
+		uint32_t rayRemain = numRays % 16;
+
+		// Write the misses and collect the hits
+		_hitBuffer.resize(numRays);
+		uint32_t numHits = 0;
 		for (int32_t rayGroupIndex = 0; rayGroupIndex < numRayGroups; ++rayGroupIndex)
 		{
 			// Fetch the target ray
-			RTCRayHit16& rayHitGroup = _rayHitGroupArray[rayGroupIndex];
+			const RTCRayHit16& rayHitGroup = _rayHitGroupArray[rayGroupIndex];
 
 			for (uint32_t rayIdx = 0; rayIdx < 16; ++rayIdx)
 			{
-				// Fetch the intersection to fill
-				TIntersection& currentIntersection = intersectionArray[16 * rayGroupIndex + rayIdx];
-
-				// Process the hit
+				uint32_t rayIndex = 16 * rayGroupIndex + rayIdx;
 				if (rayHitGroup.hit.geomID[rayIdx] != RTC_INVALID_GEOMETRY_ID)
 				{
-					const TGeometry& targetGeometry = _targetScene->geometryArray[rayHitGroup.hit.geomID[rayIdx]];
-					currentIntersection.validity = 1;
-					currentIntersection.t = rayHitGroup.ray.tfar[rayIdx];
-					currentIntersection.geometryID = targetGeometry.gameObjectID;
-					currentIntersection.subMeshID = targetGeometry.subMeshID;
-					currentIntersection.triangleID = rayHitGroup.hit.primID[rayIdx];
-					currentIntersection.barycentricCoordinates = { 1.0f - rayHitGroup.hit.u[rayIdx] - rayHitGroup.hit.v[rayIdx], rayHitGroup.hit.u[rayIdx], rayHitGroup.hit.v[rayIdx] };
-
-					// Grab the face's indexes
-					const bento::IVector3& currentFace = targetGeometry.indexArray[currentIntersection.triangleID];
-
-					// Interpolate the position
-					currentIntersection.position = targetGeometry.vertexArray[currentFace.x] * currentIntersection.barycentricCoordinates.x
-						+ targetGeometry.vertexArray[currentFace.y] * currentIntersection.barycentricCoordinates.y
-						+ targetGeometry.vertexArray[currentFace.z] * currentIntersection.barycentricCoordinates.z;
-
-					// Interpolate the normal
-					currentIntersection.normal = targetGeometry.normalArray[currentFace.x] * currentIntersection.barycentricCoordinates.x
-						+ targetGeometry.normalArray[currentFace.y] * currentIntersection.barycentricCoordinates.y
-						+ targetGeometry.normalArray[currentFace.z] * currentIntersection.barycentricCoordinates.z;
-
-					// Interpolate the texCoord
-					currentIntersection.texCoord = targetGeometry.texCoordArray[currentFace.x] * currentIntersection.barycentricCoordinates.x
-						+ targetGeometry.texCoordArray[currentFace.y] * currentIntersection.barycentricCoordinates.y
-						+ targetGeometry.texCoordArray[currentFace.z] * currentIntersection.barycentricCoordinates.z;
+					_hitBuffer.rayIndexArray[numHits] = rayIndex;
+					_hitBuffer.geometryArray[numHits] = rayHitGroup.hit.geomID[rayIdx];
+					_hitBuffer.primitiveArray[numHits] = rayHitGroup.hit.primID[rayIdx];
+					_hitBuffer.tArray[numHits] = rayHitGroup.ray.tfar[rayIdx];
+					_hitBuffer.uArray[numHits] = rayHitGroup.hit.u[rayIdx];
+					_hitBuffer.vArray[numHits] = rayHitGroup.hit.v[rayIdx];
+					canonical_hit(targetScene, _hitBuffer.geometryArray[numHits], _hitBuffer.primitiveArray[numHits], _hitBuffer.uArray[numHits], _hitBuffer.vArray[numHits]);
+					numHits++;
 				}
 				else
 				{
-					currentIntersection.validity = 0;
-					currentIntersection.t = FLT_MAX;
-					currentIntersection.geometryID = (uint32_t)-1;
-					currentIntersection.subMeshID = (uint32_t)-1;
-					currentIntersection.triangleID = (uint32_t)-1;
-					currentIntersection.barycentricCoordinates = { 0, 0, 0 };
-					currentIntersection.position = { 0, 0, 0 };
-					currentIntersection.normal = { 0, 0, 0 };
-					currentIntersection.texCoord = { 0, 0 };
+					write_miss(intersectionArray[rayIndex]);
 				}
 			}
 		}
@@ -268,52 +591,820 @@ namespace rcu
 		for (uint32_t raySingleIndex = 0; raySingleIndex < rayRemain; ++raySingleIndex)
 		{
 			// Fetch the target ray
-			RTCRayHit& rayHitSingle = _rayHitSingleArray[raySingleIndex];
+			const RTCRayHit& rayHitSingle = _rayHitSingleArray[raySingleIndex];
+
+			uint32_t rayIndex = rayBatchGroupSize + raySingleIndex;
+			if (rayHitSingle.hit.geomID != RTC_INVALID_GEOMETRY_ID)
+			{
+				_hitBuffer.rayIndexArray[numHits] = rayIndex;
+				_hitBuffer.geometryArray[numHits] = rayHitSingle.hit.geomID;
+				_hitBuffer.primitiveArray[numHits] = rayHitSingle.hit.primID;
+				_hitBuffer.tArray[numHits] = rayHitSingle.ray.tfar;
+				_hitBuffer.uArray[numHits] = rayHitSingle.hit.u;
+				_hitBuffer.vArray[numHits] = rayHitSingle.hit.v;
+				canonical_hit(targetScene, _hitBuffer.geometryArray[numHits], _hitBuffer.primitiveArray[numHits], _hitBuffer.uArray[numHits], _hitBuffer.vArray[numHits]);
+				numHits++;
+			}
+			else
+			{
+				write_miss(intersectionArray[rayIndex]);
+			}
+		}
+		_hitBuffer.resize(numHits);
+
+		// Group the hits by geometry for locality, then run the vectorized resolve
+		sort_hits_by_geometry(_hitBuffer, scene_slot_count(targetScene), _sortCounterArray, _sortedHitBuffer);
+		resolve_hits(targetScene, _sortedHitBuffer, ResolveAttribute::All, _attributeBuffer);
+		scatter_hits(targetScene, ResolveAttribute::All, intersectionArray);
+	}
+
+	void TRaycastManager::scatter_hits(const TScene& targetScene, uint32_t attributeMask, TIntersection* intersectionArray)
+	{
+		uint32_t numHits = _sortedHitBuffer.size();
+		for (uint32_t hitIdx = 0; hitIdx < numHits; ++hitIdx)
+		{
+			float u = _sortedHitBuffer.uArray[hitIdx];
+			float v = _sortedHitBuffer.vArray[hitIdx];
+
+			TIntersection& currentIntersection = intersectionArray[_sortedHitBuffer.rayIndexArray[hitIdx]];
+			currentIntersection.validity = 1;
+			currentIntersection.t = _sortedHitBuffer.tArray[hitIdx];
+			hit_owner(targetScene, _sortedHitBuffer.geometryArray[hitIdx], _sortedHitBuffer.primitiveArray[hitIdx], currentIntersection.geometryID, currentIntersection.subMeshID, currentIntersection.triangleID);
+			currentIntersection.barycentricCoordinates = { 1.0f - u - v, u, v };
+			if (attributeMask & ResolveAttribute::Position)
+				currentIntersection.position = { _attributeBuffer.channel(TAttributeBuffer::PositionX)[hitIdx], _attributeBuffer.channel(TAttributeBuffer::PositionY)[hitIdx], _attributeBuffer.channel(TAttributeBuffer::PositionZ)[hitIdx] };
+			if (attributeMask & ResolveAttribute::Normal)
+				currentIntersection.normal = { _attributeBuffer.channel(TAttributeBuffer::NormalX)[hitIdx], _attributeBuffer.channel(TAttributeBuffer::NormalY)[hitIdx], _attributeBuffer.channel(TAttributeBuffer::NormalZ)[hitIdx] };
+			if (attributeMask & ResolveAttribute::TexCoord)
+				currentIntersection.texCoord = { _attributeBuffer.channel(TAttributeBuffer::TexCoordX)[hitIdx], _attributeBuffer.channel(TAttributeBuffer::TexCoordY)[hitIdx] };
+		}
+	}
+
+	uint32_t TRaycastManager::run_compact(const TRay* rayArray, TCompactHit* hitArray, uint32_t numRays)
+	{
+		// Fetch the version to query
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+			return 0;
+		const TScene& targetScene = *version->targetScene;
+
+		// Run the traversal
+		trace(*version, rayArray, numRays);
+
+		int32_t numRayGroups = (uint32_t)(numRays / 16);
+		int32_t rayBatchGroupSize = (uint32_t)(numRayGroups * 16);
+		uint32_t rayRemain = numRays % 16;
+
+		// Append the hits in ray order, misses write nothing
+		uint32_t numHits = 0;
+		for (int32_t rayGroupIndex = 0; rayGroupIndex < numRayGroups; ++rayGroupIndex)
+		{
+			// Fetch the target ray
+			const RTCRayHit16& rayHitGroup = _rayHitGroupArray[rayGroupIndex];
+
+			for (uint32_t rayIdx = 0; rayIdx < 16; ++rayIdx)
+			{
+				uint32_t geomID = rayHitGroup.hit.geomID[rayIdx];
+				if (geomID == RTC_INVALID_GEOMETRY_ID)
+					continue;
 
-			// Fetch the intersection to fill
-			TIntersection& currentIntersection = intersectionArray[rayBatchGroupSize + raySingleIndex];
+				uint32_t primID = rayHitGroup.hit.primID[rayIdx];
+				TCompactHit& currentHit = hitArray[numHits++];
+				currentHit.rayIndex = 16 * rayGroupIndex + rayIdx;
+				currentHit.t = rayHitGroup.ray.tfar[rayIdx];
+				currentHit.u = rayHitGroup.hit.u[rayIdx];
+				currentHit.v = rayHitGroup.hit.v[rayIdx];
+				canonical_hit(targetScene, geomID, primID, currentHit.u, currentHit.v);
+				hit_owner(targetScene, geomID, primID, currentHit.geometryID, currentHit.subMeshID, currentHit.triangleID);
+			}
+		}
+
+		for (uint32_t raySingleIndex = 0; raySingleIndex < rayRemain; ++raySingleIndex)
+		{
+			// Fetch the target ray
+			const RTCRayHit& rayHitSingle = _rayHitSingleArray[raySingleIndex];
+			if (rayHitSingle.hit.geomID == RTC_INVALID_GEOMETRY_ID)
+				continue;
+
+			uint32_t primID = rayHitSingle.hit.primID;
+			TCompactHit& currentHit = hitArray[numHits++];
+			currentHit.rayIndex = rayBatchGroupSize + raySingleIndex;
+			currentHit.t = rayHitSingle.ray.tfar;
+			currentHit.u = rayHitSingle.hit.u;
+			currentHit.v = rayHitSingle.hit.v;
+			canonical_hit(targetScene, rayHitSingle.hit.geomID, primID, currentHit.u, currentHit.v);
+			hit_owner(targetScene, rayHitSingle.hit.geomID, primID, currentHit.geometryID, currentHit.subMeshID, currentHit.triangleID);
+		}
+		return numHits;
+	}
+
+	uint32_t TRaycastManager::run_layout(const TRay* rayArray, const TOutputLayout& layout, uint32_t numRays)
+	{
+		char* base = (char*)layout.base;
+
+		// Fetch the version to query
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+		{
+			if (layout.hitsOnly)
+				return 0;
+			for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+				write_layout_miss(layout, base + (size_t)rayIdx * layout.stride, rayIdx);
+			return numRays;
+		}
+		const TScene& targetScene = *version->targetScene;
+
+		// Run the traversal
+		trace(*version, rayArray, numRays);
+
+		int32_t numRayGroups = (uint32_t)(numRays / 16);
+		int32_t rayBatchGroupSize = (uint32_t)(numRayGroups * 16);
+		uint32_t rayRemain = numRays % 16;
+
+		// Write the records straight into the caller's structure
+		uint32_t numRecords = 0;
+		for (int32_t rayGroupIndex = 0; rayGroupIndex < numRayGroups; ++rayGroupIndex)
+		{
+			// Fetch the target ray
+			const RTCRayHit16& rayHitGroup = _rayHitGroupArray[rayGroupIndex];
+
+			for (uint32_t rayIdx = 0; rayIdx < 16; ++rayIdx)
+			{
+				uint32_t rayIndex = 16 * rayGroupIndex + rayIdx;
+				if (rayHitGroup.hit.geomID[rayIdx] != RTC_INVALID_GEOMETRY_ID)
+				{
+					char* record = base + (size_t)(layout.hitsOnly ? numRecords : rayIndex) * layout.stride;
+					write_layout_hit(targetScene, layout, record, rayIndex, rayHitGroup.hit.geomID[rayIdx], rayHitGroup.hit.primID[rayIdx], rayHitGroup.ray.tfar[rayIdx], rayHitGroup.hit.u[rayIdx], rayHitGroup.hit.v[rayIdx]);
+					numRecords++;
+				}
+				else if (!layout.hitsOnly)
+				{
+					write_layout_miss(layout, base + (size_t)rayIndex * layout.stride, rayIndex);
+					numRecords++;
+				}
+			}
+		}
+
+		for (uint32_t raySingleIndex = 0; raySingleIndex < rayRemain; ++raySingleIndex)
+		{
+			// Fetch the target ray
+			const RTCRayHit& rayHitSingle = _rayHitSingleArray[raySingleIndex];
 
-			// Process the hit
+			uint32_t rayIndex = rayBatchGroupSize + raySingleIndex;
 			if (rayHitSingle.hit.geomID != RTC_INVALID_GEOMETRY_ID)
 			{
-				const TGeometry& targetGeometry = _targetScene->geometryArray[rayHitSingle.hit.geomID];
-				currentIntersection.validity = 1;
-				currentIntersection.t = rayHitSingle.ray.tfar;
-				currentIntersection.geometryID = targetGeometry.gameObjectID;
-				currentIntersection.subMeshID = targetGeometry.subMeshID;
-				currentIntersection.triangleID = rayHitSingle.hit.primID;
-				currentIntersection.barycentricCoordinates = { 1.0f - rayHitSingle.hit.u - rayHitSingle.hit.v, rayHitSingle.hit.u, rayHitSingle.hit.v };
-
-				// Grab the face's indexes
-				const bento::IVector3& currentFace = targetGeometry.indexArray[currentIntersection.triangleID];
-
-				// Interpolate the position
-				currentIntersection.position = targetGeometry.vertexArray[currentFace.x] * currentIntersection.barycentricCoordinates.x
-					+ targetGeometry.vertexArray[currentFace.y] * currentIntersection.barycentricCoordinates.y
-					+ targetGeometry.vertexArray[currentFace.z] * currentIntersection.barycentricCoordinates.z;
-
-				// Interpolate the normal
-				currentIntersection.normal = targetGeometry.normalArray[currentFace.x] * currentIntersection.barycentricCoordinates.x
-					+ targetGeometry.normalArray[currentFace.y] * currentIntersection.barycentricCoordinates.y
-					+ targetGeometry.normalArray[currentFace.z] * currentIntersection.barycentricCoordinates.z;
-
-				// Interpolate the texCoord
-				currentIntersection.texCoord = targetGeometry.texCoordArray[currentFace.x] * currentIntersection.barycentricCoordinates.x
-					+ targetGeometry.texCoordArray[currentFace.y] * currentIntersection.barycentricCoordinates.y
-					+ targetGeometry.texCoordArray[currentFace.z] * currentIntersection.barycentricCoordinates.z;
+				char* record = base + (size_t)(layout.hitsOnly ? numRecords : rayIndex) * layout.stride;
+				write_layout_hit(targetScene, layout, record, rayIndex, rayHitSingle.hit.geomID, rayHitSingle.hit.primID, rayHitSingle.ray.tfar, rayHitSingle.hit.u, rayHitSingle.hit.v);
+				numRecords++;
+			}
+			else if (!layout.hitsOnly)
+			{
+				write_layout_miss(layout, base + (size_t)rayIndex * layout.stride, rayIndex);
+				numRecords++;
+			}
+		}
+		return numRecords;
+	}
+
+	void TRaycastManager::run_specialized(const TRay* rayArray, TIntersection* intersectionArray, uint32_t numRays, uint32_t attributeMask, uint32_t packetWidth)
+	{
+		// Pick the instantiation once for the whole batch
+		TQueryKernel kernel = query_kernel(packetWidth, attributeMask);
+
+		// Fetch the version to query
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+		{
+			for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+				write_miss(intersectionArray[rayIdx]);
+			return;
+		}
+		kernel(*version, rayArray, intersectionArray, numRays);
+	}
+
+	void TRaycastManager::run_records(const TRay* rayArray, THitRecord* recordArray, uint32_t numRays)
+	{
+		// Fetch the version to query
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+		{
+			for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+				write_miss(recordArray[rayIdx]);
+			return;
+		}
+
+		const TScene& targetScene = *version->targetScene;
+
+		// Run the traversal
+		trace(*version, rayArray, numRays);
+
+		int32_t numRayGroups = (uint32_t)(numRays / 16);
+		int32_t rayBatchGroupSize = (uint32_t)(numRayGroups * 16);
+		uint32_t rayRemain = numRays % 16;
+
+		for (int32_t rayGroupIndex = 0; rayGroupIndex < numRayGroups; ++rayGroupIndex)
+		{
+			// Fetch the target ray
+			const RTCRayHit16& rayHitGroup = _rayHitGroupArray[rayGroupIndex];
+
+			for (uint32_t rayIdx = 0; rayIdx < 16; ++rayIdx)
+			{
+				THitRecord& currentRecord = recordArray[16 * rayGroupIndex + rayIdx];
+				if (rayHitGroup.hit.geomID[rayIdx] == RTC_INVALID_GEOMETRY_ID)
+				{
+					write_miss(currentRecord);
+					continue;
+				}
+				currentRecord.geometryIndex = rayHitGroup.hit.geomID[rayIdx];
+				currentRecord.triangleID = rayHitGroup.hit.primID[rayIdx];
+				currentRecord.u = rayHitGroup.hit.u[rayIdx];
+				currentRecord.v = rayHitGroup.hit.v[rayIdx];
+				currentRecord.t = rayHitGroup.ray.tfar[rayIdx];
+				canonical_hit(targetScene, currentRecord.geometryIndex, currentRecord.triangleID, currentRecord.u, currentRecord.v);
+			}
+		}
+
+		for (uint32_t raySingleIndex = 0; raySingleIndex < rayRemain; ++raySingleIndex)
+		{
+			// Fetch the target ray
+			const RTCRayHit& rayHitSingle = _rayHitSingleArray[raySingleIndex];
+
+			THitRecord& currentRecord = recordArray[rayBatchGroupSize + raySingleIndex];
+			if (rayHitSingle.hit.geomID == RTC_INVALID_GEOMETRY_ID)
+			{
+				write_miss(currentRecord);
+				continue;
+			}
+			currentRecord.geometryIndex = rayHitSingle.hit.geomID;
+			currentRecord.triangleID = rayHitSingle.hit.primID;
+			currentRecord.u = rayHitSingle.hit.u;
+			currentRecord.v = rayHitSingle.hit.v;
+			currentRecord.t = rayHitSingle.ray.tfar;
+			canonical_hit(targetScene, currentRecord.geometryIndex, currentRecord.triangleID, currentRecord.u, currentRecord.v);
+		}
+	}
+
+	void TRaycastManager::resolve(const THitRecord* recordArray, const uint32_t* indexArray, uint32_t numIndices, uint32_t attributeMask, TIntersection* intersectionArray)
+	{
+		// Records refer to the version that is currently active, do not swap here
+		const TSceneVersion* version = _activeVersion.load();
+		if (version == nullptr)
+		{
+			for (uint32_t outputIdx = 0; outputIdx < numIndices; ++outputIdx)
+				write_miss(intersectionArray[outputIdx]);
+			return;
+		}
+		const TScene& targetScene = *version->targetScene;
+
+		// Gather the requested hits, the output slot takes the place of the ray index
+		_hitBuffer.resize(numIndices);
+		uint32_t numHits = 0;
+		for (uint32_t outputIdx = 0; outputIdx < numIndices; ++outputIdx)
+		{
+			const THitRecord& currentRecord = recordArray[indexArray != nullptr ? indexArray[outputIdx] : outputIdx];
+			if (currentRecord.geometryIndex == (uint32_t)-1)
+			{
+				write_miss(intersectionArray[outputIdx]);
+				continue;
+			}
+			_hitBuffer.rayIndexArray[numHits] = outputIdx;
+			_hitBuffer.geometryArray[numHits] = currentRecord.geometryIndex;
+			_hitBuffer.primitiveArray[numHits] = currentRecord.triangleID;
+			_hitBuffer.tArray[numHits] = currentRecord.t;
+			_hitBuffer.uArray[numHits] = currentRecord.u;
+			_hitBuffer.vArray[numHits] = currentRecord.v;
+			numHits++;
+		}
+		_hitBuffer.resize(numHits);
+
+		sort_hits_by_geometry(_hitBuffer, scene_slot_count(targetScene), _sortCounterArray, _sortedHitBuffer);
+		resolve_hits(targetScene, _sortedHitBuffer, attributeMask, _attributeBuffer);
+		scatter_hits(targetScene, attributeMask, intersectionArray);
+	}
+
+	void TRaycastManager::resolve_attributes(const THitRecord* recordArray, const uint32_t* indexArray, uint32_t numIndices, float* attributeArray, uint32_t numComponents)
+	{
+		const TSceneVersion* version = _activeVersion.load();
+		memset(attributeArray, 0, sizeof(float) * numComponents * numIndices);
+		if (version == nullptr || numComponents == 0)
+			return;
+		const TScene& targetScene = *version->targetScene;
+
+		#pragma omp parallel for
+		for (int32_t outputIdx = 0; outputIdx < (int32_t)numIndices; ++outputIdx)
+		{
+			const THitRecord& currentRecord = recordArray[indexArray != nullptr ? indexArray[outputIdx] : outputIdx];
+			if (currentRecord.geometryIndex == (uint32_t)-1)
+				continue;
+
+			// Skip the primitives and the geometries that do not carry enough attributes
+			if (currentRecord.geometryIndex == primitive_slot(targetScene))
+				continue;
+			const TGeometry& targetGeometry = targetScene.geometryArray[currentRecord.geometryIndex];
+			if (targetGeometry.numAttributeComponents < numComponents)
+				continue;
+
+			// Quads are interpolated with the parametrization of embree
+			uint32_t primID = currentRecord.triangleID;
+			float u = currentRecord.u, v = currentRecord.v;
+			if (targetGeometry.quadTopology)
+				triangle_hit_to_quad(primID, u, v);
+
+			RTCGeometry geometry = mesh_geometry(*version, currentRecord.geometryIndex);
+			rtcInterpolate0(geometry, primID, u, v, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, attributeArray + (size_t)outputIdx * numComponents, numComponents);
+		}
+	}
+
+	// Intersection context of the multi-hit queries, the embree context has to be the first member
+	struct TMultiHitContext
+	{
+		RTCIntersectContext context;
+		const TSceneVersion* version;
+		const TScene* targetScene;
+		uint32_t maxHits;
+		THitRecord* recordArray;
+		uint32_t* hitCountArray;
+	};
+
+	// Records every hit in the per-ray list (sorted by distance) and rejects it so that the traversal goes on
+	static void multi_hit_filter(const RTCFilterFunctionNArguments* args)
+	{
+		const TMultiHitContext* multiHitContext = (const TMultiHitContext*)args->context;
+		for (uint32_t laneIdx = 0; laneIdx < args->N; ++laneIdx)
+		{
+			if (args->valid[laneIdx] == 0)
+				continue;
+			args->valid[laneIdx] = 0;
+
+			uint32_t rayIndex = RTCRayN_id(args->ray, args->N, laneIdx);
+			float t = RTCRayN_tfar(args->ray, args->N, laneIdx);
+			uint32_t geomID = hit_slot(RTCHitN_geomID(args->hit, args->N, laneIdx), RTCHitN_instID(args->hit, args->N, laneIdx, 0));
+			uint32_t primID = RTCHitN_primID(args->hit, args->N, laneIdx);
+			float u = RTCHitN_u(args->hit, args->N, laneIdx);
+			float v = RTCHitN_v(args->hit, args->N, laneIdx);
+			unmerge_hit(*multiHitContext->version, geomID, primID);
+			canonical_hit(*multiHitContext->targetScene, geomID, primID, u, v);
+			THitRecord* rayRecords = multiHitContext->recordArray + (size_t)rayIndex * multiHitContext->maxHits;
+			uint32_t& numHits = multiHitContext->hitCountArray[rayIndex];
+
+			// A triangle can be reported more than once by the traversal
+			bool duplicate = false;
+			for (uint32_t hitIdx = 0; hitIdx < numHits && !duplicate; ++hitIdx)
+				duplicate = rayRecords[hitIdx].geometryIndex == geomID && rayRecords[hitIdx].triangleID == primID;
+			if (duplicate)
+				continue;
+
+			// Farther than all the kept hits
+			if (numHits == multiHitContext->maxHits && t >= rayRecords[numHits - 1].t)
+				continue;
+
+			// Insertion sort, the farthest hit is dropped when the list is full
+			uint32_t insertIdx = numHits < multiHitContext->maxHits ? numHits : numHits - 1;
+			while (insertIdx > 0 && rayRecords[insertIdx - 1].t > t)
+			{
+				rayRecords[insertIdx] = rayRecords[insertIdx - 1];
+				insertIdx--;
+			}
+			THitRecord& newRecord = rayRecords[insertIdx];
+			newRecord.geometryIndex = geomID;
+			newRecord.triangleID = primID;
+			newRecord.u = u;
+			newRecord.v = v;
+			newRecord.t = t;
+			if (numHits < multiHitContext->maxHits)
+				numHits++;
+		}
+	}
+
+	void TRaycastManager::run_multi_hit(const TRay* rayArray, TIntersection* intersectionArray, uint32_t* hitCountArray, uint32_t numRays, uint32_t maxHits)
+	{
+		memset(hitCountArray, 0, sizeof(uint32_t) * numRays);
+
+		// Fetch the version to query
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr || maxHits == 0)
+		{
+			for (uint32_t slotIdx = 0; slotIdx < numRays * maxHits; ++slotIdx)
+				write_miss(intersectionArray[slotIdx]);
+			return;
+		}
+		assert_msg(version->contextFilter, "Multi hit queries need enable_multi_hit before the setup");
+		const TScene& targetScene = *version->targetScene;
+
+		// Collect the hits through the context filter during a single traversal
+		_multiHitArray.resize(numRays * maxHits);
+		TMultiHitContext multiHitContext;
+		rtcInitIntersectContext(&multiHitContext.context);
+		multiHitContext.context.filter = multi_hit_filter;
+		multiHitContext.version = version;
+		multiHitContext.targetScene = &targetScene;
+		multiHitContext.maxHits = maxHits;
+		multiHitContext.recordArray = _multiHitArray.begin();
+		multiHitContext.hitCountArray = hitCountArray;
+		trace(*version, rayArray, numRays, &multiHitContext.context);
+
+		// Each hit is resolved into its slot, the unused slots are misses
+		_hitBuffer.resize(numRays * maxHits);
+		uint32_t numHits = 0;
+		for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+		{
+			for (uint32_t hitIdx = 0; hitIdx < maxHits; ++hitIdx)
+			{
+				uint32_t slotIdx = rayIdx * maxHits + hitIdx;
+				if (hitIdx >= hitCountArray[rayIdx])
+				{
+					write_miss(intersectionArray[slotIdx]);
+					continue;
+				}
+				const THitRecord& currentRecord = _multiHitArray[slotIdx];
+				_hitBuffer.rayIndexArray[numHits] = slotIdx;
+				_hitBuffer.geometryArray[numHits] = currentRecord.geometryIndex;
+				_hitBuffer.primitiveArray[numHits] = currentRecord.triangleID;
+				_hitBuffer.tArray[numHits] = currentRecord.t;
+				_hitBuffer.uArray[numHits] = currentRecord.u;
+				_hitBuffer.vArray[numHits] = currentRecord.v;
+				numHits++;
+			}
+		}
+		_hitBuffer.resize(numHits);
+
+		sort_hits_by_geometry(_hitBuffer, scene_slot_count(targetScene), _sortCounterArray, _sortedHitBuffer);
+		resolve_hits(targetScene, _sortedHitBuffer, ResolveAttribute::All, _attributeBuffer);
+		scatter_hits(targetScene, ResolveAttribute::All, intersectionArray);
+	}
+
+	void TRaycastManager::closest_points(const TPointQuery* queryArray, TClosestPoint* resultArray, uint32_t numQueries)
+	{
+		// Fetch the version to query
+		const TSceneVersion* version = acquire_version();
+		const TTriangleBVH* bvh = version != nullptr ? version->triangleBVH : nullptr;
+		if (bvh == nullptr)
+			bento::default_logger()->log(bento::LogLevel::warning, "RCU", "Spatial queries are not enabled for the current scene");
+
+		#pragma omp parallel for
+		for (int32_t queryIdx = 0; queryIdx < (int32_t)numQueries; ++queryIdx)
+		{
+			const TPointQuery& query = queryArray[queryIdx];
+			TClosestPoint& result = resultArray[queryIdx];
+
+			TBVHClosestHit closestHit;
+			if (bvh != nullptr && bvh_closest_point(*bvh, query.position, query.maxDistance, closestHit))
+			{
+				const TGeometry& targetGeometry = version->targetScene->geometryArray[closestHit.geometryIndex];
+				result.validity = 1;
+				result.distance = sqrtf(closestHit.distanceSq);
+				result.geometryID = targetGeometry.gameObjectID;
+				result.subMeshID = targetGeometry.subMeshID;
+				result.triangleID = closestHit.triangleIndex;
+				result.barycentricCoordinates = { 1.0f - closestHit.u - closestHit.v, closestHit.u, closestHit.v };
+				result.position = closestHit.position;
 			}
 			else
 			{
-				currentIntersection.validity = 0;
-				currentIntersection.t = FLT_MAX;
-				currentIntersection.geometryID = (uint32_t)-1;
-				currentIntersection.subMeshID = (uint32_t)-1;
-				currentIntersection.triangleID = (uint32_t)-1;
-				currentIntersection.barycentricCoordinates = { 0, 0, 0 };
-				currentIntersection.position = { 0, 0, 0 };
-				currentIntersection.normal = { 0, 0, 0 };
-				currentIntersection.texCoord = { 0, 0 };
+				result.validity = 0;
+				result.distance = FLT_MAX;
+				result.geometryID = (uint32_t)-1;
+				result.subMeshID = (uint32_t)-1;
+				result.triangleID = (uint32_t)-1;
+				result.barycentricCoordinates = { 0, 0, 0 };
+				result.position = { 0, 0, 0 };
+			}
+		}
+	}
+
+	template<typename TQuery, uint32_t(*OverlapFunction)(const TTriangleBVH&, const TQuery&, TBVHOverlap*, uint32_t)>
+	static uint32_t run_overlaps(const TSceneVersion* version, const TQuery* queryArray, uint32_t numQueries, bento::Vector<uint32_t>& offsetArray, bento::IAllocator& allocator, TOverlap* overlapArray, uint32_t capacity)
+	{
+		const TTriangleBVH* bvh = version != nullptr ? version->triangleBVH : nullptr;
+		if (bvh == nullptr)
+		{
+			bento::default_logger()->log(bento::LogLevel::warning, "RCU", "Spatial queries are not enabled for the current scene");
+			return 0;
+		}
+
+		offsetArray.resize(numQueries + 1);
+		offsetArray[0] = 0;
+		uint32_t numOverlaps = 0;
+		#pragma omp parallel
+		{
+			// Every thread traverses once per query and appends to its own buffer, the static schedule hands it a single
+			// contiguous range of queries
+			bento::Vector<TBVHOverlap> threadArray(allocator);
+			threadArray.resize(RCU_OVERLAP_THREAD_BUFFER);
+			uint32_t numThreadOverlaps = 0;
+			uint32_t firstQuery = numQueries, lastQuery = 0;
+			#pragma omp for schedule(static)
+			for (int32_t queryIdx = 0; queryIdx < (int32_t)numQueries; ++queryIdx)
+			{
+				uint32_t freeSize = threadArray.size() - numThreadOverlaps;
+				uint32_t numQueryOverlaps = OverlapFunction(*bvh, queryArray[queryIdx], threadArray.begin() + numThreadOverlaps, freeSize);
+				if (numQueryOverlaps > freeSize)
+				{
+					// Only the queries that outgrow the buffer are traversed again
+					threadArray.resize(2 * (numThreadOverlaps + numQueryOverlaps));
+					OverlapFunction(*bvh, queryArray[queryIdx], threadArray.begin() + numThreadOverlaps, numQueryOverlaps);
+				}
+				numThreadOverlaps += numQueryOverlaps;
+				offsetArray[queryIdx + 1] = numQueryOverlaps;
+				firstQuery = firstQuery < (uint32_t)queryIdx ? firstQuery : (uint32_t)queryIdx;
+				lastQuery = (uint32_t)queryIdx + 1;
+			}
+
+			#pragma omp single
+			{
+				for (uint32_t queryIdx = 0; queryIdx < numQueries; ++queryIdx)
+					offsetArray[queryIdx + 1] += offsetArray[queryIdx];
+				numOverlaps = offsetArray[numQueries];
+			}
+
+			// Copy the buffer at the offset of its first query, dropping what doesn't fit
+			uint32_t threadIdx = 0;
+			for (uint32_t queryIdx = firstQuery; queryIdx < lastQuery; ++queryIdx)
+			{
+				for (uint32_t overlapIdx = offsetArray[queryIdx]; overlapIdx < offsetArray[queryIdx + 1]; ++overlapIdx, ++threadIdx)
+				{
+					if (overlapIdx >= capacity)
+						continue;
+					const TBVHOverlap& rawOverlap = threadArray[threadIdx];
+					const TGeometry& targetGeometry = version->targetScene->geometryArray[rawOverlap.geometryIndex];
+					TOverlap& overlap = overlapArray[overlapIdx];
+					overlap.queryIndex = queryIdx;
+					overlap.geometryID = targetGeometry.gameObjectID;
+					overlap.subMeshID = targetGeometry.subMeshID;
+					overlap.triangleID = rawOverlap.triangleIndex;
+				}
 			}
 		}
+		return numOverlaps;
+	}
+
+	uint32_t TRaycastManager::overlap_boxes(const TBoxQuery* queryArray, uint32_t numQueries, OverlapMode::Type mode, TOverlap* overlapArray, uint32_t capacity)
+	{
+		const TSceneVersion* version = acquire_version();
+		if (mode == OverlapMode::Geometries)
+			return run_overlaps<TBoxQuery, bvh_overlap_box_geometries>(version, queryArray, numQueries, _overlapOffsetArray, _allocator, overlapArray, capacity);
+		return run_overlaps<TBoxQuery, bvh_overlap_box>(version, queryArray, numQueries, _overlapOffsetArray, _allocator, overlapArray, capacity);
+	}
+
+	uint32_t TRaycastManager::overlap_spheres(const TSphereQuery* queryArray, uint32_t numQueries, OverlapMode::Type mode, TOverlap* overlapArray, uint32_t capacity)
+	{
+		const TSceneVersion* version = acquire_version();
+		if (mode == OverlapMode::Geometries)
+			return run_overlaps<TSphereQuery, bvh_overlap_sphere_geometries>(version, queryArray, numQueries, _overlapOffsetArray, _allocator, overlapArray, capacity);
+		return run_overlaps<TSphereQuery, bvh_overlap_sphere>(version, queryArray, numQueries, _overlapOffsetArray, _allocator, overlapArray, capacity);
+	}
+
+	template<typename TCast, bool(*SweepFunction)(const TTriangleBVH&, const TCast&, TBVHSweepHit&)>
+	static void run_shape_casts(const TSceneVersion* version, const TCast* castArray, TShapeHit* hitArray, uint32_t numCasts)
+	{
+		const TTriangleBVH* bvh = version != nullptr ? version->triangleBVH : nullptr;
+		if (bvh == nullptr)
+			bento::default_logger()->log(bento::LogLevel::warning, "RCU", "Spatial queries are not enabled for the current scene");
+
+		#pragma omp parallel for
+		for (int32_t castIdx = 0; castIdx < (int32_t)numCasts; ++castIdx)
+		{
+			TShapeHit& hit = hitArray[castIdx];
+			TBVHSweepHit sweepHit;
+			if (bvh != nullptr && SweepFunction(*bvh, castArray[castIdx], sweepHit))
+			{
+				const TGeometry& targetGeometry = version->targetScene->geometryArray[sweepHit.geometryIndex];
+				hit.validity = 1;
+				hit.distance = sweepHit.distance;
+				hit.geometryID = targetGeometry.gameObjectID;
+				hit.subMeshID = targetGeometry.subMeshID;
+				hit.triangleID = sweepHit.triangleIndex;
+				hit.position = sweepHit.position;
+				hit.normal = sweepHit.normal;
+			}
+			else
+			{
+				hit.validity = 0;
+				hit.distance = FLT_MAX;
+				hit.geometryID = (uint32_t)-1;
+				hit.subMeshID = (uint32_t)-1;
+				hit.triangleID = (uint32_t)-1;
+				hit.position = { 0, 0, 0 };
+				hit.normal = { 0, 0, 0 };
+			}
+		}
+	}
+
+	void TRaycastManager::sphere_casts(const TSphereCast* castArray, TShapeHit* hitArray, uint32_t numCasts)
+	{
+		run_shape_casts<TSphereCast, bvh_sweep_sphere>(acquire_version(), castArray, hitArray, numCasts);
+	}
+
+	void TRaycastManager::capsule_casts(const TCapsuleCast* castArray, TShapeHit* hitArray, uint32_t numCasts)
+	{
+		run_shape_casts<TCapsuleCast, bvh_sweep_capsule>(acquire_version(), castArray, hitArray, numCasts);
+	}
+
+	void TRaycastManager::ambient_occlusion(const TOcclusionPoint* pointArray, float* visibilityArray, uint32_t numPoints, uint32_t numSamples, float radius, uint32_t mask)
+	{
+		// Nothing can occlude the points without a scene
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+		{
+			for (uint32_t pointIdx = 0; pointIdx < numPoints; ++pointIdx)
+				visibilityArray[pointIdx] = 1.0f;
+			return;
+		}
+		estimate_ambient_occlusion(*version, pointArray, numPoints, numSamples, radius, mask, visibilityArray);
+	}
+
+	void TRaycastManager::bake_visibility(uint32_t geometryIdx, uint32_t width, uint32_t height, const TBakeLight* lightArray, uint32_t numLights, uint32_t mask, float* atlas)
+	{
+		// Without a scene no texel is covered
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+		{
+			for (size_t texelIdx = 0; texelIdx < (size_t)width * height * numLights; ++texelIdx)
+				atlas[texelIdx] = -1.0f;
+			return;
+		}
+
+		rasterize_texels(version->targetScene->geometryArray[geometryIdx], width, height, _texelBuffer);
+		bake_texel_visibility(*version, _texelBuffer, width, height, lightArray, numLights, mask, atlas);
+	}
+
+	void TRaycastManager::line_of_sight(const bento::Vector3* sourceArray, uint32_t numSources, const bento::Vector3* targetArray, uint32_t numTargets, uint32_t mask, uint32_t* bitMatrix)
+	{
+		// Without a scene every pair is visible, the padding bits of the rows stay cleared
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+		{
+			if (targetArray == nullptr)
+				numTargets = numSources;
+			uint32_t rowWords = line_of_sight_row_words(numTargets);
+			memset(bitMatrix, 0, sizeof(uint32_t) * rowWords * numSources);
+			for (uint32_t sourceIdx = 0; sourceIdx < numSources; ++sourceIdx)
+			{
+				uint32_t* row = bitMatrix + (size_t)sourceIdx * rowWords;
+				for (uint32_t targetIdx = 0; targetIdx < numTargets; ++targetIdx)
+					row[targetIdx / 32] |= 1u << (targetIdx % 32);
+			}
+			return;
+		}
+		line_of_sight_matrix(*version, sourceArray, numSources, targetArray, numTargets, mask, bitMatrix);
+	}
+
+	void TRaycastManager::distance_samples(const bento::Vector3* pointArray, TDistanceSample* sampleArray, uint32_t numPoints)
+	{
+		const TSceneVersion* version = acquire_version();
+		const TDistanceField* field = version != nullptr ? version->distanceField : nullptr;
+
+		#pragma omp parallel for
+		for (int32_t pointIdx = 0; pointIdx < (int32_t)numPoints; ++pointIdx)
+		{
+			if (field != nullptr)
+			{
+				sampleArray[pointIdx] = sample_distance_field(*field, pointArray[pointIdx]);
+			}
+			else
+			{
+				sampleArray[pointIdx].distance = FLT_MAX;
+				sampleArray[pointIdx].error = FLT_MAX;
+			}
+		}
+	}
+
+	void TRaycastManager::approximate_raycasts(const TRay* rayArray, TDistanceHit* hitArray, uint32_t numRays)
+	{
+		const TSceneVersion* version = acquire_version();
+		const TDistanceField* field = version != nullptr ? version->distanceField : nullptr;
+
+		#pragma omp parallel for
+		for (int32_t rayIdx = 0; rayIdx < (int32_t)numRays; ++rayIdx)
+		{
+			if (field != nullptr)
+			{
+				sphere_trace(*field, rayArray[rayIdx], hitArray[rayIdx]);
+			}
+			else
+			{
+				hitArray[rayIdx].validity = 0;
+				hitArray[rayIdx].t = FLT_MAX;
+				hitArray[rayIdx].error = 0.0f;
+				hitArray[rayIdx].clearance = FLT_MAX;
+			}
+		}
+	}
+
+	void TRaycastManager::bake_visibility_grid(const bento::Vector3& origin, const bento::Vector3& cellSize, const uint32_t* resolution, uint32_t numSamples, uint32_t mask)
+	{
+		// Without a scene there is nothing to bake against, the lookups fall back to the exact rays
+		const TSceneVersion* version = acquire_version();
+		if (version == nullptr)
+		{
+			clear_visibility_grid(_visibilityGrid);
+			return;
+		}
+		rcu::bake_visibility_grid(*version, origin, cellSize, resolution, numSamples, mask, _visibilityGrid);
+	}
+
+	CellVisibility::Type TRaycastManager::cell_visibility(uint32_t cellA, uint32_t cellB) const
+	{
+		uint32_t numCells = _visibilityGrid.rowOffsetArray.size();
+		if (cellA >= numCells || cellB >= numCells)
+			return CellVisibility::Unknown;
+		return visibility_grid_state(_visibilityGrid, cellA, cellB);
+	}
+
+	void TRaycastManager::potential_visibility(const bento::Vector3* sourceArray, const bento::Vector3* targetArray, uint32_t numPairs, uint32_t mask, uint8_t* visibleArray)
+	{
+		rcu::potential_visibility(acquire_version(), _visibilityGrid, sourceArray, targetArray, numPairs, mask, visibleArray);
+	}
+
+	void TRaycastManager::setup_world(uint64_t memoryBudget)
+	{
+		reset_tiled_world(_world, _device, memoryBudget);
+	}
+
+	void TRaycastManager::release_world()
+	{
+		release_tiled_world(_world);
+		_worldHitArray.clear();
+	}
+
+	uint32_t TRaycastManager::add_world_tile(const bento::Vector3& minBound, const bento::Vector3& maxBound, const TScene* scene, const char* cachePath)
+	{
+		// The world may not have been set up yet
+		_world.device = _device;
+		return rcu::add_world_tile(_world, minBound, maxBound, scene, cachePath);
+	}
+
+	void TRaycastManager::request_world_tile(uint32_t tileIdx)
+	{
+		rcu::request_world_tile(_world, tileIdx);
+	}
+
+	void TRaycastManager::request_world_region(const bento::Vector3& center, float radius)
+	{
+		rcu::request_world_region(_world, center, radius);
+	}
+
+	void TRaycastManager::evict_world_tile(uint32_t tileIdx)
+	{
+		rcu::evict_world_tile(_world, tileIdx);
+	}
+
+	TileStatus::Type TRaycastManager::world_tile_status(uint32_t tileIdx) const
+	{
+		if (tileIdx >= _world.tileArray.size())
+			return TileStatus::Failed;
+		return (TileStatus::Type)_world.tileArray[tileIdx]->status.load();
+	}
+
+	void TRaycastManager::run_world(const TRay* rayArray, TIntersection* intersectionArray, uint32_t* tileArray, uint32_t numRays)
+	{
+		if (_world.tileArray.size() == 0)
+		{
+			for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+			{
+				write_miss(intersectionArray[rayIdx]);
+				tileArray[rayIdx] = RCU_WORLD_NO_TILE;
+			}
+			return;
+		}
+
+		// Publish the tiles loaded since the last query and trace the top level scene
+		update_tiled_world(_world);
+		_worldHitArray.resize(numRays);
+		trace_tiled_world(_world, rayArray, numRays, _worldHitArray.begin());
+
+		// The hits are resolved against the scene of their tile
+		TOutputLayout layout;
+		init_output_layout(layout, intersectionArray, sizeof(TIntersection), false);
+		layout.offsets[IntersectionAttribute::Validity] = offsetof(TIntersection, validity);
+		layout.offsets[IntersectionAttribute::Distance] = offsetof(TIntersection, t);
+		layout.offsets[IntersectionAttribute::GeometryID] = offsetof(TIntersection, geometryID);
+		layout.offsets[IntersectionAttribute::SubMeshID] = offsetof(TIntersection, subMeshID);
+		layout.offsets[IntersectionAttribute::TriangleID] = offsetof(TIntersection, triangleID);
+		layout.offsets[IntersectionAttribute::Barycentrics] = offsetof(TIntersection, barycentricCoordinates);
+		layout.offsets[IntersectionAttribute::Position] = offsetof(TIntersection, position);
+		layout.offsets[IntersectionAttribute::Normal] = offsetof(TIntersection, normal);
+		layout.offsets[IntersectionAttribute::TexCoord] = offsetof(TIntersection, texCoord);
+
+		#pragma omp parallel for
+		for (int32_t rayIdx = 0; rayIdx < (int32_t)numRays; ++rayIdx)
+		{
+			const TWorldHit& hit = _worldHitArray[rayIdx];
+			tileArray[rayIdx] = hit.tile;
+			if (hit.tile == RCU_WORLD_NO_TILE || (hit.tile & RCU_WORLD_TILE_PENDING) != 0)
+			{
+				write_miss(intersectionArray[rayIdx]);
+				if (hit.tile != RCU_WORLD_NO_TILE)
+					intersectionArray[rayIdx].t = hit.t;
+				continue;
+			}
+			const TScene& tileScene = *_world.tileArray[hit.tile]->version->targetScene;
+			write_layout_hit(tileScene, layout, (char*)(intersectionArray + rayIdx), rayIdx, hit.geomID, hit.primID, hit.t, hit.u, hit.v);
+		}
+	}
+
+	void TRaycastManager::trace_reflection_paths(const TRay* emitterArray, TPathEndpoint* endpointArray, uint32_t numPaths, uint32_t maxBounces, float minEnergy)
+	{
+		rcu::trace_reflection_paths(acquire_version(), emitterArray, numPaths, maxBounces, minEnergy, _pathQueues, endpointArray);
 	}
 }
\ No newline at end of file
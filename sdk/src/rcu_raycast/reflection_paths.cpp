@@ -0,0 +1,188 @@
+// sdk includes
+#include "rcu_raycast/reflection_paths.h"
+#include "rcu_raycast/hit_resolve.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+#include <bento_math/vector2.h>
+
+// External includes
+#include <math.h>
+
+namespace rcu
+{
+	// Distance the reflected rays are pushed away from the surface, relative to the magnitude of the hit position
+	#define RCU_REFLECTION_RAY_OFFSET 1e-4f
+
+	TPathQueues::TPathQueues(bento::IAllocator& allocator)
+	: rayArray(allocator)
+	, pathArray(allocator)
+	, aliveArray(allocator)
+	{
+	}
+
+	// Geometric normal and reflection coefficient of the surface that was hit
+	static void surface_at_hit(const TScene& scene, uint32_t slot, uint32_t primID, float u, float v, bento::Vector3& normal, float& reflectionCoefficient)
+	{
+		if (slot == primitive_slot(scene))
+		{
+			bento::Vector3 position;
+			bento::Vector2 texCoord;
+			resolve_primitive_hit(scene, primID, u, v, position, normal, texCoord);
+			reflectionCoefficient = scene.primitiveArray[primID >> RCU_PRIMITIVE_PART_BITS].reflectionCoefficient;
+			return;
+		}
+
+		const TGeometry& geometry = scene.geometryArray[slot];
+		const bento::IVector3& face = geometry.indexArray[primID];
+		const bento::Vector3& p0 = geometry.vertexArray[face.x];
+		normal = bento::cross(geometry.vertexArray[face.y] - p0, geometry.vertexArray[face.z] - p0);
+		if (geometry.instanced)
+			normal = instance_normal(geometry, normal);
+		normal = bento::normalize(normal);
+		reflectionCoefficient = geometry.reflectionCoefficient;
+	}
+
+	void trace_reflection_paths(const TSceneVersion* version, const TRay* emitterArray, uint32_t numPaths, uint32_t maxBounces, float minEnergy, TPathQueues& queues, TPathEndpoint* endpointArray)
+	{
+		// Every path starts with its emitter ray, the directions are normalized so that t measures the path length
+		queues.rayArray.resize(numPaths);
+		queues.pathArray.resize(numPaths);
+		queues.aliveArray.resize(numPaths);
+		uint32_t numQueued = 0;
+		for (uint32_t pathIdx = 0; pathIdx < numPaths; ++pathIdx)
+		{
+			const TRay& emitter = emitterArray[pathIdx];
+			float directionLength = bento::length(emitter.direction);
+			TRay currentRay = emitter;
+			currentRay.direction = directionLength > 0.0f ? emitter.direction * (1.0f / directionLength) : emitter.direction;
+			currentRay.tmin = emitter.tmin * directionLength;
+			currentRay.tmax = emitter.tmax * directionLength;
+
+			// An emitter without a direction escapes right away
+			if (directionLength > 0.0f)
+			{
+				queues.rayArray[numQueued] = currentRay;
+				queues.pathArray[numQueued] = pathIdx;
+				numQueued++;
+			}
+
+			TPathEndpoint& endpoint = endpointArray[pathIdx];
+			endpoint.numBounces = 0;
+			endpoint.escaped = 1;
+			endpoint.energy = 1.0f;
+			endpoint.distance = 0.0f;
+			endpoint.geometryID = (uint32_t)-1;
+			endpoint.subMeshID = (uint32_t)-1;
+			endpoint.position = emitter.origin;
+			endpoint.direction = currentRay.direction;
+		}
+
+		uint32_t numActive = version != nullptr ? numQueued : 0;
+		for (uint32_t bounceIdx = 0; bounceIdx < maxBounces && numActive > 0; ++bounceIdx)
+		{
+			const TScene& targetScene = *version->targetScene;
+
+			// Trace the current segment of all the active paths, every worker updates its own lanes in place
+			int32_t numPackets = (int32_t)((numActive + 15) / 16);
+			#pragma omp parallel for
+			for (int32_t packetIdx = 0; packetIdx < numPackets; ++packetIdx)
+			{
+				RTCIntersectContext context;
+				rtcInitIntersectContext(&context);
+
+				alignas(64) RTCRayHit16 rayHit;
+				alignas(64) int valid[16];
+				uint32_t firstRay = packetIdx * 16;
+				uint32_t numLanes = numActive - firstRay < 16 ? numActive - firstRay : 16;
+				for (uint32_t laneIdx = 0; laneIdx < 16; ++laneIdx)
+				{
+					if (laneIdx >= numLanes)
+					{
+						valid[laneIdx] = 0;
+						continue;
+					}
+					valid[laneIdx] = -1;
+
+					const TRay& currentRay = queues.rayArray[firstRay + laneIdx];
+					rayHit.ray.org_x[laneIdx] = currentRay.origin.x;
+					rayHit.ray.org_y[laneIdx] = currentRay.origin.y;
+					rayHit.ray.org_z[laneIdx] = currentRay.origin.z;
+					rayHit.ray.dir_x[laneIdx] = currentRay.direction.x;
+					rayHit.ray.dir_y[laneIdx] = currentRay.direction.y;
+					rayHit.ray.dir_z[laneIdx] = currentRay.direction.z;
+					rayHit.ray.tnear[laneIdx] = currentRay.tmin;
+					rayHit.ray.tfar[laneIdx] = currentRay.tmax;
+					rayHit.ray.mask[laneIdx] = currentRay.mask;
+					rayHit.ray.time[laneIdx] = 0.0f;
+					rayHit.ray.flags[laneIdx] = 0;
+					rayHit.hit.instID[0][laneIdx] = RTC_INVALID_GEOMETRY_ID;
+					rayHit.hit.geomID[laneIdx] = RTC_INVALID_GEOMETRY_ID;
+				}
+
+				rtcIntersect16(valid, version->scene, &context, &rayHit);
+
+				for (uint32_t laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+				{
+					uint32_t queueIdx = firstRay + laneIdx;
+					TRay& currentRay = queues.rayArray[queueIdx];
+					TPathEndpoint& endpoint = endpointArray[queues.pathArray[queueIdx]];
+					queues.aliveArray[queueIdx] = 0;
+
+					// The path leaves the scene, possibly after some bounces
+					if (rayHit.hit.geomID[laneIdx] == RTC_INVALID_GEOMETRY_ID)
+					{
+						endpoint.escaped = 1;
+						continue;
+					}
+
+					uint32_t slot = hit_slot(rayHit.hit.geomID[laneIdx], rayHit.hit.instID[0][laneIdx]);
+					uint32_t primID = rayHit.hit.primID[laneIdx];
+					float u = rayHit.hit.u[laneIdx], v = rayHit.hit.v[laneIdx];
+					float t = rayHit.ray.tfar[laneIdx];
+					unmerge_hit(*version, slot, primID);
+					canonical_hit(targetScene, slot, primID, u, v);
+
+					bento::Vector3 normal;
+					float reflectionCoefficient;
+					surface_at_hit(targetScene, slot, primID, u, v, normal, reflectionCoefficient);
+					uint32_t triangleID;
+					hit_owner(targetScene, slot, primID, endpoint.geometryID, endpoint.subMeshID, triangleID);
+
+					// Specular reflection
+					bento::Vector3 position = currentRay.origin + currentRay.direction * t;
+					float cosine = bento::dot(currentRay.direction, normal);
+					endpoint.numBounces++;
+					endpoint.escaped = 0;
+					endpoint.energy *= reflectionCoefficient;
+					endpoint.distance += t;
+					endpoint.position = position;
+					endpoint.direction = currentRay.direction - normal * (2.0f * cosine);
+					if (endpoint.numBounces >= maxBounces || endpoint.energy < minEnergy)
+						continue;
+
+					// Next segment starts on the incoming side of the surface with what is left of the range
+					float magnitude = fmaxf(1.0f, fmaxf(fabsf(position.x), fmaxf(fabsf(position.y), fabsf(position.z))));
+					float side = cosine > 0.0f ? -1.0f : 1.0f;
+					currentRay.origin = position + normal * (side * RCU_REFLECTION_RAY_OFFSET * magnitude);
+					currentRay.direction = endpoint.direction;
+					currentRay.tmin = 0.0f;
+					currentRay.tmax -= t;
+					queues.aliveArray[queueIdx] = 1;
+				}
+			}
+
+			// Keep the paths that go on for the next bounce
+			uint32_t numAlive = 0;
+			for (uint32_t queueIdx = 0; queueIdx < numActive; ++queueIdx)
+			{
+				if (!queues.aliveArray[queueIdx])
+					continue;
+				queues.rayArray[numAlive] = queues.rayArray[queueIdx];
+				queues.pathArray[numAlive] = queues.pathArray[queueIdx];
+				numAlive++;
+			}
+			numActive = numAlive;
+		}
+	}
+}
@@ -0,0 +1,250 @@
+// sdk includes
+#include "rcu_raycast/result_cache.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+
+// External includes
+#include <math.h>
+#include <string.h>
+
+namespace rcu
+{
+	// Number of slots probed from the home slot of a key
+	#define RCU_RESULT_CACHE_PROBES 4
+	// Past this many logged changes the older half is trimmed, the entries that predate it are dropped
+	#define RCU_RESULT_CACHE_MAX_CHANGES 256
+
+	TResultCache::TResultCache(bento::IAllocator& allocator)
+	: quantum(0.0f)
+	, entryArray(allocator)
+	, currentEpoch(1)
+	, minValidEpoch(1)
+	, changeArray(allocator)
+	, geometryMinArray(allocator)
+	, geometryMaxArray(allocator)
+	, missIndexArray(allocator)
+	, missRayArray(allocator)
+	, missIntersectionArray(allocator)
+	{
+	}
+
+	void reset_result_cache(TResultCache& cache, const TScene* scene, uint32_t capacity, float quantum)
+	{
+		uint32_t numEntries = 0;
+		if (capacity > 0)
+		{
+			numEntries = 1;
+			while (numEntries < capacity)
+				numEntries <<= 1;
+		}
+		cache.quantum = quantum;
+		cache.entryArray.resize(numEntries);
+		clear_result_cache(cache, scene);
+	}
+
+	void clear_result_cache(TResultCache& cache, const TScene* scene)
+	{
+		if (cache.entryArray.size() == 0)
+			return;
+
+		uint32_t numEntries = cache.entryArray.size();
+		for (uint32_t entryIdx = 0; entryIdx < numEntries; ++entryIdx)
+			cache.entryArray[entryIdx].epoch = 0;
+		cache.currentEpoch = 1;
+		cache.minValidEpoch = 1;
+		cache.changeArray.clear();
+
+		// Bounds the geometries start from, the changes are logged against them
+		uint32_t numGeometries = scene != nullptr ? scene->geometryArray.size() : 0;
+		cache.geometryMinArray.resize(numGeometries);
+		cache.geometryMaxArray.resize(numGeometries);
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+			geometry_world_bounds(scene->geometryArray[geoIdx], cache.geometryMinArray[geoIdx], cache.geometryMaxArray[geoIdx]);
+	}
+
+	void record_geometry_change(TResultCache& cache, const TScene& scene, uint32_t geometryIdx)
+	{
+		if (cache.entryArray.size() == 0 || geometryIdx >= cache.geometryMinArray.size())
+			return;
+
+		// Trim the older half of the log, the entries that predate the last trimmed change can't be checked anymore
+		if (cache.changeArray.size() == RCU_RESULT_CACHE_MAX_CHANGES)
+		{
+			uint32_t numKept = RCU_RESULT_CACHE_MAX_CHANGES / 2;
+			cache.minValidEpoch = cache.changeArray[RCU_RESULT_CACHE_MAX_CHANGES - numKept - 1].epoch;
+			memmove(cache.changeArray.begin(), cache.changeArray.begin() + RCU_RESULT_CACHE_MAX_CHANGES - numKept, sizeof(TGeometryChange) * numKept);
+			cache.changeArray.resize(numKept);
+		}
+
+		// The change covers both the old and the new position of the geometry
+		bento::Vector3 minBound, maxBound;
+		geometry_world_bounds(scene.geometryArray[geometryIdx], minBound, maxBound);
+		bento::Vector3& previousMin = cache.geometryMinArray[geometryIdx];
+		bento::Vector3& previousMax = cache.geometryMaxArray[geometryIdx];
+
+		TGeometryChange change;
+		change.epoch = ++cache.currentEpoch;
+		change.minBound = { fminf(minBound.x, previousMin.x), fminf(minBound.y, previousMin.y), fminf(minBound.z, previousMin.z) };
+		change.maxBound = { fmaxf(maxBound.x, previousMax.x), fmaxf(maxBound.y, previousMax.y), fmaxf(maxBound.z, previousMax.z) };
+		cache.changeArray.push_back(change);
+		previousMin = minBound;
+		previousMax = maxBound;
+	}
+
+	static inline int32_t quantize(float value, float invQuantum)
+	{
+		// Without quantum the bits of the value are the key
+		if (invQuantum == 0.0f)
+		{
+			int32_t bits;
+			memcpy(&bits, &value, sizeof(float));
+			return bits;
+		}
+		float scaled = value * invQuantum;
+		scaled = scaled < -1073741824.0f ? -1073741824.0f : (scaled > 1073741824.0f ? 1073741824.0f : scaled);
+		return (int32_t)floorf(scaled + 0.5f);
+	}
+
+	static inline void ray_key(const TRay& ray, float invQuantum, int32_t* key)
+	{
+		key[0] = quantize(ray.origin.x, invQuantum);
+		key[1] = quantize(ray.origin.y, invQuantum);
+		key[2] = quantize(ray.origin.z, invQuantum);
+		key[3] = quantize(ray.direction.x, invQuantum);
+		key[4] = quantize(ray.direction.y, invQuantum);
+		key[5] = quantize(ray.direction.z, invQuantum);
+		key[6] = quantize(ray.tmin, invQuantum);
+		key[7] = quantize(ray.tmax, invQuantum);
+		key[8] = (int32_t)ray.mask;
+	}
+
+	static inline uint32_t key_hash(const int32_t* key)
+	{
+		uint32_t hash = 2166136261u;
+		for (uint32_t keyIdx = 0; keyIdx < 9; ++keyIdx)
+			hash = (hash ^ (uint32_t)key[keyIdx]) * 16777619u;
+		return hash ^ (hash >> 15);
+	}
+
+	// Does the segment [tmin, tmax] of the ray cross the box
+	static inline bool segment_overlaps(const TRay& ray, float tmax, const bento::Vector3& minBound, const bento::Vector3& maxBound)
+	{
+		float tNear = ray.tmin, tFar = tmax;
+		const float* origin = &ray.origin.x;
+		const float* direction = &ray.direction.x;
+		const float* boxMin = &minBound.x;
+		const float* boxMax = &maxBound.x;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			// Parallel rays only overlap if they start inside the slab
+			if (direction[axis] == 0.0f)
+			{
+				if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+					return false;
+				continue;
+			}
+			float invDirection = 1.0f / direction[axis];
+			float t0 = (boxMin[axis] - origin[axis]) * invDirection;
+			float t1 = (boxMax[axis] - origin[axis]) * invDirection;
+			tNear = fmaxf(tNear, fminf(t0, t1));
+			tFar = fminf(tFar, fmaxf(t0, t1));
+		}
+		return tNear <= tFar;
+	}
+
+	static bool entry_valid(const TResultCache& cache, const TResultCacheEntry& entry, const TRay& ray)
+	{
+		if (entry.epoch < cache.minValidEpoch)
+			return false;
+
+		// Only the part of the ray in front of the hit decides the result
+		float tmax = entry.intersection.validity ? entry.intersection.t : ray.tmax;
+		for (int32_t changeIdx = (int32_t)cache.changeArray.size() - 1; changeIdx >= 0; --changeIdx)
+		{
+			const TGeometryChange& change = cache.changeArray[changeIdx];
+			if (change.epoch <= entry.epoch)
+				break;
+			if (segment_overlaps(ray, tmax, change.minBound, change.maxBound))
+				return false;
+		}
+		return true;
+	}
+
+	uint32_t lookup_cached_results(TResultCache& cache, const TRay* rayArray, uint32_t numRays, TIntersection* intersectionArray)
+	{
+		cache.missIndexArray.resize(numRays);
+		cache.missRayArray.resize(numRays);
+		float invQuantum = cache.quantum > 0.0f ? 1.0f / cache.quantum : 0.0f;
+		uint32_t slotMask = cache.entryArray.size() - 1;
+
+		uint32_t numMisses = 0;
+		for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+		{
+			const TRay& ray = rayArray[rayIdx];
+			int32_t key[9];
+			ray_key(ray, invQuantum, key);
+			uint32_t homeSlot = key_hash(key);
+
+			bool found = false;
+			for (uint32_t probeIdx = 0; probeIdx < RCU_RESULT_CACHE_PROBES && !found; ++probeIdx)
+			{
+				const TResultCacheEntry& entry = cache.entryArray[(homeSlot + probeIdx) & slotMask];
+				if (entry.epoch == 0 || memcmp(entry.key, key, sizeof(key)) != 0)
+					continue;
+				if (entry_valid(cache, entry, ray))
+				{
+					intersectionArray[rayIdx] = entry.intersection;
+					found = true;
+				}
+				break;
+			}
+
+			if (!found)
+			{
+				cache.missIndexArray[numMisses] = rayIdx;
+				cache.missRayArray[numMisses] = ray;
+				numMisses++;
+			}
+		}
+		cache.missIndexArray.resize(numMisses);
+		cache.missRayArray.resize(numMisses);
+		cache.missIntersectionArray.resize(numMisses);
+		return numMisses;
+	}
+
+	void store_cached_results(TResultCache& cache, TIntersection* intersectionArray)
+	{
+		float invQuantum = cache.quantum > 0.0f ? 1.0f / cache.quantum : 0.0f;
+		uint32_t slotMask = cache.entryArray.size() - 1;
+
+		uint32_t numMisses = cache.missIndexArray.size();
+		for (uint32_t missIdx = 0; missIdx < numMisses; ++missIdx)
+		{
+			const TIntersection& intersection = cache.missIntersectionArray[missIdx];
+			intersectionArray[cache.missIndexArray[missIdx]] = intersection;
+
+			int32_t key[9];
+			ray_key(cache.missRayArray[missIdx], invQuantum, key);
+			uint32_t homeSlot = key_hash(key);
+
+			// Reuse the slot of the key, else an empty one, else evict the oldest of the probed slots
+			TResultCacheEntry* target = nullptr;
+			for (uint32_t probeIdx = 0; probeIdx < RCU_RESULT_CACHE_PROBES; ++probeIdx)
+			{
+				TResultCacheEntry& entry = cache.entryArray[(homeSlot + probeIdx) & slotMask];
+				if (entry.epoch != 0 && memcmp(entry.key, key, sizeof(key)) == 0)
+				{
+					target = &entry;
+					break;
+				}
+				if (target == nullptr || (target->epoch != 0 && entry.epoch < target->epoch))
+					target = &entry;
+			}
+
+			memcpy(target->key, key, sizeof(key));
+			target->epoch = cache.currentEpoch;
+			target->intersection = intersection;
+		}
+	}
+}
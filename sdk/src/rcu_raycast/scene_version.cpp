@@ -0,0 +1,695 @@
+// sdk includes
+#include "rcu_raycast/scene_version.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+#include <bento_math/vector2.h>
+#include <bento_base/security.h>
+
+// External includes
+#include <algorithm>
+#include <float.h>
+
+namespace rcu
+{
+	static bool progress_monitor(void* ptr, double n)
+	{
+		TSceneVersion* version = (TSceneVersion*)ptr;
+		version->progress.store((float)n / version->numBuildStages);
+
+		// Returning false makes embree abort the build
+		return !version->cancelRequested.load();
+	}
+
+	// Monitor of the bakes that follow the embree commit, stage 0 being the commit itself
+	struct TBakeStage
+	{
+		TSceneVersion* version;
+		uint32_t stageIdx;
+	};
+
+	static bool bake_monitor(void* ptr, float n)
+	{
+		TBakeStage* stage = (TBakeStage*)ptr;
+		stage->version->progress.store((stage->stageIdx + n) / stage->version->numBuildStages);
+		return !stage->version->cancelRequested.load();
+	}
+
+	// Used when embree was built without ray mask support, rejects the hits that the ray mask filters out
+	static void layer_mask_filter(const RTCFilterFunctionNArguments* args)
+	{
+		const TGeometry* geometry = (const TGeometry*)args->geometryUserPtr;
+		for (uint32_t laneIdx = 0; laneIdx < args->N; ++laneIdx)
+		{
+			if (args->valid[laneIdx] != 0 && (RTCRayN_mask(args->ray, args->N, laneIdx) & geometry->layerMask) == 0)
+				args->valid[laneIdx] = 0;
+		}
+	}
+
+	static void set_layer_mask(RTCGeometry geometry, const TGeometry& sourceGeometry, bool nativeRayMask)
+	{
+		rtcSetGeometryUserData(geometry, (void*)&sourceGeometry);
+		if (nativeRayMask)
+		{
+			rtcSetGeometryMask(geometry, sourceGeometry.layerMask);
+		}
+		else if (sourceGeometry.layerMask != 0xffffffff)
+		{
+			rtcSetGeometryIntersectFilterFunction(geometry, layer_mask_filter);
+			rtcSetGeometryOccludedFilterFunction(geometry, layer_mask_filter);
+		}
+	}
+
+	// Geometry that can be merged, sorted by layer mask then along a morton curve
+	struct TMergeCandidate
+	{
+		uint64_t key;
+		uint32_t geometryIdx;
+		bento::Vector3 center;
+	};
+
+	// Spreads the 10 bits of a coordinate over 30 bits
+	static inline uint32_t spread_bits(uint32_t value)
+	{
+		value = (value | (value << 16)) & 0x030000ff;
+		value = (value | (value << 8)) & 0x0300f00f;
+		value = (value | (value << 4)) & 0x030c30c3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	// Creates the embree geometry of a batch and attaches it at the slot of its first geometry
+	static void attach_batch(RTCDevice device, TSceneVersion& version, bool nativeRayMask, const TMergeCandidate* memberArray, uint32_t numMembers, uint32_t mergedOffset)
+	{
+		const TScene& scene = *version.targetScene;
+		uint32_t numVerts = 0;
+		uint32_t numTriangles = 0;
+		for (uint32_t memberIdx = 0; memberIdx < numMembers; ++memberIdx)
+		{
+			const TGeometry& geometry = scene.geometryArray[memberArray[memberIdx].geometryIdx];
+			numVerts += geometry.vertexArray.size();
+			numTriangles += geometry.indexArray.size();
+		}
+
+		// Concatenate the members, their triangles are remapped to the source ones
+		RTCGeometry batchGeo = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_TRIANGLE);
+		bento::Vector3* vertices = (bento::Vector3*)rtcSetNewGeometryBuffer(batchGeo, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, sizeof(bento::Vector3), numVerts);
+		bento::IVector3* triangles = (bento::IVector3*)rtcSetNewGeometryBuffer(batchGeo, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, sizeof(bento::IVector3), numTriangles);
+		TMergedTriangle* remap = version.mergedTriangleArray.begin() + mergedOffset;
+		uint32_t vertexOffset = 0;
+		for (uint32_t memberIdx = 0; memberIdx < numMembers; ++memberIdx)
+		{
+			uint32_t geometryIdx = memberArray[memberIdx].geometryIdx;
+			const TGeometry& geometry = scene.geometryArray[geometryIdx];
+			memcpy(vertices + vertexOffset, geometry.vertexArray.begin(), sizeof(bento::Vector3) * geometry.vertexArray.size());
+			uint32_t numMemberTriangles = geometry.indexArray.size();
+			for (uint32_t triIdx = 0; triIdx < numMemberTriangles; ++triIdx)
+			{
+				const bento::IVector3& triangle = geometry.indexArray[triIdx];
+				triangles->x = triangle.x + vertexOffset;
+				triangles->y = triangle.y + vertexOffset;
+				triangles->z = triangle.z + vertexOffset;
+				triangles++;
+				remap->geometryIdx = geometryIdx;
+				remap->triangleIdx = triIdx;
+				remap++;
+			}
+			vertexOffset += geometry.vertexArray.size();
+		}
+
+		// The members share the layer mask of the first one
+		uint32_t batchSlot = memberArray[0].geometryIdx;
+		set_layer_mask(batchGeo, scene.geometryArray[batchSlot], nativeRayMask);
+		rtcCommitGeometry(batchGeo);
+		rtcAttachGeometryByID(version.scene, batchGeo, batchSlot);
+		rtcReleaseGeometry(batchGeo);
+		version.mergedOffsetArray[batchSlot] = mergedOffset;
+	}
+
+	// Merges the small static geometries in batches of the same layer mask. The candidates are sorted along a morton curve of their
+	// centers so that the batches stay compact. Flags the merged geometries in mergedGeometries.
+	static void build_merged_batches(RTCDevice device, TSceneVersion& version, bool nativeRayMask, uint8_t* mergedGeometries)
+	{
+		const TScene& scene = *version.targetScene;
+		uint32_t numGeometries = scene.geometryArray.size();
+
+		// Only the triangle meshes that never move and carry no custom attributes are merged
+		bento::Vector<TMergeCandidate> candidateArray(version._allocator);
+		candidateArray.resize(numGeometries);
+		uint32_t numCandidates = 0;
+		bento::Vector3 minCenter = { FLT_MAX, FLT_MAX, FLT_MAX };
+		bento::Vector3 maxCenter = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			const TGeometry& geometry = scene.geometryArray[geoIdx];
+			uint32_t numTriangles = geometry.indexArray.size();
+			if (geometry.deformable || geometry.instanced || geometry.quadTopology || geometry.numAttributeComponents > 0 || numTriangles == 0 || numTriangles > version.mergeTriangleLimit)
+				continue;
+
+			bento::Vector3 minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+			bento::Vector3 maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			uint32_t numVerts = geometry.vertexArray.size();
+			for (uint32_t vertIdx = 0; vertIdx < numVerts; ++vertIdx)
+			{
+				const bento::Vector3& vertex = geometry.vertexArray[vertIdx];
+				minBound.x = std::min(minBound.x, vertex.x);
+				minBound.y = std::min(minBound.y, vertex.y);
+				minBound.z = std::min(minBound.z, vertex.z);
+				maxBound.x = std::max(maxBound.x, vertex.x);
+				maxBound.y = std::max(maxBound.y, vertex.y);
+				maxBound.z = std::max(maxBound.z, vertex.z);
+			}
+			TMergeCandidate& candidate = candidateArray[numCandidates++];
+			candidate.geometryIdx = geoIdx;
+			candidate.center.x = (minBound.x + maxBound.x) * 0.5f;
+			candidate.center.y = (minBound.y + maxBound.y) * 0.5f;
+			candidate.center.z = (minBound.z + maxBound.z) * 0.5f;
+			minCenter.x = std::min(minCenter.x, candidate.center.x);
+			minCenter.y = std::min(minCenter.y, candidate.center.y);
+			minCenter.z = std::min(minCenter.z, candidate.center.z);
+			maxCenter.x = std::max(maxCenter.x, candidate.center.x);
+			maxCenter.y = std::max(maxCenter.y, candidate.center.y);
+			maxCenter.z = std::max(maxCenter.z, candidate.center.z);
+		}
+		if (numCandidates < 2)
+			return;
+
+		// The layer mask goes in the high bits so that a batch never mixes two masks
+		const float* minAxis = &minCenter.x;
+		const float* maxAxis = &maxCenter.x;
+		for (uint32_t candIdx = 0; candIdx < numCandidates; ++candIdx)
+		{
+			TMergeCandidate& candidate = candidateArray[candIdx];
+			const float* centerAxis = &candidate.center.x;
+			uint32_t morton = 0;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				float extent = maxAxis[axis] - minAxis[axis];
+				uint32_t cell = extent > 0.0f ? (uint32_t)((centerAxis[axis] - minAxis[axis]) / extent * 1023.0f) : 0;
+				morton |= spread_bits(cell) << axis;
+			}
+			candidate.key = ((uint64_t)scene.geometryArray[candidate.geometryIdx].layerMask << 32) | morton;
+		}
+		std::sort(candidateArray.begin(), candidateArray.begin() + numCandidates, [](const TMergeCandidate& a, const TMergeCandidate& b)
+		{
+			return a.key != b.key ? a.key < b.key : a.geometryIdx < b.geometryIdx;
+		});
+
+		// Cut the sorted candidates in batches, a geometry alone in its batch is not merged
+		bento::Vector<uint32_t> batchStartArray(version._allocator);
+		bento::Vector<uint32_t> batchSizeArray(version._allocator);
+		batchStartArray.resize(numCandidates);
+		batchSizeArray.resize(numCandidates);
+		uint32_t numBatches = 0;
+		uint32_t numMergedTriangles = 0;
+		uint32_t batchStart = 0;
+		uint32_t batchTriangles = 0;
+		for (uint32_t candIdx = 0; candIdx <= numCandidates; ++candIdx)
+		{
+			uint32_t numTriangles = candIdx < numCandidates ? scene.geometryArray[candidateArray[candIdx].geometryIdx].indexArray.size() : 0;
+			bool closeBatch = candIdx == numCandidates
+				|| (candidateArray[candIdx].key >> 32) != (candidateArray[batchStart].key >> 32)
+				|| batchTriangles + numTriangles > RCU_MERGE_BATCH_TRIANGLES;
+			if (closeBatch)
+			{
+				if (candIdx - batchStart > 1)
+				{
+					batchStartArray[numBatches] = batchStart;
+					batchSizeArray[numBatches] = candIdx - batchStart;
+					numBatches++;
+					numMergedTriangles += batchTriangles;
+				}
+				batchStart = candIdx;
+				batchTriangles = 0;
+			}
+			batchTriangles += numTriangles;
+		}
+
+		// Every slot is traced on its own unless it holds a batch
+		version.mergedOffsetArray.resize(numGeometries);
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+			version.mergedOffsetArray[geoIdx] = RCU_NOT_MERGED;
+		version.mergedTriangleArray.resize(numMergedTriangles);
+
+		uint32_t mergedOffset = 0;
+		for (uint32_t batchIdx = 0; batchIdx < numBatches; ++batchIdx)
+		{
+			const TMergeCandidate* memberArray = candidateArray.begin() + batchStartArray[batchIdx];
+			uint32_t numMembers = batchSizeArray[batchIdx];
+			attach_batch(device, version, nativeRayMask, memberArray, numMembers, mergedOffset);
+			for (uint32_t memberIdx = 0; memberIdx < numMembers; ++memberIdx)
+			{
+				mergedGeometries[memberArray[memberIdx].geometryIdx] = 1;
+				mergedOffset += scene.geometryArray[memberArray[memberIdx].geometryIdx].indexArray.size();
+			}
+		}
+	}
+
+	static void primitive_bounds_function(const RTCBoundsFunctionArguments* args)
+	{
+		const TSceneVersion* version = (const TSceneVersion*)args->geometryUserPtr;
+		bento::Vector3 minBound, maxBound;
+		primitive_bounds(version->targetScene->primitiveArray[args->primID], minBound, maxBound);
+		args->bounds_o->lower_x = minBound.x;
+		args->bounds_o->lower_y = minBound.y;
+		args->bounds_o->lower_z = minBound.z;
+		args->bounds_o->upper_x = maxBound.x;
+		args->bounds_o->upper_y = maxBound.y;
+		args->bounds_o->upper_z = maxBound.z;
+	}
+
+	// Intersects one lane of a packet with a primitive. On success the candidate hit is written in the lane of hitN and the
+	// lane's tfar is moved to the hit distance, the caller runs the filters and restores it if the hit is rejected.
+	static bool intersect_primitive_lane(const TSceneVersion& version, uint32_t primIdx, const RTCIntersectContext* context, RTCRayN* ray, RTCHitN* hitN, uint32_t N, uint32_t laneIdx)
+	{
+		const TPrimitive& primitive = version.targetScene->primitiveArray[primIdx];
+		if ((RTCRayN_mask(ray, N, laneIdx) & primitive.layerMask) == 0)
+			return false;
+
+		bento::Vector3 origin = { RTCRayN_org_x(ray, N, laneIdx), RTCRayN_org_y(ray, N, laneIdx), RTCRayN_org_z(ray, N, laneIdx) };
+		bento::Vector3 direction = { RTCRayN_dir_x(ray, N, laneIdx), RTCRayN_dir_y(ray, N, laneIdx), RTCRayN_dir_z(ray, N, laneIdx) };
+		float t, u, v;
+		uint32_t part;
+		if (!intersect_primitive(primitive, origin, direction, RTCRayN_tnear(ray, N, laneIdx), RTCRayN_tfar(ray, N, laneIdx), t, part, u, v))
+			return false;
+
+		bento::Vector3 position, normal;
+		bento::Vector2 texCoord;
+		evaluate_primitive(primitive, part, u, v, position, normal, texCoord);
+		RTCHitN_Ng_x(hitN, N, laneIdx) = normal.x;
+		RTCHitN_Ng_y(hitN, N, laneIdx) = normal.y;
+		RTCHitN_Ng_z(hitN, N, laneIdx) = normal.z;
+		RTCHitN_u(hitN, N, laneIdx) = u;
+		RTCHitN_v(hitN, N, laneIdx) = v;
+		RTCHitN_primID(hitN, N, laneIdx) = (primIdx << RCU_PRIMITIVE_PART_BITS) | part;
+		RTCHitN_geomID(hitN, N, laneIdx) = version.primitiveGeometryID;
+		RTCHitN_instID(hitN, N, laneIdx, 0) = context->instID[0];
+		RTCRayN_tfar(ray, N, laneIdx) = t;
+		return true;
+	}
+
+	static void primitive_intersect_function(const RTCIntersectFunctionNArguments* args)
+	{
+		const TSceneVersion* version = (const TSceneVersion*)args->geometryUserPtr;
+		RTCRayN* ray = RTCRayHitN_RayN(args->rayhit, args->N);
+		RTCHitN* hit = RTCRayHitN_HitN(args->rayhit, args->N);
+		RTCHitNt<16> candidateHit;
+		RTCHitN* candidate = (RTCHitN*)&candidateHit;
+		for (uint32_t laneIdx = 0; laneIdx < args->N; ++laneIdx)
+		{
+			if (args->valid[laneIdx] == 0)
+				continue;
+
+			float previousTfar = RTCRayN_tfar(ray, args->N, laneIdx);
+			if (!intersect_primitive_lane(*version, args->primID, args->context, ray, candidate, args->N, laneIdx))
+				continue;
+
+			// Give the filter functions (layer masks, multi-hit) a chance to reject the hit
+			int candidateValid[16] = {};
+			candidateValid[laneIdx] = -1;
+			RTCFilterFunctionNArguments filterArgs;
+			filterArgs.valid = candidateValid;
+			filterArgs.geometryUserPtr = args->geometryUserPtr;
+			filterArgs.context = args->context;
+			filterArgs.ray = ray;
+			filterArgs.hit = candidate;
+			filterArgs.N = args->N;
+			rtcFilterIntersection(args, &filterArgs);
+			if (candidateValid[laneIdx] == 0)
+			{
+				RTCRayN_tfar(ray, args->N, laneIdx) = previousTfar;
+				continue;
+			}
+
+			RTCHitN_Ng_x(hit, args->N, laneIdx) = RTCHitN_Ng_x(candidate, args->N, laneIdx);
+			RTCHitN_Ng_y(hit, args->N, laneIdx) = RTCHitN_Ng_y(candidate, args->N, laneIdx);
+			RTCHitN_Ng_z(hit, args->N, laneIdx) = RTCHitN_Ng_z(candidate, args->N, laneIdx);
+			RTCHitN_u(hit, args->N, laneIdx) = RTCHitN_u(candidate, args->N, laneIdx);
+			RTCHitN_v(hit, args->N, laneIdx) = RTCHitN_v(candidate, args->N, laneIdx);
+			RTCHitN_primID(hit, args->N, laneIdx) = RTCHitN_primID(candidate, args->N, laneIdx);
+			RTCHitN_geomID(hit, args->N, laneIdx) = RTCHitN_geomID(candidate, args->N, laneIdx);
+			RTCHitN_instID(hit, args->N, laneIdx, 0) = RTCHitN_instID(candidate, args->N, laneIdx, 0);
+		}
+	}
+
+	static void primitive_occluded_function(const RTCOccludedFunctionNArguments* args)
+	{
+		const TSceneVersion* version = (const TSceneVersion*)args->geometryUserPtr;
+		RTCHitNt<16> candidateHit;
+		RTCHitN* candidate = (RTCHitN*)&candidateHit;
+		for (uint32_t laneIdx = 0; laneIdx < args->N; ++laneIdx)
+		{
+			if (args->valid[laneIdx] == 0)
+				continue;
+
+			float previousTfar = RTCRayN_tfar(args->ray, args->N, laneIdx);
+			if (!intersect_primitive_lane(*version, args->primID, args->context, args->ray, candidate, args->N, laneIdx))
+				continue;
+
+			int candidateValid[16] = {};
+			candidateValid[laneIdx] = -1;
+			RTCFilterFunctionNArguments filterArgs;
+			filterArgs.valid = candidateValid;
+			filterArgs.geometryUserPtr = args->geometryUserPtr;
+			filterArgs.context = args->context;
+			filterArgs.ray = args->ray;
+			filterArgs.hit = candidate;
+			filterArgs.N = args->N;
+			rtcFilterOcclusion(args, &filterArgs);
+
+			// Occluded rays are flagged with a negative infinite tfar
+			RTCRayN_tfar(args->ray, args->N, laneIdx) = candidateValid[laneIdx] != 0 ? -INFINITY : previousTfar;
+		}
+	}
+
+	TSceneVersion::TSceneVersion(bento::IAllocator& allocator)
+	: _allocator(allocator)
+	, scene(nullptr)
+	, targetScene(nullptr)
+	, geometriesIndexes(allocator)
+	, instanceScenes(allocator)
+	, hasInstances(false)
+	, primitiveGeometryID(RTC_INVALID_GEOMETRY_ID)
+	, dirtyGeometries(allocator)
+	, refitPending(false)
+	, mergeTriangleLimit(0)
+	, mergedOffsetArray(allocator)
+	, mergedTriangleArray(allocator)
+	, contextFilter(false)
+	, buildTriangleBVH(false)
+	, triangleBVH(nullptr)
+	, occupancyVoxelSize(0.0f)
+	, occupancyBudget(0)
+	, occupancyGrid(nullptr)
+	, distanceFieldVoxelSize(0.0f)
+	, distanceFieldBudget(0)
+	, distanceField(nullptr)
+	, progress(0.0f)
+	, cancelRequested(false)
+	, numBuildStages(1)
+	{
+	}
+
+	SetupStatus::Type build_scene_version(RTCDevice device, TSceneVersion& version)
+	{
+		const TScene& scene = *version.targetScene;
+
+		// loop through the geometries
+		uint32_t numGeometries = scene.geometryArray.size();
+		version.geometriesIndexes.resize(numGeometries);
+		version.instanceScenes.resize(numGeometries);
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+			version.instanceScenes[geoIdx] = nullptr;
+		version.dirtyGeometries.resize(numGeometries);
+		memset(version.dirtyGeometries.begin(), 0, numGeometries);
+		version.refitPending = false;
+
+		// Layer masks are rejected during traversal, either natively or through a filter function
+		bool nativeRayMask = rtcGetDeviceProperty(device, RTC_DEVICE_PROPERTY_RAY_MASK_SUPPORTED) != 0;
+
+		// Create a new scene
+		version.scene = rtcNewScene(device);
+		// Geometries that change after the setup need the dynamic scene so that a commit only updates them
+		bool hasDynamic = false;
+		version.hasInstances = false;
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			hasDynamic |= scene.geometryArray[geoIdx].deformable || scene.geometryArray[geoIdx].instanced;
+			version.hasInstances |= scene.geometryArray[geoIdx].instanced;
+		}
+		// The context filter flag slows down every traversal, only the versions that serve multi-hit queries pay for it
+		RTCSceneFlags filterFlag = version.contextFilter ? RTC_SCENE_FLAG_CONTEXT_FILTER_FUNCTION : RTC_SCENE_FLAG_NONE;
+		rtcSetSceneFlags(version.scene, hasDynamic ? (filterFlag | RTC_SCENE_FLAG_DYNAMIC) : filterFlag);
+		rtcSetSceneProgressMonitorFunction(version.scene, progress_monitor, &version);
+		version.numBuildStages = 1 + (version.buildTriangleBVH ? 1 : 0) + (version.occupancyVoxelSize > 0.0f ? 1 : 0) + (version.distanceFieldVoxelSize > 0.0f ? 1 : 0);
+
+		// The merged geometries are traced through their batch
+		bento::Vector<uint8_t> mergedGeometries(version._allocator);
+		mergedGeometries.resize(numGeometries);
+		memset(mergedGeometries.begin(), 0, numGeometries);
+		version.mergedOffsetArray.clear();
+		version.mergedTriangleArray.clear();
+		if (version.mergeTriangleLimit > 0)
+			build_merged_batches(device, version, nativeRayMask, mergedGeometries.begin());
+
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			// Bail out early if the build was cancelled while creating the geometries
+			if (version.cancelRequested.load())
+				return SetupStatus::Cancelled;
+
+			if (mergedGeometries[geoIdx])
+			{
+				version.geometriesIndexes[geoIdx] = RTC_INVALID_GEOMETRY_ID;
+				continue;
+			}
+
+			// Fetch the current geometry
+			const TGeometry& currentGeometry = scene.geometryArray[geoIdx];
+
+			// Create a new geometry
+			RTCGeometry newGeo = rtcNewGeometry(device, currentGeometry.quadTopology ? RTC_GEOMETRY_TYPE_QUAD : RTC_GEOMETRY_TYPE_TRIANGLE);
+
+			// Upload the positions
+			bento::Vector3* vertices = (bento::Vector3*)rtcSetNewGeometryBuffer(newGeo, RTC_BUFFER_TYPE_VERTEX, 0, RTC_FORMAT_FLOAT3, sizeof(bento::Vector3), currentGeometry.vertexArray.size());
+			memcpy(vertices, currentGeometry.vertexArray.begin(), sizeof(bento::Vector3) * currentGeometry.vertexArray.size());
+
+			if (currentGeometry.quadTopology)
+			{
+				// Rebuild the quads from the pairs of triangles
+				uint32_t numQuads = currentGeometry.indexArray.size() / 2;
+				uint32_t* quads = (uint32_t*)rtcSetNewGeometryBuffer(newGeo, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT4, 4 * sizeof(uint32_t), numQuads);
+				for (uint32_t quadIdx = 0; quadIdx < numQuads; ++quadIdx)
+				{
+					const bento::IVector3& first = currentGeometry.indexArray[2 * quadIdx];
+					const bento::IVector3& second = currentGeometry.indexArray[2 * quadIdx + 1];
+					quads[4 * quadIdx] = first.x;
+					quads[4 * quadIdx + 1] = first.y;
+					quads[4 * quadIdx + 2] = second.x;
+					quads[4 * quadIdx + 3] = first.z;
+				}
+			}
+			else
+			{
+				// Upload the triangles
+				bento::IVector3* triangles = (bento::IVector3*)rtcSetNewGeometryBuffer(newGeo, RTC_BUFFER_TYPE_INDEX, 0, RTC_FORMAT_UINT3, sizeof(bento::IVector3), currentGeometry.indexArray.size());
+				memcpy(triangles, currentGeometry.indexArray.begin(), sizeof(bento::IVector3) * currentGeometry.indexArray.size());
+			}
+
+			// Vertex updates of deformable geometries only refit their hierarchy
+			if (currentGeometry.deformable)
+				rtcSetGeometryBuildQuality(newGeo, RTC_BUILD_QUALITY_REFIT);
+
+			// Set the layer mask
+			set_layer_mask(newGeo, currentGeometry, nativeRayMask);
+
+			// Upload the custom attributes so that they can be interpolated by embree
+			if (currentGeometry.numAttributeComponents > 0)
+			{
+				uint32_t numComponents = currentGeometry.numAttributeComponents;
+				rtcSetGeometryVertexAttributeCount(newGeo, 1);
+				float* attributes = (float*)rtcSetNewGeometryBuffer(newGeo, RTC_BUFFER_TYPE_VERTEX_ATTRIBUTE, 0, (RTCFormat)(RTC_FORMAT_FLOAT + numComponents - 1), sizeof(float) * numComponents, currentGeometry.vertexArray.size());
+				memcpy(attributes, currentGeometry.attributeArray.begin(), sizeof(float) * currentGeometry.attributeArray.size());
+			}
+
+			// Commit the geometry
+			rtcCommitGeometry(newGeo);
+
+			if (currentGeometry.instanced)
+			{
+				// The mesh lives in its own scene, only the instance is attached to the top level scene
+				RTCScene instanceScene = rtcNewScene(device);
+				rtcSetSceneFlags(instanceScene, currentGeometry.deformable ? (filterFlag | RTC_SCENE_FLAG_DYNAMIC) : filterFlag);
+				rtcAttachGeometry(instanceScene, newGeo);
+				rtcReleaseGeometry(newGeo);
+				rtcCommitScene(instanceScene);
+				version.instanceScenes[geoIdx] = instanceScene;
+
+				newGeo = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_INSTANCE);
+				rtcSetGeometryInstancedScene(newGeo, instanceScene);
+				rtcSetGeometryTransform(newGeo, 0, RTC_FORMAT_FLOAT3X4_ROW_MAJOR, currentGeometry.transform.m);
+				if (nativeRayMask)
+					rtcSetGeometryMask(newGeo, currentGeometry.layerMask);
+				rtcCommitGeometry(newGeo);
+			}
+
+			// Attach it at its slot, the slots of the merged geometries stay empty
+			rtcAttachGeometryByID(version.scene, newGeo, geoIdx);
+			version.geometriesIndexes[geoIdx] = geoIdx;
+
+			// Release the geometry
+			rtcReleaseGeometry(newGeo);
+		}
+
+		// All the analytic primitives share a user geometry that follows the meshes, the layer masks are tested in the callbacks
+		uint32_t numPrimitives = scene.primitiveArray.size();
+		if (numPrimitives > 0)
+		{
+			RTCGeometry primitiveGeo = rtcNewGeometry(device, RTC_GEOMETRY_TYPE_USER);
+			rtcSetGeometryUserPrimitiveCount(primitiveGeo, numPrimitives);
+			rtcSetGeometryUserData(primitiveGeo, &version);
+			rtcSetGeometryBoundsFunction(primitiveGeo, primitive_bounds_function, nullptr);
+			rtcSetGeometryIntersectFunction(primitiveGeo, primitive_intersect_function);
+			rtcSetGeometryOccludedFunction(primitiveGeo, primitive_occluded_function);
+			rtcCommitGeometry(primitiveGeo);
+			version.primitiveGeometryID = numGeometries;
+			rtcAttachGeometryByID(version.scene, primitiveGeo, numGeometries);
+			rtcReleaseGeometry(primitiveGeo);
+		}
+
+		// Commit the scene, the BVH build itself runs on embree's task pool
+		rtcCommitScene(version.scene);
+
+		if (version.cancelRequested.load())
+			return SetupStatus::Cancelled;
+		if (rtcGetDeviceError(device) != RTC_ERROR_NONE)
+			return SetupStatus::Failed;
+
+		// Build our own hierarchy for the queries embree does not support
+		TBakeStage stage = { &version, 1 };
+		if (version.buildTriangleBVH)
+		{
+			version.triangleBVH = bento::make_new<TTriangleBVH>(version._allocator, version._allocator);
+			build_triangle_bvh(scene, *version.triangleBVH);
+			if (!bake_monitor(&stage, 1.0f))
+				return SetupStatus::Cancelled;
+			stage.stageIdx++;
+		}
+
+		// Bake the occupancy of the static content, dropped if it can't help
+		if (version.occupancyVoxelSize > 0.0f)
+		{
+			version.occupancyGrid = bento::make_new<TOccupancyGrid>(version._allocator, version._allocator);
+			if (!build_occupancy_grid(scene, version.occupancyVoxelSize, version.occupancyBudget, *version.occupancyGrid, bake_monitor, &stage))
+			{
+				bento::make_delete<TOccupancyGrid>(version._allocator, version.occupancyGrid);
+				version.occupancyGrid = nullptr;
+			}
+			if (!bake_monitor(&stage, 1.0f))
+				return SetupStatus::Cancelled;
+			stage.stageIdx++;
+		}
+
+		// Bake the distance field from the triangle hierarchy, a temporary one is built if the spatial queries are disabled
+		if (version.distanceFieldVoxelSize > 0.0f)
+		{
+			TTriangleBVH* bvh = version.triangleBVH != nullptr ? version.triangleBVH : bento::make_new<TTriangleBVH>(version._allocator, version._allocator);
+			if (bvh != version.triangleBVH)
+				build_triangle_bvh(scene, *bvh);
+			version.distanceField = bento::make_new<TDistanceField>(version._allocator, version._allocator);
+			if (!build_distance_field(scene, *bvh, version.distanceFieldVoxelSize, version.distanceFieldBudget, *version.distanceField, bake_monitor, &stage))
+			{
+				bento::make_delete<TDistanceField>(version._allocator, version.distanceField);
+				version.distanceField = nullptr;
+			}
+			if (bvh != version.triangleBVH)
+				bento::make_delete<TTriangleBVH>(version._allocator, bvh);
+			if (!bake_monitor(&stage, 1.0f))
+				return SetupStatus::Cancelled;
+		}
+
+		version.progress.store(1.0f);
+		return SetupStatus::Ready;
+	}
+
+	void update_version_geometry(TSceneVersion& version, uint32_t geometryIdx)
+	{
+		const TGeometry& geometry = version.targetScene->geometryArray[geometryIdx];
+		assert_msg(geometry.deformable, "The geometry was not flagged as deformable");
+
+		// Overwrite the vertex buffer in place, the topology does not change
+		RTCGeometry targetGeo = mesh_geometry(version, geometryIdx);
+		bento::Vector3* vertices = (bento::Vector3*)rtcGetGeometryBufferData(targetGeo, RTC_BUFFER_TYPE_VERTEX, 0);
+		memcpy(vertices, geometry.vertexArray.begin(), sizeof(bento::Vector3) * geometry.vertexArray.size());
+		rtcUpdateGeometryBuffer(targetGeo, RTC_BUFFER_TYPE_VERTEX, 0);
+		rtcCommitGeometry(targetGeo);
+
+		version.dirtyGeometries[geometryIdx] = 1;
+		version.refitPending = true;
+	}
+
+	void update_version_transform(TSceneVersion& version, uint32_t geometryIdx)
+	{
+		const TGeometry& geometry = version.targetScene->geometryArray[geometryIdx];
+		assert_msg(geometry.instanced, "The geometry is not instanced");
+
+		// Only the instance changes, the child scene is untouched
+		RTCGeometry instanceGeo = rtcGetGeometry(version.scene, version.geometriesIndexes[geometryIdx]);
+		rtcSetGeometryTransform(instanceGeo, 0, RTC_FORMAT_FLOAT3X4_ROW_MAJOR, geometry.transform.m);
+		rtcCommitGeometry(instanceGeo);
+
+		version.dirtyGeometries[geometryIdx] = 1;
+		version.refitPending = true;
+	}
+
+	void refit_scene_version(TSceneVersion& version)
+	{
+		if (!version.refitPending)
+			return;
+
+		// Child scenes first, the instances depend on their bounds
+		uint32_t numGeometries = version.dirtyGeometries.size();
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			if (version.dirtyGeometries[geoIdx] && version.instanceScenes[geoIdx] != nullptr)
+				rtcCommitScene(version.instanceScenes[geoIdx]);
+		}
+		rtcCommitScene(version.scene);
+		if (version.triangleBVH != nullptr)
+			refit_triangle_bvh(*version.targetScene, version.dirtyGeometries.begin(), *version.triangleBVH);
+		if (version.occupancyGrid != nullptr)
+			refit_occupancy_grid(*version.targetScene, version.dirtyGeometries.begin(), *version.occupancyGrid);
+
+		// The distance field is resampled from the refit hierarchy, a temporary one is built if the spatial queries are disabled
+		if (version.distanceField != nullptr)
+		{
+			TTriangleBVH* bvh = version.triangleBVH != nullptr ? version.triangleBVH : bento::make_new<TTriangleBVH>(version._allocator, version._allocator);
+			if (bvh != version.triangleBVH)
+				build_triangle_bvh(*version.targetScene, *bvh);
+			refit_distance_field(*version.targetScene, *bvh, version.dirtyGeometries.begin(), *version.distanceField);
+			if (bvh != version.triangleBVH)
+				bento::make_delete<TTriangleBVH>(version._allocator, bvh);
+		}
+
+		memset(version.dirtyGeometries.begin(), 0, version.dirtyGeometries.size());
+		version.refitPending = false;
+	}
+
+	RTCGeometry mesh_geometry(const TSceneVersion& version, uint32_t geometryIdx)
+	{
+		if (version.instanceScenes[geometryIdx] != nullptr)
+			return rtcGetGeometry(version.instanceScenes[geometryIdx], 0);
+		return rtcGetGeometry(version.scene, version.geometriesIndexes[geometryIdx]);
+	}
+
+	void release_scene_version(TSceneVersion& version)
+	{
+		uint32_t numInstanceScenes = version.instanceScenes.size();
+		for (uint32_t geoIdx = 0; geoIdx < numInstanceScenes; ++geoIdx)
+		{
+			if (version.instanceScenes[geoIdx] != nullptr)
+				rtcReleaseScene(version.instanceScenes[geoIdx]);
+		}
+		version.instanceScenes.clear();
+		if (version.scene != nullptr)
+		{
+			rtcReleaseScene(version.scene);
+			version.scene = nullptr;
+		}
+		if (version.triangleBVH != nullptr)
+		{
+			bento::make_delete<TTriangleBVH>(version._allocator, version.triangleBVH);
+			version.triangleBVH = nullptr;
+		}
+		if (version.occupancyGrid != nullptr)
+		{
+			bento::make_delete<TOccupancyGrid>(version._allocator, version.occupancyGrid);
+			version.occupancyGrid = nullptr;
+		}
+		if (version.distanceField != nullptr)
+		{
+			bento::make_delete<TDistanceField>(version._allocator, version.distanceField);
+			version.distanceField = nullptr;
+		}
+	}
+}
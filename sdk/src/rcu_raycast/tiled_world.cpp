@@ -0,0 +1,545 @@
+// sdk includes
+#include "rcu_raycast/tiled_world.h"
+#include "rcu_model/tile_cache.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+
+// External includes
+#include <math.h>
+#include <string.h>
+
+namespace rcu
+{
+	TWorldTile::TWorldTile(bento::IAllocator& allocator)
+	: minBound({0.0f, 0.0f, 0.0f})
+	, maxBound({0.0f, 0.0f, 0.0f})
+	, sourceScene(nullptr)
+	, cachePath(allocator)
+	, cachedScene(nullptr)
+	, version(nullptr)
+	, memorySize(0)
+	, lastUsed(0)
+	, evictRequested(false)
+	, status(TileStatus::Unloaded)
+	{
+	}
+
+	TTiledWorld::TTiledWorld(bento::IAllocator& allocator)
+	: _allocator(allocator)
+	, device(nullptr)
+	, tileArray(allocator)
+	, memoryBudget(0)
+	, residentMemory(0)
+	, useCounter(0)
+	, scene(nullptr)
+	, topLevelDirty(false)
+	, instanceTileArray(allocator)
+	, proxyGeometryID(RTC_INVALID_GEOMETRY_ID)
+	, proxyTileArray(allocator)
+	, numQueued(0)
+	, stopLoader(false)
+	, rayHitGroupArray(allocator)
+	{
+	}
+
+	// Memory of the data the tile owns plus the estimated size of its embree scene
+	static uint64_t tile_memory(const TWorldTile& tile, const TScene& scene)
+	{
+		uint64_t memorySize = 0;
+		uint32_t numGeometries = scene.geometryArray.size();
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			const TGeometry& geometry = scene.geometryArray[geoIdx];
+			uint64_t numVerts = geometry.vertexArray.size();
+			uint64_t numTriangles = geometry.indexArray.size();
+			memorySize += (sizeof(bento::Vector3) + sizeof(float) * geometry.numAttributeComponents) * numVerts + (sizeof(bento::IVector3) + RCU_WORLD_BVH_BYTES_PER_TRIANGLE) * numTriangles;
+			if (tile.cachedScene != nullptr)
+			{
+				// A packed vertex keeps its normal and uv in a uint32_t each
+				uint64_t vertexSize = geometry.packedAttributes ? sizeof(bento::Vector3) + 2 * sizeof(uint32_t) : 2 * sizeof(bento::Vector3) + sizeof(bento::Vector2);
+				memorySize += (vertexSize + sizeof(float) * geometry.numAttributeComponents) * numVerts + sizeof(bento::IVector3) * numTriangles;
+			}
+		}
+		memorySize += (sizeof(TPrimitive) + RCU_WORLD_BVH_BYTES_PER_TRIANGLE) * (uint64_t)scene.primitiveArray.size();
+		return memorySize;
+	}
+
+	// Releases the scene and the cached data of a tile, the tile must not be referenced by the top level scene anymore
+	static void release_tile_content(TTiledWorld& world, TWorldTile& tile)
+	{
+		if (tile.version != nullptr)
+		{
+			release_scene_version(*tile.version);
+			bento::make_delete<TSceneVersion>(world._allocator, tile.version);
+			tile.version = nullptr;
+		}
+		if (tile.cachedScene != nullptr)
+		{
+			bento::make_delete<TScene>(world._allocator, tile.cachedScene);
+			tile.cachedScene = nullptr;
+		}
+		tile.memorySize = 0;
+	}
+
+	// Reads and builds a tile on the loader thread
+	static bool load_tile(TTiledWorld& world, TWorldTile& tile)
+	{
+		const TScene* scene = tile.sourceScene;
+		if (scene == nullptr && tile.cachePath.size() == 0)
+			return false;
+		if (scene == nullptr)
+		{
+			tile.cachedScene = bento::make_new<TScene>(world._allocator, world._allocator);
+			if (!read_tile_cache(tile.cachePath.begin(), *tile.cachedScene))
+				return false;
+			scene = tile.cachedScene;
+		}
+
+		// The tiles are already instanced in the top level scene and embree only traces one level of instances
+		uint32_t numGeometries = scene->geometryArray.size();
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			if (scene->geometryArray[geoIdx].instanced)
+				return false;
+		}
+
+		tile.version = bento::make_new<TSceneVersion>(world._allocator, world._allocator);
+		tile.version->targetScene = scene;
+		if (build_scene_version(world.device, *tile.version) != SetupStatus::Ready)
+			return false;
+		tile.memorySize = tile_memory(tile, *scene);
+		return true;
+	}
+
+	static void loader_loop(TTiledWorld* world)
+	{
+		std::unique_lock<std::mutex> lock(world->tileMutex);
+		while (true)
+		{
+			world->loaderCondition.wait(lock, [world]() { return world->stopLoader || world->numQueued > 0; });
+			if (world->stopLoader)
+				return;
+
+			// Serve the most recent request first
+			TWorldTile* nextTile = nullptr;
+			uint32_t numTiles = world->tileArray.size();
+			for (uint32_t tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+			{
+				TWorldTile* tile = world->tileArray[tileIdx];
+				if (tile->status.load() == TileStatus::Queued && (nextTile == nullptr || tile->lastUsed > nextTile->lastUsed))
+					nextTile = tile;
+			}
+			if (nextTile == nullptr)
+			{
+				world->numQueued = 0;
+				continue;
+			}
+			nextTile->status.store(TileStatus::Loading);
+			world->numQueued--;
+
+			// The tile is only touched by this thread while it is loading
+			lock.unlock();
+			bool loaded = load_tile(*world, *nextTile);
+			if (!loaded)
+				release_tile_content(*world, *nextTile);
+			lock.lock();
+			nextTile->status.store(loaded ? TileStatus::Loaded : TileStatus::Failed);
+		}
+	}
+
+	void reset_tiled_world(TTiledWorld& world, RTCDevice device, uint64_t memoryBudget)
+	{
+		release_tiled_world(world);
+		world.device = device;
+		world.memoryBudget = memoryBudget;
+	}
+
+	void release_tiled_world(TTiledWorld& world)
+	{
+		if (world.loaderThread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(world.tileMutex);
+				world.stopLoader = true;
+			}
+			world.loaderCondition.notify_one();
+			world.loaderThread.join();
+		}
+		world.stopLoader = false;
+		world.numQueued = 0;
+
+		if (world.scene != nullptr)
+		{
+			rtcReleaseScene(world.scene);
+			world.scene = nullptr;
+		}
+		uint32_t numTiles = world.tileArray.size();
+		for (uint32_t tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+		{
+			release_tile_content(world, *world.tileArray[tileIdx]);
+			bento::make_delete<TWorldTile>(world._allocator, world.tileArray[tileIdx]);
+		}
+		world.tileArray.clear();
+		world.instanceTileArray.clear();
+		world.proxyTileArray.clear();
+		world.proxyGeometryID = RTC_INVALID_GEOMETRY_ID;
+		world.residentMemory = 0;
+		world.useCounter = 0;
+		world.topLevelDirty = false;
+	}
+
+	uint32_t add_world_tile(TTiledWorld& world, const bento::Vector3& minBound, const bento::Vector3& maxBound, const TScene* scene, const char* cachePath)
+	{
+		TWorldTile* tile = bento::make_new<TWorldTile>(world._allocator, world._allocator);
+		tile->minBound = minBound;
+		tile->maxBound = maxBound;
+		tile->sourceScene = scene;
+		if (scene == nullptr && cachePath != nullptr)
+		{
+			uint32_t pathLength = (uint32_t)strlen(cachePath);
+			tile->cachePath.resize(pathLength + 1);
+			memcpy(tile->cachePath.begin(), cachePath, pathLength + 1);
+		}
+		else if (scene == nullptr)
+		{
+			tile->status.store(TileStatus::Failed);
+		}
+
+		std::lock_guard<std::mutex> lock(world.tileMutex);
+		world.tileArray.push_back(tile);
+		// The new tile is not resident, its bounds must stop the rays
+		world.topLevelDirty = true;
+		return world.tileArray.size() - 1;
+	}
+
+	// Marks a tile as used and queues its load if needed, tileMutex must be held
+	static void touch_tile(TTiledWorld& world, uint32_t tileIdx)
+	{
+		TWorldTile& tile = *world.tileArray[tileIdx];
+		tile.lastUsed = ++world.useCounter;
+		tile.evictRequested = false;
+		if (tile.status.load() != TileStatus::Unloaded)
+			return;
+
+		// An evicted tile stays alive until the top level scene is rebuilt, it can be brought back as is
+		if (tile.version != nullptr)
+		{
+			tile.status.store(TileStatus::Resident);
+			world.residentMemory += tile.memorySize;
+			world.topLevelDirty = true;
+			return;
+		}
+
+		tile.status.store(TileStatus::Queued);
+		world.numQueued++;
+		if (!world.loaderThread.joinable())
+			world.loaderThread = std::thread(loader_loop, &world);
+		world.loaderCondition.notify_one();
+	}
+
+	void request_world_tile(TTiledWorld& world, uint32_t tileIdx)
+	{
+		std::lock_guard<std::mutex> lock(world.tileMutex);
+		if (tileIdx >= world.tileArray.size())
+			return;
+
+		// An explicit request retries a failed tile
+		TWorldTile& tile = *world.tileArray[tileIdx];
+		if (tile.status.load() == TileStatus::Failed)
+			tile.status.store(TileStatus::Unloaded);
+		touch_tile(world, tileIdx);
+	}
+
+	void request_world_region(TTiledWorld& world, const bento::Vector3& center, float radius)
+	{
+		uint32_t numTiles = world.tileArray.size();
+		for (uint32_t tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+		{
+			// Distance from the center to the bounds of the tile
+			const TWorldTile& tile = *world.tileArray[tileIdx];
+			float dx = fmaxf(fmaxf(tile.minBound.x - center.x, center.x - tile.maxBound.x), 0.0f);
+			float dy = fmaxf(fmaxf(tile.minBound.y - center.y, center.y - tile.maxBound.y), 0.0f);
+			float dz = fmaxf(fmaxf(tile.minBound.z - center.z, center.z - tile.maxBound.z), 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= radius * radius)
+				request_world_tile(world, tileIdx);
+		}
+	}
+
+	void evict_world_tile(TTiledWorld& world, uint32_t tileIdx)
+	{
+		std::lock_guard<std::mutex> lock(world.tileMutex);
+		if (tileIdx >= world.tileArray.size())
+			return;
+
+		TWorldTile& tile = *world.tileArray[tileIdx];
+		switch (tile.status.load())
+		{
+			case TileStatus::Queued:
+				world.numQueued--;
+				tile.status.store(TileStatus::Unloaded);
+				break;
+			case TileStatus::Loading:
+				tile.evictRequested = true;
+				break;
+			case TileStatus::Loaded:
+				release_tile_content(world, tile);
+				tile.status.store(TileStatus::Unloaded);
+				break;
+			case TileStatus::Resident:
+				// The top level scene is rebuilt before its instance is released
+				world.residentMemory -= tile.memorySize;
+				tile.status.store(TileStatus::Unloaded);
+				world.topLevelDirty = true;
+				break;
+			case TileStatus::Failed:
+				// Its content was already released, it still stops the rays as an unloaded tile
+				tile.status.store(TileStatus::Unloaded);
+				break;
+			default:
+				break;
+		}
+	}
+
+	static void proxy_bounds_function(const RTCBoundsFunctionArguments* args)
+	{
+		const TTiledWorld* world = (const TTiledWorld*)args->geometryUserPtr;
+		const TWorldTile& tile = *world->tileArray[world->proxyTileArray[args->primID]];
+		args->bounds_o->lower_x = tile.minBound.x;
+		args->bounds_o->lower_y = tile.minBound.y;
+		args->bounds_o->lower_z = tile.minBound.z;
+		args->bounds_o->upper_x = tile.maxBound.x;
+		args->bounds_o->upper_y = tile.maxBound.y;
+		args->bounds_o->upper_z = tile.maxBound.z;
+	}
+
+	// The rays stop where they enter the bounds of a tile that is not resident, including the failed ones
+	static void proxy_intersect_function(const RTCIntersectFunctionNArguments* args)
+	{
+		const TTiledWorld* world = (const TTiledWorld*)args->geometryUserPtr;
+		const TWorldTile& tile = *world->tileArray[world->proxyTileArray[args->primID]];
+		RTCRayN* ray = RTCRayHitN_RayN(args->rayhit, args->N);
+		RTCHitN* hit = RTCRayHitN_HitN(args->rayhit, args->N);
+		const float* boxMin = &tile.minBound.x;
+		const float* boxMax = &tile.maxBound.x;
+		for (uint32_t laneIdx = 0; laneIdx < args->N; ++laneIdx)
+		{
+			if (args->valid[laneIdx] == 0)
+				continue;
+
+			float origin[3] = { RTCRayN_org_x(ray, args->N, laneIdx), RTCRayN_org_y(ray, args->N, laneIdx), RTCRayN_org_z(ray, args->N, laneIdx) };
+			float direction[3] = { RTCRayN_dir_x(ray, args->N, laneIdx), RTCRayN_dir_y(ray, args->N, laneIdx), RTCRayN_dir_z(ray, args->N, laneIdx) };
+			float tNear = RTCRayN_tnear(ray, args->N, laneIdx);
+			float tFar = RTCRayN_tfar(ray, args->N, laneIdx);
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				float invDirection = 1.0f / direction[axis];
+				float t0 = (boxMin[axis] - origin[axis]) * invDirection;
+				float t1 = (boxMax[axis] - origin[axis]) * invDirection;
+				tNear = fmaxf(tNear, fminf(t0, t1));
+				tFar = fminf(tFar, fmaxf(t0, t1));
+			}
+			if (!(tNear <= tFar))
+				continue;
+
+			RTCHitN_Ng_x(hit, args->N, laneIdx) = 0.0f;
+			RTCHitN_Ng_y(hit, args->N, laneIdx) = 0.0f;
+			RTCHitN_Ng_z(hit, args->N, laneIdx) = 0.0f;
+			RTCHitN_u(hit, args->N, laneIdx) = 0.0f;
+			RTCHitN_v(hit, args->N, laneIdx) = 0.0f;
+			RTCHitN_primID(hit, args->N, laneIdx) = args->primID;
+			RTCHitN_geomID(hit, args->N, laneIdx) = world->proxyGeometryID;
+			RTCHitN_instID(hit, args->N, laneIdx, 0) = args->context->instID[0];
+			RTCRayN_tfar(ray, args->N, laneIdx) = tNear;
+		}
+	}
+
+	// Instances the resident tiles and gathers the bounds of the other ones in a single user geometry
+	static void rebuild_top_level(TTiledWorld& world)
+	{
+		RTCScene previousScene = world.scene;
+		world.scene = rtcNewScene(world.device);
+		world.instanceTileArray.clear();
+		world.proxyTileArray.clear();
+		world.proxyGeometryID = RTC_INVALID_GEOMETRY_ID;
+		bool nativeRayMask = rtcGetDeviceProperty(world.device, RTC_DEVICE_PROPERTY_RAY_MASK_SUPPORTED) != 0;
+
+		uint32_t numTiles = world.tileArray.size();
+		for (uint32_t tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+		{
+			const TWorldTile& tile = *world.tileArray[tileIdx];
+			if (tile.status.load() != TileStatus::Resident)
+			{
+				world.proxyTileArray.push_back(tileIdx);
+				continue;
+			}
+
+			// The tiles are in world space, the instances only exist to share the top level hierarchy
+			RTCGeometry instanceGeo = rtcNewGeometry(world.device, RTC_GEOMETRY_TYPE_INSTANCE);
+			rtcSetGeometryInstancedScene(instanceGeo, tile.version->scene);
+			const float identity[12] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0 };
+			rtcSetGeometryTransform(instanceGeo, 0, RTC_FORMAT_FLOAT3X4_ROW_MAJOR, identity);
+			if (nativeRayMask)
+				rtcSetGeometryMask(instanceGeo, 0xffffffff);
+			rtcCommitGeometry(instanceGeo);
+			uint32_t instanceID = rtcAttachGeometry(world.scene, instanceGeo);
+			rtcReleaseGeometry(instanceGeo);
+			if (world.instanceTileArray.size() <= instanceID)
+				world.instanceTileArray.resize(instanceID + 1);
+			world.instanceTileArray[instanceID] = tileIdx;
+		}
+
+		uint32_t numProxies = world.proxyTileArray.size();
+		if (numProxies > 0)
+		{
+			RTCGeometry proxyGeo = rtcNewGeometry(world.device, RTC_GEOMETRY_TYPE_USER);
+			rtcSetGeometryUserPrimitiveCount(proxyGeo, numProxies);
+			rtcSetGeometryUserData(proxyGeo, &world);
+			rtcSetGeometryBoundsFunction(proxyGeo, proxy_bounds_function, nullptr);
+			rtcSetGeometryIntersectFunction(proxyGeo, proxy_intersect_function);
+			if (nativeRayMask)
+				rtcSetGeometryMask(proxyGeo, 0xffffffff);
+			rtcCommitGeometry(proxyGeo);
+			world.proxyGeometryID = rtcAttachGeometry(world.scene, proxyGeo);
+			rtcReleaseGeometry(proxyGeo);
+		}
+		rtcCommitScene(world.scene);
+
+		if (previousScene != nullptr)
+			rtcReleaseScene(previousScene);
+		world.topLevelDirty = false;
+	}
+
+	void update_tiled_world(TTiledWorld& world)
+	{
+		// Publish the tiles the loader is done with
+		{
+			std::lock_guard<std::mutex> lock(world.tileMutex);
+			uint32_t numTiles = world.tileArray.size();
+			for (uint32_t tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+			{
+				TWorldTile& tile = *world.tileArray[tileIdx];
+				if (tile.status.load() != TileStatus::Loaded)
+					continue;
+				if (tile.evictRequested)
+				{
+					release_tile_content(world, tile);
+					tile.evictRequested = false;
+					tile.status.store(TileStatus::Unloaded);
+					continue;
+				}
+				tile.status.store(TileStatus::Resident);
+				world.residentMemory += tile.memorySize;
+				world.topLevelDirty = true;
+			}
+
+			// Evict the least recently used tiles past the budget, the last one standing is kept
+			while (world.residentMemory > world.memoryBudget)
+			{
+				TWorldTile* oldestTile = nullptr;
+				uint32_t numResident = 0;
+				for (uint32_t tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+				{
+					TWorldTile* tile = world.tileArray[tileIdx];
+					if (tile->status.load() != TileStatus::Resident)
+						continue;
+					numResident++;
+					if (oldestTile == nullptr || tile->lastUsed < oldestTile->lastUsed)
+						oldestTile = tile;
+				}
+				if (numResident <= 1)
+					break;
+				world.residentMemory -= oldestTile->memorySize;
+				oldestTile->status.store(TileStatus::Unloaded);
+				world.topLevelDirty = true;
+			}
+		}
+
+		if (!world.topLevelDirty && world.scene != nullptr)
+			return;
+		rebuild_top_level(world);
+
+		// The evicted tiles are not referenced anymore
+		uint32_t numTiles = world.tileArray.size();
+		for (uint32_t tileIdx = 0; tileIdx < numTiles; ++tileIdx)
+		{
+			TWorldTile& tile = *world.tileArray[tileIdx];
+			if (tile.status.load() == TileStatus::Unloaded && tile.version != nullptr)
+				release_tile_content(world, tile);
+		}
+	}
+
+	void trace_tiled_world(TTiledWorld& world, const TRay* rayArray, uint32_t numRays, TWorldHit* hitArray)
+	{
+		uint32_t numRayGroups = (numRays + 15) / 16;
+		if (world.rayHitGroupArray.size() < numRayGroups)
+			world.rayHitGroupArray.resize(numRayGroups);
+
+		#pragma omp parallel for
+		for (int32_t rayGroupIndex = 0; rayGroupIndex < (int32_t)numRayGroups; ++rayGroupIndex)
+		{
+			RTCIntersectContext context;
+			rtcInitIntersectContext(&context);
+
+			RTCRayHit16& rayHitGroup = world.rayHitGroupArray[rayGroupIndex];
+			alignas(64) int valid[16];
+			uint32_t firstRay = 16 * rayGroupIndex;
+			uint32_t numLanes = numRays - firstRay < 16 ? numRays - firstRay : 16;
+			for (uint32_t rayIdx = 0; rayIdx < 16; ++rayIdx)
+			{
+				valid[rayIdx] = rayIdx < numLanes ? -1 : 0;
+				if (rayIdx >= numLanes)
+					continue;
+
+				const TRay& currentRay = rayArray[firstRay + rayIdx];
+				rayHitGroup.ray.org_x[rayIdx] = currentRay.origin.x;
+				rayHitGroup.ray.org_y[rayIdx] = currentRay.origin.y;
+				rayHitGroup.ray.org_z[rayIdx] = currentRay.origin.z;
+				rayHitGroup.ray.dir_x[rayIdx] = currentRay.direction.x;
+				rayHitGroup.ray.dir_y[rayIdx] = currentRay.direction.y;
+				rayHitGroup.ray.dir_z[rayIdx] = currentRay.direction.z;
+				rayHitGroup.ray.tnear[rayIdx] = currentRay.tmin;
+				rayHitGroup.ray.tfar[rayIdx] = currentRay.tmax;
+				rayHitGroup.ray.mask[rayIdx] = currentRay.mask;
+				rayHitGroup.ray.time[rayIdx] = 0.0f;
+				rayHitGroup.ray.id[rayIdx] = firstRay + rayIdx;
+				rayHitGroup.ray.flags[rayIdx] = 0;
+				rayHitGroup.hit.instID[0][rayIdx] = RTC_INVALID_GEOMETRY_ID;
+				rayHitGroup.hit.geomID[rayIdx] = RTC_INVALID_GEOMETRY_ID;
+			}
+			rtcIntersect16(valid, world.scene, &context, &rayHitGroup);
+
+			for (uint32_t rayIdx = 0; rayIdx < numLanes; ++rayIdx)
+			{
+				TWorldHit& hit = hitArray[firstRay + rayIdx];
+				uint32_t geomID = rayHitGroup.hit.geomID[rayIdx];
+				hit.tile = RCU_WORLD_NO_TILE;
+				hit.geomID = geomID;
+				hit.primID = rayHitGroup.hit.primID[rayIdx];
+				hit.t = rayHitGroup.ray.tfar[rayIdx];
+				hit.u = rayHitGroup.hit.u[rayIdx];
+				hit.v = rayHitGroup.hit.v[rayIdx];
+				if (geomID == RTC_INVALID_GEOMETRY_ID)
+					continue;
+				if (geomID == world.proxyGeometryID && rayHitGroup.hit.instID[0][rayIdx] == RTC_INVALID_GEOMETRY_ID)
+				{
+					uint32_t tileIdx = world.proxyTileArray[hit.primID];
+					hit.tile = tileIdx | RCU_WORLD_TILE_PENDING;
+					if (world.tileArray[tileIdx]->status.load() == TileStatus::Failed)
+						hit.tile |= RCU_WORLD_TILE_FAILED;
+				}
+				else
+					hit.tile = world.instanceTileArray[rayHitGroup.hit.instID[0][rayIdx]];
+			}
+		}
+
+		// Keep the tiles that are hit warm and fetch the ones that stopped rays, the failed ones wait for an explicit request
+		std::lock_guard<std::mutex> lock(world.tileMutex);
+		for (uint32_t rayIdx = 0; rayIdx < numRays; ++rayIdx)
+		{
+			uint32_t tile = hitArray[rayIdx].tile;
+			if (tile != RCU_WORLD_NO_TILE && (tile & RCU_WORLD_TILE_FAILED) == 0)
+				touch_tile(world, tile & ~RCU_WORLD_TILE_PENDING);
+		}
+	}
+}
@@ -0,0 +1,238 @@
+// sdk includes
+#include "rcu_raycast/visibility_grid.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+
+// External includes
+#include <math.h>
+#include <string.h>
+
+namespace rcu
+{
+	// Fraction of the segments ignored at both ends so that points lying on a surface can still see each other
+	#define RCU_PVS_SEGMENT_MARGIN 1e-4f
+
+	TVisibilityGrid::TVisibilityGrid(bento::IAllocator& allocator)
+	: origin({0.0f, 0.0f, 0.0f})
+	, cellSize({0.0f, 0.0f, 0.0f})
+	, mask(0)
+	, rowOffsetArray(allocator)
+	, stateArray(allocator)
+	, sampleArray(allocator)
+	, pendingIndexArray(allocator)
+	{
+		resolution[0] = 0;
+		resolution[1] = 0;
+		resolution[2] = 0;
+	}
+
+	static inline uint32_t hash(uint32_t value)
+	{
+		value ^= value >> 16;
+		value *= 0x7feb352du;
+		value ^= value >> 15;
+		value *= 0x846ca68bu;
+		value ^= value >> 16;
+		return value;
+	}
+
+	static inline float to_unit_float(uint32_t value)
+	{
+		return (float)(value >> 8) * (1.0f / 16777216.0f);
+	}
+
+	static inline void fill_segment(RTCRay16& rays, uint32_t laneIdx, const bento::Vector3& source, const bento::Vector3& target, uint32_t mask)
+	{
+		rays.org_x[laneIdx] = source.x;
+		rays.org_y[laneIdx] = source.y;
+		rays.org_z[laneIdx] = source.z;
+		rays.dir_x[laneIdx] = target.x - source.x;
+		rays.dir_y[laneIdx] = target.y - source.y;
+		rays.dir_z[laneIdx] = target.z - source.z;
+		rays.tnear[laneIdx] = RCU_PVS_SEGMENT_MARGIN;
+		rays.tfar[laneIdx] = 1.0f - RCU_PVS_SEGMENT_MARGIN;
+		rays.mask[laneIdx] = mask;
+		rays.time[laneIdx] = 0.0f;
+		rays.id[laneIdx] = laneIdx;
+		rays.flags[laneIdx] = 0;
+	}
+
+	// Traces the segments of the pairs (cellIdx, otherCell >= cellIdx) and accumulates their states in the row of the cell
+	static void bake_row(const TSceneVersion& version, const TVisibilityGrid& grid, uint32_t cellIdx, uint32_t numCells, uint32_t numSamples, uint32_t mask, uint32_t* row)
+	{
+		RTCIntersectContext context;
+		rtcInitIntersectContext(&context);
+
+		alignas(64) RTCRay16 rays;
+		alignas(64) int valid[16];
+		uint32_t lanePairArray[16];
+		uint32_t numLanes = 0;
+
+		const bento::Vector3* sourcePoints = grid.sampleArray.begin() + (size_t)cellIdx * numSamples;
+		for (uint32_t otherCell = cellIdx; otherCell < numCells; ++otherCell)
+		{
+			// Inside a cell the samples are connected to their neighbour
+			const bento::Vector3* targetPoints = grid.sampleArray.begin() + (size_t)otherCell * numSamples;
+			uint32_t targetShift = otherCell == cellIdx ? 1 : 0;
+			for (uint32_t sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+			{
+				fill_segment(rays, numLanes, sourcePoints[sampleIdx], targetPoints[(sampleIdx + targetShift) % numSamples], mask);
+				lanePairArray[numLanes] = otherCell - cellIdx;
+				numLanes++;
+
+				bool lastSegment = otherCell + 1 == numCells && sampleIdx + 1 == numSamples;
+				if (numLanes < 16 && !lastSegment)
+					continue;
+
+				for (uint32_t laneIdx = 0; laneIdx < 16; ++laneIdx)
+					valid[laneIdx] = laneIdx < numLanes ? -1 : 0;
+				rtcOccluded16(valid, version.scene, &context, &rays);
+
+				// Occluded rays come back with a negative infinite tfar
+				for (uint32_t laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+				{
+					uint32_t pairIdx = lanePairArray[laneIdx];
+					uint32_t state = rays.tfar[laneIdx] >= 0.0f ? CellVisibility::Visible : CellVisibility::Hidden;
+					row[pairIdx / RCU_PVS_PAIRS_PER_WORD] |= state << (2 * (pairIdx % RCU_PVS_PAIRS_PER_WORD));
+				}
+				numLanes = 0;
+			}
+		}
+	}
+
+	void bake_visibility_grid(const TSceneVersion& version, const bento::Vector3& origin, const bento::Vector3& cellSize, const uint32_t* resolution, uint32_t numSamples, uint32_t mask, TVisibilityGrid& grid)
+	{
+		clear_visibility_grid(grid);
+		uint32_t numCells = resolution[0] * resolution[1] * resolution[2];
+		if (numCells == 0 || numSamples == 0)
+			return;
+
+		grid.origin = origin;
+		grid.cellSize = cellSize;
+		grid.resolution[0] = resolution[0];
+		grid.resolution[1] = resolution[1];
+		grid.resolution[2] = resolution[2];
+		grid.mask = mask;
+
+		// The row of a cell holds its pairs with itself and the following cells
+		grid.rowOffsetArray.resize(numCells);
+		uint32_t numWords = 0;
+		for (uint32_t cellIdx = 0; cellIdx < numCells; ++cellIdx)
+		{
+			grid.rowOffsetArray[cellIdx] = numWords;
+			numWords += (numCells - cellIdx + RCU_PVS_PAIRS_PER_WORD - 1) / RCU_PVS_PAIRS_PER_WORD;
+		}
+		grid.stateArray.resize(numWords);
+		memset(grid.stateArray.begin(), 0, sizeof(uint32_t) * numWords);
+
+		// Random points of every cell, the same ones are used for all the pairs of the cell
+		grid.sampleArray.resize((size_t)numCells * numSamples);
+		for (uint32_t cellIdx = 0; cellIdx < numCells; ++cellIdx)
+		{
+			uint32_t x = cellIdx % resolution[0];
+			uint32_t y = (cellIdx / resolution[0]) % resolution[1];
+			uint32_t z = cellIdx / (resolution[0] * resolution[1]);
+			for (uint32_t sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+			{
+				size_t sampleSlot = (size_t)cellIdx * numSamples + sampleIdx;
+				uint32_t seed = hash((uint32_t)sampleSlot);
+				bento::Vector3& point = grid.sampleArray[sampleSlot];
+				point.x = origin.x + ((float)x + to_unit_float(seed)) * cellSize.x;
+				point.y = origin.y + ((float)y + to_unit_float(hash(seed ^ 0x9e3779b9u))) * cellSize.y;
+				point.z = origin.z + ((float)z + to_unit_float(hash(seed ^ 0x85ebca6bu))) * cellSize.z;
+			}
+		}
+
+		// The first rows are the longest, they are handed out first
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (int32_t cellIdx = 0; cellIdx < (int32_t)numCells; ++cellIdx)
+			bake_row(version, grid, cellIdx, numCells, numSamples, mask, grid.stateArray.begin() + grid.rowOffsetArray[cellIdx]);
+
+		grid.sampleArray.clear();
+	}
+
+	void clear_visibility_grid(TVisibilityGrid& grid)
+	{
+		grid.resolution[0] = 0;
+		grid.resolution[1] = 0;
+		grid.resolution[2] = 0;
+		grid.rowOffsetArray.clear();
+		grid.stateArray.clear();
+		grid.sampleArray.clear();
+	}
+
+	int32_t visibility_grid_cell(const TVisibilityGrid& grid, const bento::Vector3& point)
+	{
+		if (grid.rowOffsetArray.size() == 0)
+			return -1;
+
+		const float* position = &point.x;
+		const float* origin = &grid.origin.x;
+		const float* cellSize = &grid.cellSize.x;
+		int32_t coords[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float cell = floorf((position[axis] - origin[axis]) / cellSize[axis]);
+			if (!(cell >= 0.0f && cell < (float)grid.resolution[axis]))
+				return -1;
+			coords[axis] = (int32_t)cell;
+		}
+		return coords[0] + (int32_t)grid.resolution[0] * (coords[1] + (int32_t)grid.resolution[1] * coords[2]);
+	}
+
+	void potential_visibility(const TSceneVersion* version, TVisibilityGrid& grid, const bento::Vector3* sourceArray, const bento::Vector3* targetArray, uint32_t numPairs, uint32_t mask, uint8_t* visibleArray)
+	{
+		// The pairs of Visible cells are answered right away, the other ones are queued. A Hidden pair may still see through a gap the
+		// samples missed, so it is traced too. The states baked with another mask say nothing.
+		grid.pendingIndexArray.resize(numPairs);
+		uint32_t numPending = 0;
+		bool bakedMask = mask == grid.mask;
+		for (uint32_t pairIdx = 0; pairIdx < numPairs; ++pairIdx)
+		{
+			CellVisibility::Type state = CellVisibility::Unknown;
+			if (bakedMask)
+				state = visibility_grid_state(grid, visibility_grid_cell(grid, sourceArray[pairIdx]), visibility_grid_cell(grid, targetArray[pairIdx]));
+			if (state == CellVisibility::Visible)
+				visibleArray[pairIdx] = 1;
+			else
+				grid.pendingIndexArray[numPending++] = pairIdx;
+		}
+		grid.pendingIndexArray.resize(numPending);
+
+		// Without a scene every pair is visible
+		if (version == nullptr)
+		{
+			for (uint32_t pendingIdx = 0; pendingIdx < numPending; ++pendingIdx)
+				visibleArray[grid.pendingIndexArray[pendingIdx]] = 1;
+			return;
+		}
+
+		// The exact fallback traces the queued segments with occlusion packets
+		uint32_t numPackets = (numPending + 15) / 16;
+		#pragma omp parallel for
+		for (int32_t packetIdx = 0; packetIdx < (int32_t)numPackets; ++packetIdx)
+		{
+			RTCIntersectContext context;
+			rtcInitIntersectContext(&context);
+
+			alignas(64) RTCRay16 rays;
+			alignas(64) int valid[16];
+			uint32_t packetStart = packetIdx * 16;
+			uint32_t numLanes = numPending - packetStart < 16 ? numPending - packetStart : 16;
+			for (uint32_t laneIdx = 0; laneIdx < 16; ++laneIdx)
+			{
+				valid[laneIdx] = laneIdx < numLanes ? -1 : 0;
+				if (laneIdx < numLanes)
+				{
+					uint32_t pairIdx = grid.pendingIndexArray[packetStart + laneIdx];
+					fill_segment(rays, laneIdx, sourceArray[pairIdx], targetArray[pairIdx], mask);
+				}
+			}
+
+			rtcOccluded16(valid, version->scene, &context, &rays);
+			for (uint32_t laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+				visibleArray[grid.pendingIndexArray[packetStart + laneIdx]] = rays.tfar[laneIdx] >= 0.0f ? 1 : 0;
+		}
+	}
+}
@@ -0,0 +1,587 @@
+// sdk includes
+#include "rcu_spatial/distance_field.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+#include <bento_math/matrix4.h>
+
+// External includes
+#include <atomic>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+namespace rcu
+{
+	// Voxels covered by a brick along an axis
+	#define RCU_SDF_BRICK_VOXELS (RCU_SDF_BRICK_SAMPLES - 1)
+	#define RCU_SDF_BRICK_SIZE (RCU_SDF_BRICK_SAMPLES * RCU_SDF_BRICK_SAMPLES * RCU_SDF_BRICK_SAMPLES)
+	// Limits of the sphere tracing, in steps and in voxels
+	#define RCU_SDF_MAX_STEPS 256
+	#define RCU_SDF_HIT_DISTANCE 0.1f
+	#define RCU_SDF_MIN_STEP 0.25f
+	#define RCU_SDF_REFINE_STEPS 8
+	// Triangles gathered around an edge or a vertex for its pseudo normal, and how close (relative to the coordinates) they must be to tie
+	#define RCU_SDF_MAX_INCIDENT 32
+	#define RCU_SDF_FEATURE_TOLERANCE 1e-5f
+	// Coarse bricks sampled between two calls of the build monitor
+	#define RCU_SDF_MONITOR_BRICKS 4096
+
+	static const float PI = 3.14159265358979f;
+
+	TDistanceField::TDistanceField(bento::IAllocator& allocator)
+	: _allocator(allocator)
+	, origin({ 0.0f, 0.0f, 0.0f })
+	, voxelSize(0.0f)
+	, brickIndexArray(allocator)
+	, coarseDistanceArray(allocator)
+	, sampleArray(allocator)
+	, geometryBoundsArray(allocator)
+	, stale(false)
+	{
+		brickResolution[0] = brickResolution[1] = brickResolution[2] = 0;
+	}
+
+	// Signed distance to a primitive, the transform is expected to be rigid
+	static float primitive_distance(const TPrimitive& primitive, const bento::Vector3& point)
+	{
+		bento::Vector3 p = primitive.inverseTransform * point;
+		switch (primitive.type)
+		{
+			case PrimitiveType::Sphere:
+				return bento::length(p) - primitive.parameters.x;
+			case PrimitiveType::Capsule:
+			{
+				p.y -= fmaxf(-primitive.parameters.y, fminf(p.y, primitive.parameters.y));
+				return bento::length(p) - primitive.parameters.x;
+			}
+			default:
+			{
+				bento::Vector3 d = { fabsf(p.x) - primitive.parameters.x, fabsf(p.y) - primitive.parameters.y, fabsf(p.z) - primitive.parameters.z };
+				bento::Vector3 outside = { fmaxf(d.x, 0.0f), fmaxf(d.y, 0.0f), fmaxf(d.z, 0.0f) };
+				return bento::length(outside) + fminf(fmaxf(d.x, fmaxf(d.y, d.z)), 0.0f);
+			}
+		}
+	}
+
+	static void fetch_triangle(const TScene& scene, uint32_t geometryIndex, uint32_t triangleIndex, bento::Vector3& a, bento::Vector3& b, bento::Vector3& c)
+	{
+		const TGeometry& geometry = scene.geometryArray[geometryIndex];
+		const bento::IVector3& face = geometry.indexArray[triangleIndex];
+		a = geometry.vertexArray[face.x];
+		b = geometry.vertexArray[face.y];
+		c = geometry.vertexArray[face.z];
+		if (geometry.instanced)
+		{
+			a = instance_position(geometry, a);
+			b = instance_position(geometry, b);
+			c = instance_position(geometry, c);
+		}
+	}
+
+	static inline float corner_angle(const bento::Vector3& e0, const bento::Vector3& e1)
+	{
+		return atan2f(bento::length(bento::cross(e0, e1)), bento::dot(e0, e1));
+	}
+
+	// Closest point of the triangle and the angle the triangle spans around it: 2 pi inside the face, pi on an edge, the corner angle on a vertex
+	static float closest_feature(const bento::Vector3& point, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c, bento::Vector3& closest)
+	{
+		bento::Vector3 ab = b - a, ac = c - a, ap = point - a;
+		float d1 = bento::dot(ab, ap), d2 = bento::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+		{
+			closest = a;
+			return corner_angle(ab, ac);
+		}
+
+		bento::Vector3 bp = point - b;
+		float d3 = bento::dot(ab, bp), d4 = bento::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+		{
+			closest = b;
+			return corner_angle(a - b, c - b);
+		}
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		{
+			closest = a + ab * (d1 / (d1 - d3));
+			return PI;
+		}
+
+		bento::Vector3 cp = point - c;
+		float d5 = bento::dot(ab, cp), d6 = bento::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+		{
+			closest = c;
+			return corner_angle(a - c, b - c);
+		}
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		{
+			closest = a + ac * (d2 / (d2 - d6));
+			return PI;
+		}
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+		{
+			closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+			return PI;
+		}
+
+		float denom = 1.0f / (va + vb + vc);
+		closest = a + ab * (vb * denom) + ac * (vc * denom);
+		return 2.0f * PI;
+	}
+
+	// Sign of the distance near an edge or a vertex. The triangles whose closest point is the same one give the angle weighted pseudo
+	// normal of that feature, which is exact for closed meshes. Rounding makes features nearly as close tie with the closest one,
+	// the point has to face the feature that decides.
+	static bool behind_closest_feature(const TScene& scene, const TTriangleBVH& bvh, const bento::Vector3& point, float distance)
+	{
+		float tolerance = RCU_SDF_FEATURE_TOLERANCE * (distance + fmaxf(fabsf(point.x), fmaxf(fabsf(point.y), fabsf(point.z))));
+		TSphereQuery sphere = { point, distance + tolerance };
+		TBVHOverlap overlapArray[RCU_SDF_MAX_INCIDENT];
+		uint32_t numOverlaps = bvh_overlap_sphere(bvh, sphere, overlapArray, RCU_SDF_MAX_INCIDENT);
+		if (numOverlaps > RCU_SDF_MAX_INCIDENT)
+			numOverlaps = RCU_SDF_MAX_INCIDENT;
+
+		// Closest point of every triangle and its normal weighted by the angle it spans around it
+		bento::Vector3 closestArray[RCU_SDF_MAX_INCIDENT];
+		bento::Vector3 weightedNormalArray[RCU_SDF_MAX_INCIDENT];
+		uint32_t numTriangles = 0;
+		for (uint32_t overlapIdx = 0; overlapIdx < numOverlaps; ++overlapIdx)
+		{
+			bento::Vector3 a, b, c;
+			fetch_triangle(scene, overlapArray[overlapIdx].geometryIndex, overlapArray[overlapIdx].triangleIndex, a, b, c);
+			float angle = closest_feature(point, a, b, c, closestArray[numTriangles]);
+			bento::Vector3 faceNormal = bento::cross(b - a, c - a);
+			float faceNormalLength = bento::length(faceNormal);
+			if (faceNormalLength == 0.0f)
+				continue;
+			weightedNormalArray[numTriangles++] = faceNormal * (angle / faceNormalLength);
+		}
+
+		float bestProjection = 0.0f;
+		for (uint32_t triIdx = 0; triIdx < numTriangles; ++triIdx)
+		{
+			bento::Vector3 pseudoNormal = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t otherIdx = 0; otherIdx < numTriangles; ++otherIdx)
+			{
+				if (bento::length(closestArray[otherIdx] - closestArray[triIdx]) <= tolerance)
+					pseudoNormal = pseudoNormal + weightedNormalArray[otherIdx];
+			}
+			float pseudoNormalLength = bento::length(pseudoNormal);
+			if (pseudoNormalLength == 0.0f)
+				continue;
+			float projection = bento::dot(point - closestArray[triIdx], pseudoNormal) / pseudoNormalLength;
+			if (fabsf(projection) > fabsf(bestProjection))
+				bestProjection = projection;
+		}
+		return bestProjection < 0.0f;
+	}
+
+	// Exact distance to the closest surface, negative behind the closest feature (along its pseudo normal) or inside a primitive
+	static float scene_distance(const TScene& scene, const TTriangleBVH& bvh, const bento::Vector3& point)
+	{
+		float distance = FLT_MAX;
+		TBVHClosestHit closestHit;
+		if (bvh_closest_point(bvh, point, FLT_MAX, closestHit))
+		{
+			distance = sqrtf(closestHit.distanceSq);
+
+			// Inside a face its normal is the pseudo normal, the edges and vertices need the triangles around them
+			bento::Vector3 a, b, c, closest;
+			fetch_triangle(scene, closestHit.geometryIndex, closestHit.triangleIndex, a, b, c);
+			bool behind = closest_feature(point, a, b, c, closest) < 2.0f * PI ? behind_closest_feature(scene, bvh, point, distance) : bento::dot(point - closestHit.position, bento::cross(b - a, c - a)) < 0.0f;
+			if (behind)
+				distance = -distance;
+		}
+
+		uint32_t numPrimitives = scene.primitiveArray.size();
+		for (uint32_t primIdx = 0; primIdx < numPrimitives; ++primIdx)
+		{
+			float primitiveDistance = primitive_distance(scene.primitiveArray[primIdx], point);
+			if (fabsf(primitiveDistance) < fabsf(distance))
+				distance = primitiveDistance;
+		}
+		return distance;
+	}
+
+	static inline bento::Vector3 brick_sample_position(const TDistanceField& field, const int32_t* brick, int32_t x, int32_t y, int32_t z)
+	{
+		return { field.origin.x + (brick[0] * RCU_SDF_BRICK_VOXELS + x) * field.voxelSize, field.origin.y + (brick[1] * RCU_SDF_BRICK_VOXELS + y) * field.voxelSize, field.origin.z + (brick[2] * RCU_SDF_BRICK_VOXELS + z) * field.voxelSize };
+	}
+
+	bool build_distance_field(const TScene& scene, const TTriangleBVH& bvh, float voxelSize, uint64_t memoryBudget, TDistanceField& field, TBuildMonitor monitor, void* monitorData)
+	{
+		field.brickIndexArray.clear();
+		field.coarseDistanceArray.clear();
+		field.sampleArray.clear();
+		field.geometryBoundsArray.clear();
+		field.stale = false;
+		if (voxelSize <= 0.0f)
+			return false;
+
+		// Once the monitor cancelled, the remaining iterations of the parallel loops are skipped
+		std::atomic<bool> cancelled(false);
+
+		// Bounds of the content, the root of the hierarchy holds the triangles
+		bento::Vector3 sceneMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+		bento::Vector3 sceneMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		if (bvh.nodeArray.size() > 0)
+		{
+			sceneMin = bvh.nodeArray[0].minBound;
+			sceneMax = bvh.nodeArray[0].maxBound;
+		}
+		uint32_t numPrimitives = scene.primitiveArray.size();
+		for (uint32_t primIdx = 0; primIdx < numPrimitives; ++primIdx)
+		{
+			bento::Vector3 minBound, maxBound;
+			primitive_bounds(scene.primitiveArray[primIdx], minBound, maxBound);
+			sceneMin = { fminf(sceneMin.x, minBound.x), fminf(sceneMin.y, minBound.y), fminf(sceneMin.z, minBound.z) };
+			sceneMax = { fmaxf(sceneMax.x, maxBound.x), fmaxf(sceneMax.y, maxBound.y), fmaxf(sceneMax.z, maxBound.z) };
+		}
+		if (sceneMin.x > sceneMax.x)
+			return false;
+
+		// Coarsen the field until it fits in the budget
+		for (field.voxelSize = voxelSize; ; field.voxelSize *= 2.0f)
+		{
+			float brickSize = field.voxelSize * RCU_SDF_BRICK_VOXELS;
+			float padding = 2.0f * field.voxelSize;
+			field.origin = { sceneMin.x - padding, sceneMin.y - padding, sceneMin.z - padding };
+			bento::Vector3 extent = sceneMax - field.origin;
+			uint64_t numBricks = 1;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				field.brickResolution[axis] = (int32_t)fminf(floorf(((&extent.x)[axis] + padding) / brickSize + 1.0f), 1048576.0f);
+				numBricks *= (uint64_t)field.brickResolution[axis];
+			}
+			uint64_t coarseMemory = numBricks * (sizeof(uint32_t) + sizeof(float));
+			if (coarseMemory > memoryBudget || numBricks > (1ull << 28))
+			{
+				if (numBricks == 1)
+					return false;
+				continue;
+			}
+
+			// Distance at the center of every brick, the bricks that a surface may cross get the full samples
+			field.brickIndexArray.resize((uint32_t)numBricks);
+			field.coarseDistanceArray.resize((uint32_t)numBricks);
+			float bandDistance = sqrtf(3.0f) * 0.5f * brickSize + field.voxelSize;
+			#pragma omp parallel for
+			for (int32_t brickIdx = 0; brickIdx < (int32_t)numBricks; ++brickIdx)
+			{
+				if (cancelled.load(std::memory_order_relaxed))
+					continue;
+				if (monitor != nullptr && (brickIdx % RCU_SDF_MONITOR_BRICKS) == 0 && !monitor(monitorData, 0.0f))
+					cancelled.store(true);
+				int32_t brick[3] = { brickIdx % field.brickResolution[0], (brickIdx / field.brickResolution[0]) % field.brickResolution[1], brickIdx / (field.brickResolution[0] * field.brickResolution[1]) };
+				bento::Vector3 center = brick_sample_position(field, brick, 0, 0, 0) + bento::vector3(0.5f * brickSize, 0.5f * brickSize, 0.5f * brickSize);
+				float distance = scene_distance(scene, bvh, center);
+				field.coarseDistanceArray[brickIdx] = distance;
+				field.brickIndexArray[brickIdx] = fabsf(distance) <= bandDistance ? 0 : RCU_SDF_COARSE_BRICK;
+			}
+			if (cancelled.load())
+				return false;
+
+			uint32_t numBandBricks = 0;
+			for (uint32_t brickIdx = 0; brickIdx < (uint32_t)numBricks; ++brickIdx)
+			{
+				if (field.brickIndexArray[brickIdx] != RCU_SDF_COARSE_BRICK)
+					field.brickIndexArray[brickIdx] = numBandBricks++;
+			}
+			if (coarseMemory + (uint64_t)numBandBricks * RCU_SDF_BRICK_SIZE * sizeof(float) > memoryBudget)
+			{
+				if (numBricks == 1)
+					return false;
+				continue;
+			}
+
+			// Exact samples of the narrow band
+			field.sampleArray.resize(numBandBricks * RCU_SDF_BRICK_SIZE);
+			std::atomic<uint32_t> numSampledBricks(0);
+			#pragma omp parallel for schedule(dynamic, 1)
+			for (int32_t brickIdx = 0; brickIdx < (int32_t)numBricks; ++brickIdx)
+			{
+				uint32_t bandIdx = field.brickIndexArray[brickIdx];
+				if (bandIdx == RCU_SDF_COARSE_BRICK || cancelled.load(std::memory_order_relaxed))
+					continue;
+				int32_t brick[3] = { brickIdx % field.brickResolution[0], (brickIdx / field.brickResolution[0]) % field.brickResolution[1], brickIdx / (field.brickResolution[0] * field.brickResolution[1]) };
+				float* samples = field.sampleArray.begin() + (size_t)bandIdx * RCU_SDF_BRICK_SIZE;
+				for (int32_t z = 0; z < RCU_SDF_BRICK_SAMPLES; ++z)
+					for (int32_t y = 0; y < RCU_SDF_BRICK_SAMPLES; ++y)
+						for (int32_t x = 0; x < RCU_SDF_BRICK_SAMPLES; ++x)
+							samples[(z * RCU_SDF_BRICK_SAMPLES + y) * RCU_SDF_BRICK_SAMPLES + x] = scene_distance(scene, bvh, brick_sample_position(field, brick, x, y, z));
+				if (monitor != nullptr && !monitor(monitorData, (float)(++numSampledBricks) / (float)numBandBricks))
+					cancelled.store(true);
+			}
+			if (cancelled.load())
+				return false;
+
+			// The refits compare these to the moved geometries
+			uint32_t numGeometries = scene.geometryArray.size();
+			field.geometryBoundsArray.resize(numGeometries);
+			for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+				geometry_world_bounds(scene.geometryArray[geoIdx], field.geometryBoundsArray[geoIdx].minBound, field.geometryBoundsArray[geoIdx].maxBound);
+			return true;
+		}
+	}
+
+	// Distance at a point inside the field, returns true if it was interpolated from the band samples
+	static bool sample_inside(const TDistanceField& field, const bento::Vector3& point, TDistanceSample& sample)
+	{
+		float g[3];
+		int32_t brick[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			g[axis] = ((&point.x)[axis] - (&field.origin.x)[axis]) / field.voxelSize;
+			float brickCoordinate = floorf(g[axis] / RCU_SDF_BRICK_VOXELS);
+			brick[axis] = (int32_t)fmaxf(0.0f, fminf(brickCoordinate, (float)(field.brickResolution[axis] - 1)));
+			g[axis] -= (float)(brick[axis] * RCU_SDF_BRICK_VOXELS);
+		}
+		uint32_t brickIdx = (brick[2] * field.brickResolution[1] + brick[1]) * field.brickResolution[0] + brick[0];
+
+		// Far from the surfaces the distance is only known at the center, it is 1-Lipschitz
+		uint32_t bandIdx = field.brickIndexArray[brickIdx];
+		if (bandIdx == RCU_SDF_COARSE_BRICK)
+		{
+			float half = 0.5f * RCU_SDF_BRICK_VOXELS;
+			bento::Vector3 offset = { g[0] - half, g[1] - half, g[2] - half };
+			sample.distance = field.coarseDistanceArray[brickIdx];
+			sample.error = bento::length(offset) * field.voxelSize;
+			return false;
+		}
+
+		// Trilinear interpolation, each corner is off by at most its distance to the point
+		int32_t cell[3];
+		float f[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float clamped = fmaxf(0.0f, fminf(g[axis], (float)RCU_SDF_BRICK_VOXELS));
+			cell[axis] = clamped >= (float)RCU_SDF_BRICK_VOXELS ? RCU_SDF_BRICK_VOXELS - 1 : (int32_t)clamped;
+			f[axis] = clamped - (float)cell[axis];
+		}
+		const float* samples = field.sampleArray.begin() + (size_t)bandIdx * RCU_SDF_BRICK_SIZE + (cell[2] * RCU_SDF_BRICK_SAMPLES + cell[1]) * RCU_SDF_BRICK_SAMPLES + cell[0];
+		const uint32_t dy = RCU_SDF_BRICK_SAMPLES, dz = RCU_SDF_BRICK_SAMPLES * RCU_SDF_BRICK_SAMPLES;
+		float c00 = samples[0] + (samples[1] - samples[0]) * f[0];
+		float c10 = samples[dy] + (samples[dy + 1] - samples[dy]) * f[0];
+		float c01 = samples[dz] + (samples[dz + 1] - samples[dz]) * f[0];
+		float c11 = samples[dz + dy] + (samples[dz + dy + 1] - samples[dz + dy]) * f[0];
+		float c0 = c00 + (c10 - c00) * f[1];
+		float c1 = c01 + (c11 - c01) * f[1];
+		sample.distance = c0 + (c1 - c0) * f[2];
+		sample.error = sqrtf(f[0] * (1.0f - f[0]) + f[1] * (1.0f - f[1]) + f[2] * (1.0f - f[2])) * field.voxelSize;
+		return true;
+	}
+
+	static inline void field_bounds(const TDistanceField& field, bento::Vector3& minBound, bento::Vector3& maxBound)
+	{
+		float brickSize = field.voxelSize * RCU_SDF_BRICK_VOXELS;
+		minBound = field.origin;
+		maxBound = { field.origin.x + field.brickResolution[0] * brickSize, field.origin.y + field.brickResolution[1] * brickSize, field.origin.z + field.brickResolution[2] * brickSize };
+	}
+
+	// True if one of the regions is within distance of the point
+	static bool near_regions(const bento::Vector<TBoxQuery>& regionArray, const bento::Vector3& point, float distance)
+	{
+		uint32_t numRegions = regionArray.size();
+		for (uint32_t regionIdx = 0; regionIdx < numRegions; ++regionIdx)
+		{
+			const TBoxQuery& region = regionArray[regionIdx];
+			float dx = fmaxf(fmaxf(region.minBound.x - point.x, point.x - region.maxBound.x), 0.0f);
+			float dy = fmaxf(fmaxf(region.minBound.y - point.y, point.y - region.maxBound.y), 0.0f);
+			float dz = fmaxf(fmaxf(region.minBound.z - point.z, point.z - region.maxBound.z), 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= distance * distance)
+				return true;
+		}
+		return false;
+	}
+
+	void refit_distance_field(const TScene& scene, const TTriangleBVH& bvh, const uint8_t* dirtyGeometryArray, TDistanceField& field)
+	{
+		if (field.stale || field.brickIndexArray.size() == 0)
+			return;
+
+		// A sample only changes if a moved geometry was or is now closer than its distance, so within the bounds before or after the move.
+		// The samples whose closest surface is the moved one are exactly at their distance from those bounds, a voxel of margin keeps them.
+		bento::Vector3 fieldMin, fieldMax;
+		field_bounds(field, fieldMin, fieldMax);
+		bento::Vector<TBoxQuery> regionArray(field._allocator);
+		uint32_t numGeometries = field.geometryBoundsArray.size();
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			if (!dirtyGeometryArray[geoIdx])
+				continue;
+			TBoxQuery& bounds = field.geometryBoundsArray[geoIdx];
+			bento::Vector3 minBound, maxBound;
+			geometry_world_bounds(scene.geometryArray[geoIdx], minBound, maxBound);
+
+			// The distances outside of the field assume that the surfaces are inside it
+			if (minBound.x <= maxBound.x && (minBound.x < fieldMin.x || minBound.y < fieldMin.y || minBound.z < fieldMin.z || maxBound.x > fieldMax.x || maxBound.y > fieldMax.y || maxBound.z > fieldMax.z))
+			{
+				field.stale = true;
+				return;
+			}
+			TBoxQuery region = { { fminf(bounds.minBound.x, minBound.x), fminf(bounds.minBound.y, minBound.y), fminf(bounds.minBound.z, minBound.z) }, { fmaxf(bounds.maxBound.x, maxBound.x), fmaxf(bounds.maxBound.y, maxBound.y), fmaxf(bounds.maxBound.z, maxBound.z) } };
+			if (region.minBound.x <= region.maxBound.x)
+				regionArray.push_back(region);
+			bounds.minBound = minBound;
+			bounds.maxBound = maxBound;
+		}
+		if (regionArray.size() == 0)
+			return;
+
+		float brickSize = field.voxelSize * RCU_SDF_BRICK_VOXELS;
+		int32_t numBricks = field.brickResolution[0] * field.brickResolution[1] * field.brickResolution[2];
+		#pragma omp parallel for schedule(dynamic, 16)
+		for (int32_t brickIdx = 0; brickIdx < numBricks; ++brickIdx)
+		{
+			int32_t brick[3] = { brickIdx % field.brickResolution[0], (brickIdx / field.brickResolution[0]) % field.brickResolution[1], brickIdx / (field.brickResolution[0] * field.brickResolution[1]) };
+			uint32_t bandIdx = field.brickIndexArray[brickIdx];
+			if (bandIdx == RCU_SDF_COARSE_BRICK)
+			{
+				bento::Vector3 center = brick_sample_position(field, brick, 0, 0, 0) + bento::vector3(0.5f * brickSize, 0.5f * brickSize, 0.5f * brickSize);
+				if (near_regions(regionArray, center, fabsf(field.coarseDistanceArray[brickIdx]) + field.voxelSize))
+					field.coarseDistanceArray[brickIdx] = scene_distance(scene, bvh, center);
+				continue;
+			}
+
+			float* samples = field.sampleArray.begin() + (size_t)bandIdx * RCU_SDF_BRICK_SIZE;
+			for (int32_t z = 0; z < RCU_SDF_BRICK_SAMPLES; ++z)
+				for (int32_t y = 0; y < RCU_SDF_BRICK_SAMPLES; ++y)
+					for (int32_t x = 0; x < RCU_SDF_BRICK_SAMPLES; ++x)
+					{
+						float& sample = samples[(z * RCU_SDF_BRICK_SAMPLES + y) * RCU_SDF_BRICK_SAMPLES + x];
+						bento::Vector3 position = brick_sample_position(field, brick, x, y, z);
+						if (near_regions(regionArray, position, fabsf(sample) + field.voxelSize))
+							sample = scene_distance(scene, bvh, position);
+					}
+		}
+	}
+
+	TDistanceSample sample_distance_field(const TDistanceField& field, const bento::Vector3& point)
+	{
+		TDistanceSample sample;
+		if (field.brickIndexArray.size() == 0 || field.stale)
+		{
+			sample.distance = FLT_MAX;
+			sample.error = FLT_MAX;
+			return sample;
+		}
+
+		bento::Vector3 minBound, maxBound;
+		field_bounds(field, minBound, maxBound);
+		bento::Vector3 clamped = { fmaxf(minBound.x, fminf(point.x, maxBound.x)), fmaxf(minBound.y, fminf(point.y, maxBound.y)), fmaxf(minBound.z, fminf(point.z, maxBound.z)) };
+		sample_inside(field, clamped, sample);
+		float outsideDistance = bento::length(point - clamped);
+		if (outsideDistance == 0.0f)
+			return sample;
+
+		// The surfaces are inside the field, the point is at least as far from them as from the field and its projection
+		float nearest = sqrtf(outsideDistance * outsideDistance + fmaxf(sample.distance - sample.error, 0.0f) * fmaxf(sample.distance - sample.error, 0.0f));
+		float farthest = outsideDistance + sample.distance + sample.error;
+		sample.distance = 0.5f * (nearest + farthest);
+		sample.error = 0.5f * (farthest - nearest);
+		return sample;
+	}
+
+	void sphere_trace(const TDistanceField& field, const TRay& ray, TDistanceHit& hit)
+	{
+		hit.validity = 0;
+		hit.t = FLT_MAX;
+		hit.error = 0.0f;
+		hit.clearance = FLT_MAX;
+		float directionLength = bento::length(ray.direction);
+		if (field.stale)
+			hit.error = FLT_MAX;
+		if (field.brickIndexArray.size() == 0 || field.stale || directionLength == 0.0f)
+			return;
+
+		// March in world units along the normalized direction, within the field
+		bento::Vector3 direction = ray.direction * (1.0f / directionLength);
+		bento::Vector3 minBound, maxBound;
+		field_bounds(field, minBound, maxBound);
+		float sStart = ray.tmin * directionLength, sEnd = ray.tmax * directionLength;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float o = (&ray.origin.x)[axis], d = (&direction.x)[axis];
+			if (d == 0.0f)
+			{
+				if (o < (&minBound.x)[axis] || o > (&maxBound.x)[axis])
+					return;
+				continue;
+			}
+			float t0 = ((&minBound.x)[axis] - o) / d, t1 = ((&maxBound.x)[axis] - o) / d;
+			sStart = fmaxf(sStart, fminf(t0, t1));
+			sEnd = fminf(sEnd, fmaxf(t0, t1));
+		}
+		if (sStart > sEnd)
+			return;
+
+		float hitDistance = RCU_SDF_HIT_DISTANCE * field.voxelSize;
+		float minStep = RCU_SDF_MIN_STEP * field.voxelSize;
+		float s = sStart, previousS = sStart;
+		TDistanceSample sample;
+		bool found = false;
+		for (uint32_t stepIdx = 0; stepIdx < RCU_SDF_MAX_STEPS; ++stepIdx)
+		{
+			bool band = sample_inside(field, ray.origin + direction * s, sample);
+
+			// Crossing a surface flips the sign, look for the zero between the last two steps
+			if (sample.distance < 0.0f)
+			{
+				if (stepIdx > 0)
+				{
+					float low = previousS, high = s;
+					for (uint32_t refineIdx = 0; refineIdx < RCU_SDF_REFINE_STEPS; ++refineIdx)
+					{
+						float middle = 0.5f * (low + high);
+						TDistanceSample middleSample;
+						sample_inside(field, ray.origin + direction * middle, middleSample);
+						if (middleSample.distance < 0.0f)
+							high = middle;
+						else
+							low = middle;
+					}
+					s = high;
+					sample_inside(field, ray.origin + direction * s, sample);
+				}
+				found = true;
+				break;
+			}
+			if (sample.distance <= hitDistance)
+			{
+				found = true;
+				break;
+			}
+			hit.clearance = fminf(hit.clearance, sample.distance);
+			if (s >= sEnd)
+				break;
+
+			// The band samples are close to exact, far from the surfaces only the lower bound is safe
+			previousS = s;
+			s = fminf(s + fmaxf(band ? sample.distance : sample.distance - sample.error, minStep), sEnd);
+		}
+		if (!found)
+			return;
+
+		hit.validity = 1;
+		hit.t = s / directionLength;
+		hit.error = fabsf(sample.distance) + sample.error;
+		hit.position = ray.origin + direction * s;
+
+		// Gradient of the field by central differences
+		float delta = 0.5f * field.voxelSize;
+		bento::Vector3 gradient = {
+			sample_distance_field(field, hit.position + bento::vector3(delta, 0.0f, 0.0f)).distance - sample_distance_field(field, hit.position - bento::vector3(delta, 0.0f, 0.0f)).distance,
+			sample_distance_field(field, hit.position + bento::vector3(0.0f, delta, 0.0f)).distance - sample_distance_field(field, hit.position - bento::vector3(0.0f, delta, 0.0f)).distance,
+			sample_distance_field(field, hit.position + bento::vector3(0.0f, 0.0f, delta)).distance - sample_distance_field(field, hit.position - bento::vector3(0.0f, 0.0f, delta)).distance };
+		float gradientLength = bento::length(gradient);
+		hit.normal = gradientLength > 0.0f ? gradient * (1.0f / gradientLength) : direction * -1.0f;
+	}
+}
@@ -0,0 +1,377 @@
+// sdk includes
+#include "rcu_spatial/occupancy_grid.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+
+// External includes
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+namespace rcu
+{
+	// Fraction of a voxel the triangles are grown by, keeps the walks robust to rounding at the voxel faces
+	#define RCU_OCCUPANCY_MARGIN 0.01f
+	// Largest number of bricks accepted along an axis and in total
+	#define RCU_OCCUPANCY_MAX_BRICKS_PER_AXIS (1 << 20)
+	#define RCU_OCCUPANCY_MAX_BRICKS (1ull << 28)
+	// Triangles voxelized between two calls of the build monitor
+	#define RCU_OCCUPANCY_MONITOR_TRIANGLES 65536
+
+	TOccupancyGrid::TOccupancyGrid(bento::IAllocator& allocator)
+	: origin({ 0.0f, 0.0f, 0.0f })
+	, voxelSize(0.0f)
+	, brickIndexArray(allocator)
+	, brickMaskArray(allocator)
+	, dynamicGeometryArray(allocator)
+	, dynamicBoundsArray(allocator)
+	{
+		brickResolution[0] = brickResolution[1] = brickResolution[2] = 0;
+	}
+
+	static inline void grow_bounds(bento::Vector3& minBound, bento::Vector3& maxBound, const bento::Vector3& otherMin, const bento::Vector3& otherMax)
+	{
+		minBound = { fminf(minBound.x, otherMin.x), fminf(minBound.y, otherMin.y), fminf(minBound.z, otherMin.z) };
+		maxBound = { fmaxf(maxBound.x, otherMax.x), fmaxf(maxBound.y, otherMax.y), fmaxf(maxBound.z, otherMax.z) };
+	}
+
+	// Voxel that contains the coordinate along an axis, clamped to the grid
+	static inline int32_t voxel_coordinate(const TOccupancyGrid& grid, uint32_t axis, float value)
+	{
+		float voxel = floorf((value - (&grid.origin.x)[axis]) / grid.voxelSize);
+		float maxVoxel = (float)(grid.brickResolution[axis] * RCU_OCCUPANCY_BRICK_SIZE - 1);
+		return (int32_t)(voxel < 0.0f ? 0.0f : (voxel > maxVoxel ? maxVoxel : voxel));
+	}
+
+	static inline void mark_voxel(TOccupancyGrid& grid, const int32_t* voxel)
+	{
+		uint32_t brickIdx = ((voxel[2] / RCU_OCCUPANCY_BRICK_SIZE) * grid.brickResolution[1] + voxel[1] / RCU_OCCUPANCY_BRICK_SIZE) * grid.brickResolution[0] + voxel[0] / RCU_OCCUPANCY_BRICK_SIZE;
+		uint32_t& maskIdx = grid.brickIndexArray[brickIdx];
+		if (maskIdx == RCU_OCCUPANCY_EMPTY_BRICK)
+		{
+			maskIdx = grid.brickMaskArray.size();
+			grid.brickMaskArray.push_back(0);
+		}
+		uint32_t bit = ((voxel[2] % RCU_OCCUPANCY_BRICK_SIZE) * RCU_OCCUPANCY_BRICK_SIZE + voxel[1] % RCU_OCCUPANCY_BRICK_SIZE) * RCU_OCCUPANCY_BRICK_SIZE + voxel[0] % RCU_OCCUPANCY_BRICK_SIZE;
+		grid.brickMaskArray[maskIdx] |= 1ull << bit;
+	}
+
+	static void mark_box(TOccupancyGrid& grid, const bento::Vector3& minBound, const bento::Vector3& maxBound)
+	{
+		int32_t minVoxel[3], maxVoxel[3], voxel[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			minVoxel[axis] = voxel_coordinate(grid, axis, (&minBound.x)[axis]);
+			maxVoxel[axis] = voxel_coordinate(grid, axis, (&maxBound.x)[axis]);
+		}
+		for (voxel[2] = minVoxel[2]; voxel[2] <= maxVoxel[2]; ++voxel[2])
+			for (voxel[1] = minVoxel[1]; voxel[1] <= maxVoxel[1]; ++voxel[1])
+				for (voxel[0] = minVoxel[0]; voxel[0] <= maxVoxel[0]; ++voxel[0])
+					mark_voxel(grid, voxel);
+	}
+
+	// Marks the voxels crossed by the plane of the triangle within its bounds, one column at a time along the dominant axis of the normal
+	static void mark_triangle(TOccupancyGrid& grid, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c)
+	{
+		float margin = grid.voxelSize * RCU_OCCUPANCY_MARGIN;
+		bento::Vector3 minBound = { fminf(a.x, fminf(b.x, c.x)) - margin, fminf(a.y, fminf(b.y, c.y)) - margin, fminf(a.z, fminf(b.z, c.z)) - margin };
+		bento::Vector3 maxBound = { fmaxf(a.x, fmaxf(b.x, c.x)) + margin, fmaxf(a.y, fmaxf(b.y, c.y)) + margin, fmaxf(a.z, fmaxf(b.z, c.z)) + margin };
+		bento::Vector3 normal = bento::cross(b - a, c - a);
+		const float* n = &normal.x;
+		uint32_t w = fabsf(n[0]) > fabsf(n[1]) ? (fabsf(n[0]) > fabsf(n[2]) ? 0 : 2) : (fabsf(n[1]) > fabsf(n[2]) ? 1 : 2);
+		if (n[w] == 0.0f)
+		{
+			mark_box(grid, minBound, maxBound);
+			return;
+		}
+		uint32_t u = (w + 1) % 3, v = (w + 2) % 3;
+		const float* boxMin = &minBound.x;
+		const float* boxMax = &maxBound.x;
+		const float* gridOrigin = &grid.origin.x;
+		float planeDistance = bento::dot(normal, a);
+
+		int32_t minU = voxel_coordinate(grid, u, boxMin[u]), maxU = voxel_coordinate(grid, u, boxMax[u]);
+		int32_t minV = voxel_coordinate(grid, v, boxMin[v]), maxV = voxel_coordinate(grid, v, boxMax[v]);
+		int32_t voxel[3];
+		for (voxel[u] = minU; voxel[u] <= maxU; ++voxel[u])
+		{
+			float u0 = fmaxf(boxMin[u], gridOrigin[u] + voxel[u] * grid.voxelSize - margin);
+			float u1 = fminf(boxMax[u], gridOrigin[u] + (voxel[u] + 1) * grid.voxelSize + margin);
+			for (voxel[v] = minV; voxel[v] <= maxV; ++voxel[v])
+			{
+				float v0 = fmaxf(boxMin[v], gridOrigin[v] + voxel[v] * grid.voxelSize - margin);
+				float v1 = fminf(boxMax[v], gridOrigin[v] + (voxel[v] + 1) * grid.voxelSize + margin);
+
+				// Height of the plane at the corners of the column
+				float w00 = (planeDistance - n[u] * u0 - n[v] * v0) / n[w];
+				float w01 = (planeDistance - n[u] * u0 - n[v] * v1) / n[w];
+				float w10 = (planeDistance - n[u] * u1 - n[v] * v0) / n[w];
+				float w11 = (planeDistance - n[u] * u1 - n[v] * v1) / n[w];
+				float w0 = fmaxf(boxMin[w], fminf(fminf(w00, w01), fminf(w10, w11)) - margin);
+				float w1 = fminf(boxMax[w], fmaxf(fmaxf(w00, w01), fmaxf(w10, w11)) + margin);
+				if (w0 > w1)
+					continue;
+
+				int32_t maxW = voxel_coordinate(grid, w, w1);
+				for (voxel[w] = voxel_coordinate(grid, w, w0); voxel[w] <= maxW; ++voxel[w])
+					mark_voxel(grid, voxel);
+			}
+		}
+	}
+
+	static uint64_t grid_memory(const TOccupancyGrid& grid)
+	{
+		return (uint64_t)grid.brickIndexArray.size() * sizeof(uint32_t) + (uint64_t)grid.brickMaskArray.size() * sizeof(uint64_t);
+	}
+
+	bool build_occupancy_grid(const TScene& scene, float voxelSize, uint64_t memoryBudget, TOccupancyGrid& grid, TBuildMonitor monitor, void* monitorData)
+	{
+		grid.brickIndexArray.clear();
+		grid.brickMaskArray.clear();
+		grid.dynamicGeometryArray.clear();
+		grid.dynamicBoundsArray.clear();
+		if (voxelSize <= 0.0f)
+			return false;
+
+		// Bounds of the static content, the dynamic geometries are only tracked
+		bento::Vector3 sceneMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+		bento::Vector3 sceneMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t numGeometries = scene.geometryArray.size();
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			const TGeometry& geometry = scene.geometryArray[geoIdx];
+			bento::Vector3 minBound, maxBound;
+			geometry_world_bounds(geometry, minBound, maxBound);
+			if (geometry.deformable || geometry.instanced)
+			{
+				grid.dynamicGeometryArray.push_back(geoIdx);
+				grid.dynamicBoundsArray.push_back({ minBound, maxBound });
+			}
+			else
+			{
+				grow_bounds(sceneMin, sceneMax, minBound, maxBound);
+			}
+		}
+		uint32_t numPrimitives = scene.primitiveArray.size();
+		for (uint32_t primIdx = 0; primIdx < numPrimitives; ++primIdx)
+		{
+			bento::Vector3 minBound, maxBound;
+			primitive_bounds(scene.primitiveArray[primIdx], minBound, maxBound);
+			grow_bounds(sceneMin, sceneMax, minBound, maxBound);
+		}
+		if (grid.dynamicGeometryArray.size() > RCU_OCCUPANCY_MAX_DYNAMIC)
+			return false;
+
+		// Only dynamic content, their bounds are enough
+		if (sceneMin.x > sceneMax.x)
+		{
+			grid.brickResolution[0] = grid.brickResolution[1] = grid.brickResolution[2] = 0;
+			return grid.dynamicGeometryArray.size() > 0;
+		}
+
+		// Coarsen the grid until it fits in the budget
+		for (grid.voxelSize = voxelSize; ; grid.voxelSize *= 2.0f)
+		{
+			float brickSize = grid.voxelSize * RCU_OCCUPANCY_BRICK_SIZE;
+			grid.origin = { sceneMin.x - grid.voxelSize, sceneMin.y - grid.voxelSize, sceneMin.z - grid.voxelSize };
+			bento::Vector3 extent = sceneMax - grid.origin;
+			uint64_t numBricks = 1;
+			bool tooFine = false;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				float numAxisBricks = floorf((&extent.x)[axis] / brickSize + 1.0f);
+				tooFine |= numAxisBricks > (float)RCU_OCCUPANCY_MAX_BRICKS_PER_AXIS;
+				grid.brickResolution[axis] = tooFine ? 1 : (int32_t)numAxisBricks;
+				numBricks *= (uint64_t)grid.brickResolution[axis];
+			}
+			if (tooFine || numBricks > RCU_OCCUPANCY_MAX_BRICKS || numBricks * sizeof(uint32_t) > memoryBudget)
+			{
+				if (numBricks == 1)
+					return false;
+				continue;
+			}
+
+			grid.brickIndexArray.resize((uint32_t)numBricks);
+			memset(grid.brickIndexArray.begin(), 0xff, sizeof(uint32_t) * numBricks);
+			grid.brickMaskArray.clear();
+
+			bool overBudget = false;
+			for (uint32_t geoIdx = 0; geoIdx < numGeometries && !overBudget; ++geoIdx)
+			{
+				const TGeometry& geometry = scene.geometryArray[geoIdx];
+				if (geometry.deformable || geometry.instanced)
+					continue;
+				uint32_t numTriangles = geometry.indexArray.size();
+				for (uint32_t triIdx = 0; triIdx < numTriangles && !overBudget; ++triIdx)
+				{
+					if (monitor != nullptr && (triIdx % RCU_OCCUPANCY_MONITOR_TRIANGLES) == 0 && !monitor(monitorData, (geoIdx + (float)triIdx / numTriangles) / numGeometries))
+						return false;
+					const bento::IVector3& face = geometry.indexArray[triIdx];
+					mark_triangle(grid, geometry.vertexArray[face.x], geometry.vertexArray[face.y], geometry.vertexArray[face.z]);
+					overBudget = grid_memory(grid) > memoryBudget;
+				}
+			}
+			for (uint32_t primIdx = 0; primIdx < numPrimitives && !overBudget; ++primIdx)
+			{
+				bento::Vector3 minBound, maxBound;
+				primitive_bounds(scene.primitiveArray[primIdx], minBound, maxBound);
+				mark_box(grid, minBound, maxBound);
+				overBudget = grid_memory(grid) > memoryBudget;
+			}
+			if (!overBudget)
+				return true;
+			if (numBricks == 1)
+				return false;
+		}
+	}
+
+	void refit_occupancy_grid(const TScene& scene, const uint8_t* dirtyGeometryArray, TOccupancyGrid& grid)
+	{
+		uint32_t numDynamic = grid.dynamicGeometryArray.size();
+		for (uint32_t dynamicIdx = 0; dynamicIdx < numDynamic; ++dynamicIdx)
+		{
+			uint32_t geoIdx = grid.dynamicGeometryArray[dynamicIdx];
+			if (dirtyGeometryArray[geoIdx])
+				geometry_world_bounds(scene.geometryArray[geoIdx], grid.dynamicBoundsArray[dynamicIdx].minBound, grid.dynamicBoundsArray[dynamicIdx].maxBound);
+		}
+	}
+
+	// Range of the segment [tmin, tmax] inside the box
+	static inline bool clip_segment(const bento::Vector3& origin, const bento::Vector3& direction, float tmin, float tmax, const bento::Vector3& minBound, const bento::Vector3& maxBound, float& tNear, float& tFar)
+	{
+		tNear = tmin;
+		tFar = tmax;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float o = (&origin.x)[axis], d = (&direction.x)[axis];
+			float boxMin = (&minBound.x)[axis], boxMax = (&maxBound.x)[axis];
+			// Parallel rays only overlap if they start inside the slab
+			if (d == 0.0f)
+			{
+				if (o < boxMin || o > boxMax)
+					return false;
+				continue;
+			}
+			float t0 = (boxMin - o) / d, t1 = (boxMax - o) / d;
+			tNear = fmaxf(tNear, fminf(t0, t1));
+			tFar = fminf(tFar, fmaxf(t0, t1));
+		}
+		return tNear <= tFar;
+	}
+
+	// Walks the cells of edge cellSize crossed by start + t * direction for t in [0, tEnd] in order, the walk stops at the cells
+	// outside [minCell, maxCell]. visit(cell, tEnter, tExit) returns true to stop the walk, which then returns true.
+	template<typename TVisitor>
+	static inline bool walk_cells(const bento::Vector3& gridOrigin, float cellSize, const int32_t* minCell, const int32_t* maxCell, const bento::Vector3& start, const bento::Vector3& direction, float tEnd, const TVisitor& visit)
+	{
+		int32_t cell[3], step[3];
+		float tNext[3], tDelta[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			float s = (&start.x)[axis], d = (&direction.x)[axis], g = (&gridOrigin.x)[axis];
+			float position = floorf((s - g) / cellSize);
+			position = position < (float)minCell[axis] ? (float)minCell[axis] : (position > (float)maxCell[axis] ? (float)maxCell[axis] : position);
+			cell[axis] = (int32_t)position;
+			if (d == 0.0f)
+			{
+				step[axis] = 0;
+				tNext[axis] = FLT_MAX;
+				tDelta[axis] = FLT_MAX;
+				continue;
+			}
+			step[axis] = d > 0.0f ? 1 : -1;
+			tNext[axis] = (g + (cell[axis] + (d > 0.0f ? 1 : 0)) * cellSize - s) / d;
+			tDelta[axis] = cellSize / fabsf(d);
+		}
+
+		float tEnter = 0.0f;
+		for (;;)
+		{
+			uint32_t axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+			if (visit(cell, tEnter, fminf(tNext[axis], tEnd)))
+				return true;
+			if (tNext[axis] >= tEnd)
+				return false;
+			cell[axis] += step[axis];
+			if (cell[axis] < minCell[axis] || cell[axis] > maxCell[axis])
+				return false;
+			tEnter = tNext[axis];
+			tNext[axis] += tDelta[axis];
+		}
+	}
+
+	// Entry distance of the first occupied voxel met by start + t * direction for t in [0, tEnd]
+	static bool first_occupied_voxel(const TOccupancyGrid& grid, const bento::Vector3& start, const bento::Vector3& direction, float tEnd, float& tHit)
+	{
+		const int32_t minBrick[3] = { 0, 0, 0 };
+		const int32_t maxBrick[3] = { grid.brickResolution[0] - 1, grid.brickResolution[1] - 1, grid.brickResolution[2] - 1 };
+		float brickSize = grid.voxelSize * RCU_OCCUPANCY_BRICK_SIZE;
+
+		// Walk the bricks and only descend into the occupied ones
+		return walk_cells(grid.origin, brickSize, minBrick, maxBrick, start, direction, tEnd, [&](const int32_t* brick, float tEnter, float tExit)
+		{
+			uint32_t maskIdx = grid.brickIndexArray[(brick[2] * grid.brickResolution[1] + brick[1]) * grid.brickResolution[0] + brick[0]];
+			if (maskIdx == RCU_OCCUPANCY_EMPTY_BRICK)
+				return false;
+			uint64_t mask = grid.brickMaskArray[maskIdx];
+
+			const int32_t minVoxel[3] = { brick[0] * RCU_OCCUPANCY_BRICK_SIZE, brick[1] * RCU_OCCUPANCY_BRICK_SIZE, brick[2] * RCU_OCCUPANCY_BRICK_SIZE };
+			const int32_t maxVoxel[3] = { minVoxel[0] + RCU_OCCUPANCY_BRICK_SIZE - 1, minVoxel[1] + RCU_OCCUPANCY_BRICK_SIZE - 1, minVoxel[2] + RCU_OCCUPANCY_BRICK_SIZE - 1 };
+			bento::Vector3 brickStart = start + direction * tEnter;
+			return walk_cells(grid.origin, grid.voxelSize, minVoxel, maxVoxel, brickStart, direction, tExit - tEnter, [&](const int32_t* voxel, float voxelEnter, float)
+			{
+				uint32_t bit = ((voxel[2] - minVoxel[2]) * RCU_OCCUPANCY_BRICK_SIZE + voxel[1] - minVoxel[1]) * RCU_OCCUPANCY_BRICK_SIZE + voxel[0] - minVoxel[0];
+				if ((mask >> bit) & 1)
+				{
+					tHit = tEnter + voxelEnter;
+					return true;
+				}
+				return false;
+			});
+		});
+	}
+
+	bool occupancy_clip_segment(const TOccupancyGrid& grid, const bento::Vector3& origin, const bento::Vector3& direction, float tmin, float& tmax)
+	{
+		bool occupied = false;
+		float lastExit = tmin;
+
+		// The dynamic geometries keep whatever part of the segment crosses their bounds
+		uint32_t numDynamic = grid.dynamicBoundsArray.size();
+		for (uint32_t dynamicIdx = 0; dynamicIdx < numDynamic; ++dynamicIdx)
+		{
+			float tNear, tFar;
+			if (clip_segment(origin, direction, tmin, tmax, grid.dynamicBoundsArray[dynamicIdx].minBound, grid.dynamicBoundsArray[dynamicIdx].maxBound, tNear, tFar))
+			{
+				occupied = true;
+				lastExit = fmaxf(lastExit, tFar);
+			}
+		}
+
+		// Walk the grid backwards from the end of the segment, the first occupied voxel met is the last one of the ray
+		if (grid.brickIndexArray.size() > 0)
+		{
+			float brickSize = grid.voxelSize * RCU_OCCUPANCY_BRICK_SIZE;
+			bento::Vector3 gridMax = { grid.origin.x + grid.brickResolution[0] * brickSize, grid.origin.y + grid.brickResolution[1] * brickSize, grid.origin.z + grid.brickResolution[2] * brickSize };
+			float tNear, tFar;
+			if (clip_segment(origin, direction, lastExit, tmax, grid.origin, gridMax, tNear, tFar))
+			{
+				float tHit;
+				bento::Vector3 end = origin + direction * tFar;
+				if (first_occupied_voxel(grid, end, direction * -1.0f, tFar - tNear, tHit))
+				{
+					occupied = true;
+					lastExit = fmaxf(lastExit, tFar - tHit);
+				}
+			}
+		}
+		if (!occupied)
+			return false;
+
+		// Keep a margin so the hits on the last voxel face are not cut
+		float margin = grid.voxelSize * RCU_OCCUPANCY_MARGIN / fmaxf(bento::length(direction), FLT_MIN) + fabsf(lastExit) * 1e-5f;
+		tmax = fminf(tmax, lastExit + margin);
+		return true;
+	}
+}
@@ -0,0 +1,435 @@
+// sdk includes
+#include "rcu_spatial/shape_cast.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+
+// External includes
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+namespace rcu
+{
+	// Number of Newton steps of a capsule sweep against a triangle, past it the contact is only kept within the relaxed tolerance
+	#define RCU_CAPSULE_CAST_MAX_STEPS 64
+	#define RCU_CAPSULE_CAST_RELAXED_TOLERANCE 1e-2f
+
+	static inline void fetch_block_triangle(const TTriangleBlock& block, uint32_t laneIdx, bento::Vector3& a, bento::Vector3& b, bento::Vector3& c)
+	{
+		a = { block.vertices[0][laneIdx], block.vertices[1][laneIdx], block.vertices[2][laneIdx] };
+		b = { block.vertices[3][laneIdx], block.vertices[4][laneIdx], block.vertices[5][laneIdx] };
+		c = { block.vertices[6][laneIdx], block.vertices[7][laneIdx], block.vertices[8][laneIdx] };
+	}
+
+	static inline float clamp01(float value)
+	{
+		return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	}
+
+	// Entry distance of the ray in the box grown by extent, returns false if it is not reached before maxDistance
+	static inline bool slab_test(const bento::Vector3& minBound, const bento::Vector3& maxBound, const bento::Vector3& extent, const bento::Vector3& origin, const bento::Vector3& invDirection, float maxDistance, float& entryDistance)
+	{
+		float tx0 = (minBound.x - extent.x - origin.x) * invDirection.x, tx1 = (maxBound.x + extent.x - origin.x) * invDirection.x;
+		float ty0 = (minBound.y - extent.y - origin.y) * invDirection.y, ty1 = (maxBound.y + extent.y - origin.y) * invDirection.y;
+		float tz0 = (minBound.z - extent.z - origin.z) * invDirection.z, tz1 = (maxBound.z + extent.z - origin.z) * invDirection.z;
+		float tNear = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+		float tFar = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), maxDistance));
+		entryDistance = tNear;
+		return tNear <= tFar;
+	}
+
+	// Closest point of a triangle (Ericson, Real-Time Collision Detection 5.1.5)
+	static bento::Vector3 closest_point_triangle(const bento::Vector3& p, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c)
+	{
+		bento::Vector3 ab = b - a, ac = c - a, ap = p - a;
+		float d1 = bento::dot(ab, ap), d2 = bento::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return a;
+
+		bento::Vector3 bp = p - b;
+		float d3 = bento::dot(ab, bp), d4 = bento::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return b;
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return a + ab * (d1 / (d1 - d3));
+
+		bento::Vector3 cp = p - c;
+		float d5 = bento::dot(ab, cp), d6 = bento::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return c;
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return a + ac * (d2 / (d2 - d6));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+			return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+		float denom = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denom) + ac * (vc * denom);
+	}
+
+	// Closest points of two segments (Ericson, Real-Time Collision Detection 5.1.9), returns the squared distance
+	static float closest_points_segments(const bento::Vector3& p1, const bento::Vector3& q1, const bento::Vector3& p2, const bento::Vector3& q2, bento::Vector3& c1, bento::Vector3& c2)
+	{
+		bento::Vector3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+		float a = bento::dot(d1, d1), e = bento::dot(d2, d2), f = bento::dot(d2, r);
+		float s = 0.0f, t = 0.0f;
+		if (a <= FLT_EPSILON && e <= FLT_EPSILON)
+		{
+		}
+		else if (a <= FLT_EPSILON)
+		{
+			t = clamp01(f / e);
+		}
+		else
+		{
+			float c = bento::dot(d1, r);
+			if (e <= FLT_EPSILON)
+			{
+				s = clamp01(-c / a);
+			}
+			else
+			{
+				float b = bento::dot(d1, d2);
+				float denom = a * e - b * b;
+				s = denom != 0.0f ? clamp01((b * f - c * e) / denom) : 0.0f;
+				t = (b * s + f) / e;
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = clamp01(-c / a);
+				}
+				else if (t > 1.0f)
+				{
+					t = 1.0f;
+					s = clamp01((b - c) / a);
+				}
+			}
+		}
+		c1 = p1 + d1 * s;
+		c2 = p2 + d2 * t;
+		return bento::dot(c1 - c2, c1 - c2);
+	}
+
+	static inline bool point_in_triangle(const bento::Vector3& p, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c, const bento::Vector3& normal)
+	{
+		return bento::dot(bento::cross(b - a, p - a), normal) >= 0.0f
+			&& bento::dot(bento::cross(c - b, p - b), normal) >= 0.0f
+			&& bento::dot(bento::cross(a - c, p - c), normal) >= 0.0f;
+	}
+
+	// Closest points of a segment and a triangle, returns the squared distance
+	static float closest_points_segment_triangle(const bento::Vector3& p, const bento::Vector3& q, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c, bento::Vector3& segmentPoint, bento::Vector3& trianglePoint)
+	{
+		// The segment crosses the triangle
+		bento::Vector3 normal = bento::cross(b - a, c - a);
+		float dp = bento::dot(p - a, normal), dq = bento::dot(q - a, normal);
+		if ((dp <= 0.0f && dq >= 0.0f) || (dp >= 0.0f && dq <= 0.0f))
+		{
+			bento::Vector3 crossing = dp != dq ? p + (q - p) * (dp / (dp - dq)) : p;
+			if (point_in_triangle(crossing, a, b, c, normal))
+			{
+				segmentPoint = crossing;
+				trianglePoint = crossing;
+				return 0.0f;
+			}
+		}
+
+		// Otherwise the closest points involve a segment end point or a triangle edge
+		trianglePoint = closest_point_triangle(p, a, b, c);
+		segmentPoint = p;
+		float bestDistanceSq = bento::dot(p - trianglePoint, p - trianglePoint);
+
+		bento::Vector3 candidate = closest_point_triangle(q, a, b, c);
+		float distanceSq = bento::dot(q - candidate, q - candidate);
+		if (distanceSq < bestDistanceSq)
+		{
+			bestDistanceSq = distanceSq;
+			segmentPoint = q;
+			trianglePoint = candidate;
+		}
+
+		const bento::Vector3 edges[3][2] = { { a, b }, { b, c }, { c, a } };
+		for (uint32_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+		{
+			bento::Vector3 onSegment, onEdge;
+			distanceSq = closest_points_segments(p, q, edges[edgeIdx][0], edges[edgeIdx][1], onSegment, onEdge);
+			if (distanceSq < bestDistanceSq)
+			{
+				bestDistanceSq = distanceSq;
+				segmentPoint = onSegment;
+				trianglePoint = onEdge;
+			}
+		}
+		return bestDistanceSq;
+	}
+
+	// Exact time of impact of a sphere moving along a normalized direction against a triangle
+	static bool sweep_sphere_triangle(const bento::Vector3& center, const bento::Vector3& direction, float radius, float maxDistance, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c, float& distance, bento::Vector3& contact)
+	{
+		float radiusSq = radius * radius;
+
+		// Already touching
+		bento::Vector3 closest = closest_point_triangle(center, a, b, c);
+		if (bento::dot(center - closest, center - closest) <= radiusSq)
+		{
+			distance = 0.0f;
+			contact = closest;
+			return true;
+		}
+
+		// Contact with the interior of the face
+		bento::Vector3 normal = bento::cross(b - a, c - a);
+		float normalLength = bento::length(normal);
+		if (normalLength > 0.0f)
+		{
+			normal = normal * (1.0f / normalLength);
+
+			// Side of the plane the sphere comes from, the winding test below keeps the unflipped normal
+			bento::Vector3 facing = normal;
+			float planeDistance = bento::dot(center - a, normal);
+			if (planeDistance < 0.0f)
+			{
+				facing = -normal;
+				planeDistance = -planeDistance;
+			}
+
+			float approach = -bento::dot(direction, facing);
+			if (approach > 0.0f)
+			{
+				float t = (planeDistance - radius) / approach;
+				bento::Vector3 planePoint = center + direction * t - facing * radius;
+				if (t >= 0.0f && t <= maxDistance && point_in_triangle(planePoint, a, b, c, normal))
+				{
+					distance = t;
+					contact = planePoint;
+					return true;
+				}
+			}
+		}
+
+		// Otherwise the first contact is on an edge or a vertex
+		bool found = false;
+		float bestDistance = maxDistance;
+		const bento::Vector3 vertices[3] = { a, b, c };
+		for (uint32_t vertIdx = 0; vertIdx < 3; ++vertIdx)
+		{
+			bento::Vector3 m = center - vertices[vertIdx];
+			float md = bento::dot(m, direction);
+			float discriminant = md * md - (bento::dot(m, m) - radiusSq);
+			if (discriminant < 0.0f)
+				continue;
+
+			float t = -md - sqrtf(discriminant);
+			if (t >= 0.0f && t <= bestDistance)
+			{
+				bestDistance = t;
+				contact = vertices[vertIdx];
+				found = true;
+			}
+		}
+
+		for (uint32_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+		{
+			const bento::Vector3& e0 = vertices[edgeIdx];
+			bento::Vector3 edge = vertices[(edgeIdx + 1) % 3] - e0;
+			bento::Vector3 m = center - e0;
+			float ee = bento::dot(edge, edge), ed = bento::dot(edge, direction), em = bento::dot(edge, m);
+
+			// Ray against the infinite cylinder around the edge, parallel motions are handled by the vertices
+			float qa = ee - ed * ed;
+			if (qa <= FLT_EPSILON * ee)
+				continue;
+			float qb = ee * bento::dot(m, direction) - em * ed;
+			float qc = ee * (bento::dot(m, m) - radiusSq) - em * em;
+			float discriminant = qb * qb - qa * qc;
+			if (discriminant < 0.0f)
+				continue;
+
+			float t = (-qb - sqrtf(discriminant)) / qa;
+			float s = (em + ed * t) / ee;
+			if (t >= 0.0f && t <= bestDistance && s >= 0.0f && s <= 1.0f)
+			{
+				bestDistance = t;
+				contact = e0 + edge * s;
+				found = true;
+			}
+		}
+
+		distance = bestDistance;
+		return found;
+	}
+
+	// Time of impact of a capsule moving along a normalized direction against a triangle. The gap is a convex function of the
+	// travelled distance (distance from the motion to the Minkowski difference of two convex shapes), so a Newton step that uses its
+	// slope never passes the first contact and a gap that stops shrinking means the capsule is moving away for good.
+	static bool sweep_capsule_triangle(const bento::Vector3& pointA, const bento::Vector3& pointB, const bento::Vector3& direction, float radius, float maxDistance, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c, float& distance, bento::Vector3& contact, bento::Vector3& segmentContact)
+	{
+		const float tolerance = 1e-4f * (1.0f + radius);
+		float t = 0.0f;
+		for (uint32_t stepIdx = 0; stepIdx < RCU_CAPSULE_CAST_MAX_STEPS; ++stepIdx)
+		{
+			bento::Vector3 offset = direction * t;
+			float distanceSq = closest_points_segment_triangle(pointA + offset, pointB + offset, a, b, c, segmentContact, contact);
+			float separation = sqrtf(distanceSq);
+			float gap = separation - radius;
+			if (gap <= tolerance)
+			{
+				distance = t;
+				return true;
+			}
+
+			// Rate at which the gap closes, the grazing motions close it slowly but the step grows accordingly
+			float closingSpeed = -bento::dot(segmentContact - contact, direction) / separation;
+			if (closingSpeed <= 0.0f)
+				return false;
+			t += gap / closingSpeed;
+			if (t > maxDistance)
+				return false;
+		}
+
+		// Still closing in (or stalled by the float precision), the contact is only reported if the capsule ended up touching it
+		bento::Vector3 offset = direction * t;
+		float gap = sqrtf(closest_points_segment_triangle(pointA + offset, pointB + offset, a, b, c, segmentContact, contact)) - radius;
+		if (gap > RCU_CAPSULE_CAST_RELAXED_TOLERANCE * (1.0f + radius))
+			return false;
+		distance = t;
+		return true;
+	}
+
+	static inline bento::Vector3 contact_normal(const bento::Vector3& shapePoint, const bento::Vector3& contact, const bento::Vector3& direction)
+	{
+		bento::Vector3 separation = shapePoint - contact;
+		float separationLength = bento::length(separation);
+		return separationLength > FLT_EPSILON ? separation * (1.0f / separationLength) : -direction;
+	}
+
+	static inline bento::Vector3 safe_inverse(const bento::Vector3& direction)
+	{
+		return { 1.0f / (direction.x != 0.0f ? direction.x : 1e-30f), 1.0f / (direction.y != 0.0f ? direction.y : 1e-30f), 1.0f / (direction.z != 0.0f ? direction.z : 1e-30f) };
+	}
+
+	// Traverses the nodes grown by extent around the swept center, nearest first, and calls the triangle sweep on the leaves
+	template<typename TTriangleSweep>
+	static bool sweep_bvh(const TTriangleBVH& bvh, const bento::Vector3& center, const bento::Vector3& direction, const bento::Vector3& extent, float maxDistance, TBVHSweepHit& sweepHit, const TTriangleSweep& triangleSweep)
+	{
+		if (bvh.nodeArray.size() == 0)
+			return false;
+
+		bento::Vector3 invDirection = safe_inverse(direction);
+		float bestDistance = maxDistance;
+		bool found = false;
+
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const TBVHNode& node = bvh.nodeArray[stack[--stackSize]];
+			float entryDistance;
+			if (!slab_test(node.minBound, node.maxBound, extent, center, invDirection, bestDistance, entryDistance))
+				continue;
+
+			if (node.numTriangles == 0)
+			{
+				uint32_t nearIdx = node.childOrBlock, farIdx = node.childOrBlock + 1;
+				float nearDistance, farDistance;
+				bool nearHit = slab_test(bvh.nodeArray[nearIdx].minBound, bvh.nodeArray[nearIdx].maxBound, extent, center, invDirection, bestDistance, nearDistance);
+				bool farHit = slab_test(bvh.nodeArray[farIdx].minBound, bvh.nodeArray[farIdx].maxBound, extent, center, invDirection, bestDistance, farDistance);
+				if (farHit && (!nearHit || farDistance < nearDistance))
+				{
+					std::swap(nearIdx, farIdx);
+					std::swap(nearHit, farHit);
+				}
+				if (farHit)
+					stack[stackSize++] = farIdx;
+				if (nearHit)
+					stack[stackSize++] = nearIdx;
+				continue;
+			}
+
+			const TTriangleBlock& block = bvh.blockArray[node.childOrBlock];
+			for (uint32_t laneIdx = 0; laneIdx < node.numTriangles; ++laneIdx)
+			{
+				bento::Vector3 a, b, c;
+				fetch_block_triangle(block, laneIdx, a, b, c);
+
+				// Cheap rejection on the bounds of the triangle
+				bento::Vector3 triMin = { std::min(a.x, std::min(b.x, c.x)), std::min(a.y, std::min(b.y, c.y)), std::min(a.z, std::min(b.z, c.z)) };
+				bento::Vector3 triMax = { std::max(a.x, std::max(b.x, c.x)), std::max(a.y, std::max(b.y, c.y)), std::max(a.z, std::max(b.z, c.z)) };
+				float entryDistance;
+				if (!slab_test(triMin, triMax, extent, center, invDirection, bestDistance, entryDistance))
+					continue;
+
+				float distance;
+				bento::Vector3 contact, normal;
+				if (triangleSweep(bestDistance, a, b, c, distance, contact, normal) && (!found || distance < bestDistance))
+				{
+					bestDistance = distance;
+					found = true;
+					sweepHit.distance = distance;
+					sweepHit.geometryIndex = block.geometryIndex[laneIdx];
+					sweepHit.triangleIndex = block.triangleIndex[laneIdx];
+					sweepHit.position = contact;
+					sweepHit.normal = normal;
+				}
+			}
+		}
+		return found;
+	}
+
+	static inline bento::Vector3 cast_direction(const bento::Vector3& direction, float& maxDistance)
+	{
+		// A null direction only tests the initial position
+		float directionLength = bento::length(direction);
+		if (directionLength <= FLT_EPSILON)
+		{
+			maxDistance = 0.0f;
+			return { 0.0f, 0.0f, 1.0f };
+		}
+		return direction * (1.0f / directionLength);
+	}
+
+	bool bvh_sweep_sphere(const TTriangleBVH& bvh, const TSphereCast& sphereCast, TBVHSweepHit& sweepHit)
+	{
+		float maxDistance = sphereCast.maxDistance;
+		bento::Vector3 direction = cast_direction(sphereCast.direction, maxDistance);
+		const bento::Vector3& center = sphereCast.origin;
+		float radius = sphereCast.radius;
+		bento::Vector3 extent = { radius, radius, radius };
+		return sweep_bvh(bvh, center, direction, extent, maxDistance, sweepHit,
+			[&](float currentDistance, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c, float& distance, bento::Vector3& contact, bento::Vector3& normal)
+			{
+				if (!sweep_sphere_triangle(center, direction, radius, currentDistance, a, b, c, distance, contact))
+					return false;
+				normal = contact_normal(center + direction * distance, contact, direction);
+				return true;
+			});
+	}
+
+	bool bvh_sweep_capsule(const TTriangleBVH& bvh, const TCapsuleCast& capsuleCast, TBVHSweepHit& sweepHit)
+	{
+		float maxDistance = capsuleCast.maxDistance;
+		bento::Vector3 direction = cast_direction(capsuleCast.direction, maxDistance);
+		const bento::Vector3& pointA = capsuleCast.pointA;
+		const bento::Vector3& pointB = capsuleCast.pointB;
+		float radius = capsuleCast.radius;
+		bento::Vector3 center = (pointA + pointB) * 0.5f;
+		bento::Vector3 halfAxis = (pointB - pointA) * 0.5f;
+		bento::Vector3 extent = { fabsf(halfAxis.x) + radius, fabsf(halfAxis.y) + radius, fabsf(halfAxis.z) + radius };
+		return sweep_bvh(bvh, center, direction, extent, maxDistance, sweepHit,
+			[&](float currentDistance, const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c, float& distance, bento::Vector3& contact, bento::Vector3& normal)
+			{
+				bento::Vector3 segmentContact;
+				if (!sweep_capsule_triangle(pointA, pointB, direction, radius, currentDistance, a, b, c, distance, contact, segmentContact))
+					return false;
+				normal = contact_normal(segmentContact, contact, direction);
+				return true;
+			});
+	}
+}
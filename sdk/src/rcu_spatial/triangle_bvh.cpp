@@ -0,0 +1,663 @@
+// sdk includes
+#include "rcu_spatial/triangle_bvh.h"
+
+// bento includes
+#include <bento_math/vector3.h>
+#include <bento_math/matrix4.h>
+
+// External includes
+#include <xmmintrin.h>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+namespace rcu
+{
+	// Reference to a triangle used during the build
+	struct TTriangleReference
+	{
+		uint32_t geometryIndex;
+		uint32_t triangleIndex;
+		bento::Vector3 minBound;
+		bento::Vector3 maxBound;
+		bento::Vector3 centroid;
+	};
+
+	TTriangleBVH::TTriangleBVH(bento::IAllocator& allocator)
+	: _allocator(allocator)
+	, nodeArray(allocator)
+	, blockArray(allocator)
+	, geometryBoundsArray(allocator)
+	, geometryNodeArray(allocator)
+	, geometryIndexArray(allocator)
+	{
+	}
+
+	static inline void fetch_triangle(const TScene& scene, uint32_t geometryIndex, uint32_t triangleIndex, bento::Vector3& a, bento::Vector3& b, bento::Vector3& c)
+	{
+		const TGeometry& geometry = scene.geometryArray[geometryIndex];
+		const bento::IVector3& face = geometry.indexArray[triangleIndex];
+		a = geometry.vertexArray[face.x];
+		b = geometry.vertexArray[face.y];
+		c = geometry.vertexArray[face.z];
+
+		// The hierarchy is built in world space
+		if (geometry.instanced)
+		{
+			a = geometry.transform * a;
+			b = geometry.transform * b;
+			c = geometry.transform * c;
+		}
+	}
+
+	static inline bento::Vector3 min3(const bento::Vector3& a, const bento::Vector3& b)
+	{
+		return { a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z };
+	}
+
+	static inline bento::Vector3 max3(const bento::Vector3& a, const bento::Vector3& b)
+	{
+		return { a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z };
+	}
+
+	static void fill_block(const TScene& scene, const TTriangleReference* referenceArray, uint32_t numReferences, TTriangleBlock& block)
+	{
+		for (uint32_t laneIdx = 0; laneIdx < RCU_BVH_BLOCK_SIZE; ++laneIdx)
+		{
+			const TTriangleReference& reference = referenceArray[laneIdx < numReferences ? laneIdx : numReferences - 1];
+			bento::Vector3 a, b, c;
+			fetch_triangle(scene, reference.geometryIndex, reference.triangleIndex, a, b, c);
+			block.vertices[0][laneIdx] = a.x; block.vertices[1][laneIdx] = a.y; block.vertices[2][laneIdx] = a.z;
+			block.vertices[3][laneIdx] = b.x; block.vertices[4][laneIdx] = b.y; block.vertices[5][laneIdx] = b.z;
+			block.vertices[6][laneIdx] = c.x; block.vertices[7][laneIdx] = c.y; block.vertices[8][laneIdx] = c.z;
+			block.geometryIndex[laneIdx] = reference.geometryIndex;
+			block.triangleIndex[laneIdx] = reference.triangleIndex;
+		}
+	}
+
+	static void build_node(const TScene& scene, TTriangleBVH& bvh, uint32_t nodeIdx, TTriangleReference* referenceArray, uint32_t numReferences)
+	{
+		// Compute the bounds of the node and of the centroids
+		bento::Vector3 minBound = referenceArray[0].minBound, maxBound = referenceArray[0].maxBound;
+		bento::Vector3 minCentroid = referenceArray[0].centroid, maxCentroid = referenceArray[0].centroid;
+		for (uint32_t refIdx = 1; refIdx < numReferences; ++refIdx)
+		{
+			minBound = min3(minBound, referenceArray[refIdx].minBound);
+			maxBound = max3(maxBound, referenceArray[refIdx].maxBound);
+			minCentroid = min3(minCentroid, referenceArray[refIdx].centroid);
+			maxCentroid = max3(maxCentroid, referenceArray[refIdx].centroid);
+		}
+		bvh.nodeArray[nodeIdx].minBound = minBound;
+		bvh.nodeArray[nodeIdx].maxBound = maxBound;
+
+		// Small enough to fit a block
+		if (numReferences <= RCU_BVH_BLOCK_SIZE)
+		{
+			uint32_t blockIdx = bvh.blockArray.size();
+			fill_block(scene, referenceArray, numReferences, bvh.blockArray.extend());
+			bvh.nodeArray[nodeIdx].childOrBlock = blockIdx;
+			bvh.nodeArray[nodeIdx].numTriangles = numReferences;
+			return;
+		}
+
+		// Median split along the largest centroid extent
+		bento::Vector3 extent = maxCentroid - minCentroid;
+		uint32_t axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+		uint32_t numLeft = numReferences / 2;
+		std::nth_element(referenceArray, referenceArray + numLeft, referenceArray + numReferences, [axis](const TTriangleReference& r0, const TTriangleReference& r1)
+		{
+			return (&r0.centroid.x)[axis] < (&r1.centroid.x)[axis];
+		});
+
+		// Allocate both children next to each other
+		uint32_t childIdx = bvh.nodeArray.size();
+		bvh.nodeArray.extend();
+		bvh.nodeArray.extend();
+		bvh.nodeArray[nodeIdx].childOrBlock = childIdx;
+		bvh.nodeArray[nodeIdx].numTriangles = 0;
+
+		build_node(scene, bvh, childIdx, referenceArray, numLeft);
+		build_node(scene, bvh, childIdx + 1, referenceArray + numLeft, numReferences - numLeft);
+	}
+
+	static void build_geometry_node(TTriangleBVH& bvh, uint32_t nodeIdx, uint32_t* indexArray, uint32_t numIndices)
+	{
+		// Compute the bounds of the node and of the geometry centers
+		const TBoxQuery& firstBounds = bvh.geometryBoundsArray[indexArray[0]];
+		bento::Vector3 minBound = firstBounds.minBound, maxBound = firstBounds.maxBound;
+		bento::Vector3 minCenter = (firstBounds.minBound + firstBounds.maxBound) * 0.5f, maxCenter = minCenter;
+		for (uint32_t idx = 1; idx < numIndices; ++idx)
+		{
+			const TBoxQuery& geometryBounds = bvh.geometryBoundsArray[indexArray[idx]];
+			bento::Vector3 center = (geometryBounds.minBound + geometryBounds.maxBound) * 0.5f;
+			minBound = min3(minBound, geometryBounds.minBound);
+			maxBound = max3(maxBound, geometryBounds.maxBound);
+			minCenter = min3(minCenter, center);
+			maxCenter = max3(maxCenter, center);
+		}
+		bvh.geometryNodeArray[nodeIdx].minBound = minBound;
+		bvh.geometryNodeArray[nodeIdx].maxBound = maxBound;
+
+		if (numIndices <= RCU_BVH_BLOCK_SIZE)
+		{
+			bvh.geometryNodeArray[nodeIdx].childOrBlock = (uint32_t)(indexArray - bvh.geometryIndexArray.begin());
+			bvh.geometryNodeArray[nodeIdx].numTriangles = numIndices;
+			return;
+		}
+
+		// Median split along the largest center extent
+		bento::Vector3 extent = maxCenter - minCenter;
+		uint32_t axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+		uint32_t numLeft = numIndices / 2;
+		const TBoxQuery* boundsArray = bvh.geometryBoundsArray.begin();
+		std::nth_element(indexArray, indexArray + numLeft, indexArray + numIndices, [boundsArray, axis](uint32_t g0, uint32_t g1)
+		{
+			return (&boundsArray[g0].minBound.x)[axis] + (&boundsArray[g0].maxBound.x)[axis] < (&boundsArray[g1].minBound.x)[axis] + (&boundsArray[g1].maxBound.x)[axis];
+		});
+
+		uint32_t childIdx = bvh.geometryNodeArray.size();
+		bvh.geometryNodeArray.extend();
+		bvh.geometryNodeArray.extend();
+		bvh.geometryNodeArray[nodeIdx].childOrBlock = childIdx;
+		bvh.geometryNodeArray[nodeIdx].numTriangles = 0;
+
+		build_geometry_node(bvh, childIdx, indexArray, numLeft);
+		build_geometry_node(bvh, childIdx + 1, indexArray + numLeft, numIndices - numLeft);
+	}
+
+	void build_triangle_bvh(const TScene& scene, TTriangleBVH& bvh)
+	{
+		bvh.nodeArray.clear();
+		bvh.blockArray.clear();
+		bvh.geometryBoundsArray.clear();
+		bvh.geometryNodeArray.clear();
+		bvh.geometryIndexArray.clear();
+
+		// Gather all the triangles
+		uint32_t numTriangles = 0;
+		uint32_t numGeometries = scene.geometryArray.size();
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+			numTriangles += scene.geometryArray[geoIdx].indexArray.size();
+		if (numTriangles == 0)
+			return;
+
+		bento::Vector<TTriangleReference> referenceArray(bvh._allocator);
+		referenceArray.resize(numTriangles);
+		bvh.geometryBoundsArray.resize(numGeometries);
+		uint32_t refIdx = 0;
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			TBoxQuery& geometryBounds = bvh.geometryBoundsArray[geoIdx];
+			geometryBounds.minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+			geometryBounds.maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+			uint32_t numGeoTriangles = scene.geometryArray[geoIdx].indexArray.size();
+			for (uint32_t triIdx = 0; triIdx < numGeoTriangles; ++triIdx)
+			{
+				TTriangleReference& reference = referenceArray[refIdx++];
+				bento::Vector3 a, b, c;
+				fetch_triangle(scene, geoIdx, triIdx, a, b, c);
+				reference.geometryIndex = geoIdx;
+				reference.triangleIndex = triIdx;
+				reference.minBound = min3(a, min3(b, c));
+				reference.maxBound = max3(a, max3(b, c));
+				reference.centroid = (reference.minBound + reference.maxBound) * 0.5f;
+				geometryBounds.minBound = min3(geometryBounds.minBound, reference.minBound);
+				geometryBounds.maxBound = max3(geometryBounds.maxBound, reference.maxBound);
+			}
+		}
+
+		// Build the hierarchy from the root
+		bvh.nodeArray.extend();
+		build_node(scene, bvh, 0, referenceArray.begin(), numTriangles);
+
+		// The geometry overlaps traverse their own hierarchy, the empty geometries can never overlap anything
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			if (scene.geometryArray[geoIdx].indexArray.size() > 0)
+				bvh.geometryIndexArray.push_back(geoIdx);
+		}
+		bvh.geometryNodeArray.extend();
+		build_geometry_node(bvh, 0, bvh.geometryIndexArray.begin(), bvh.geometryIndexArray.size());
+	}
+
+	static void geometry_bounds(const TScene& scene, uint32_t geometryIndex, TBoxQuery& geometryBounds)
+	{
+		geometryBounds.minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+		geometryBounds.maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t numTriangles = scene.geometryArray[geometryIndex].indexArray.size();
+		for (uint32_t triIdx = 0; triIdx < numTriangles; ++triIdx)
+		{
+			bento::Vector3 a, b, c;
+			fetch_triangle(scene, geometryIndex, triIdx, a, b, c);
+			geometryBounds.minBound = min3(geometryBounds.minBound, min3(a, min3(b, c)));
+			geometryBounds.maxBound = max3(geometryBounds.maxBound, max3(a, max3(b, c)));
+		}
+	}
+
+	void refit_triangle_bvh(const TScene& scene, const uint8_t* dirtyGeometryArray, TTriangleBVH& bvh)
+	{
+		uint32_t numGeometries = bvh.geometryBoundsArray.size();
+		for (uint32_t geoIdx = 0; geoIdx < numGeometries; ++geoIdx)
+		{
+			if (dirtyGeometryArray[geoIdx])
+				geometry_bounds(scene, geoIdx, bvh.geometryBoundsArray[geoIdx]);
+		}
+
+		// Children are always allocated after their parent, walking the nodes backwards visits the leaves first
+		for (uint32_t nodeIdx = bvh.nodeArray.size(); nodeIdx-- > 0;)
+		{
+			TBVHNode& node = bvh.nodeArray[nodeIdx];
+			if (node.numTriangles == 0)
+			{
+				const TBVHNode& left = bvh.nodeArray[node.childOrBlock];
+				const TBVHNode& right = bvh.nodeArray[node.childOrBlock + 1];
+				node.minBound = min3(left.minBound, right.minBound);
+				node.maxBound = max3(left.maxBound, right.maxBound);
+				continue;
+			}
+
+			TTriangleBlock& block = bvh.blockArray[node.childOrBlock];
+			node.minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+			node.maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (uint32_t laneIdx = 0; laneIdx < RCU_BVH_BLOCK_SIZE; ++laneIdx)
+			{
+				bento::Vector3 a, b, c;
+				if (dirtyGeometryArray[block.geometryIndex[laneIdx]])
+				{
+					fetch_triangle(scene, block.geometryIndex[laneIdx], block.triangleIndex[laneIdx], a, b, c);
+					block.vertices[0][laneIdx] = a.x; block.vertices[1][laneIdx] = a.y; block.vertices[2][laneIdx] = a.z;
+					block.vertices[3][laneIdx] = b.x; block.vertices[4][laneIdx] = b.y; block.vertices[5][laneIdx] = b.z;
+					block.vertices[6][laneIdx] = c.x; block.vertices[7][laneIdx] = c.y; block.vertices[8][laneIdx] = c.z;
+				}
+				else
+				{
+					a = { block.vertices[0][laneIdx], block.vertices[1][laneIdx], block.vertices[2][laneIdx] };
+					b = { block.vertices[3][laneIdx], block.vertices[4][laneIdx], block.vertices[5][laneIdx] };
+					c = { block.vertices[6][laneIdx], block.vertices[7][laneIdx], block.vertices[8][laneIdx] };
+				}
+				node.minBound = min3(node.minBound, min3(a, min3(b, c)));
+				node.maxBound = max3(node.maxBound, max3(a, max3(b, c)));
+			}
+		}
+
+		// Same for the geometry hierarchy, its leaves take the refreshed geometry bounds
+		for (uint32_t nodeIdx = bvh.geometryNodeArray.size(); nodeIdx-- > 0;)
+		{
+			TBVHNode& node = bvh.geometryNodeArray[nodeIdx];
+			if (node.numTriangles == 0)
+			{
+				const TBVHNode& left = bvh.geometryNodeArray[node.childOrBlock];
+				const TBVHNode& right = bvh.geometryNodeArray[node.childOrBlock + 1];
+				node.minBound = min3(left.minBound, right.minBound);
+				node.maxBound = max3(left.maxBound, right.maxBound);
+				continue;
+			}
+
+			node.minBound = { FLT_MAX, FLT_MAX, FLT_MAX };
+			node.maxBound = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for (uint32_t idx = 0; idx < node.numTriangles; ++idx)
+			{
+				const TBoxQuery& geometryBounds = bvh.geometryBoundsArray[bvh.geometryIndexArray[node.childOrBlock + idx]];
+				node.minBound = min3(node.minBound, geometryBounds.minBound);
+				node.maxBound = max3(node.maxBound, geometryBounds.maxBound);
+			}
+		}
+	}
+
+	static inline float box_distance_sq(const TBVHNode& node, const bento::Vector3& point)
+	{
+		float dx = point.x < node.minBound.x ? node.minBound.x - point.x : (point.x > node.maxBound.x ? point.x - node.maxBound.x : 0.0f);
+		float dy = point.y < node.minBound.y ? node.minBound.y - point.y : (point.y > node.maxBound.y ? point.y - node.maxBound.y : 0.0f);
+		float dz = point.z < node.minBound.z ? node.minBound.z - point.z : (point.z > node.maxBound.z ? point.z - node.maxBound.z : 0.0f);
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// Closest point of the four triangles of a block to p (Ericson, Real-Time Collision Detection 5.1.5), evaluated for all the
+	// Voronoi regions at once. Outputs the barycentric weights of b and c and the squared distances. The zero area triangles divide by
+	// zero, their distance is set to infinity so that they are never the closest nor overlapping.
+	static inline void block_closest_point(const TTriangleBlock& block, __m128 px, __m128 py, __m128 pz, __m128& outV, __m128& outW, __m128& outDistanceSq)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		__m128 ax = _mm_loadu_ps(block.vertices[0]), ay = _mm_loadu_ps(block.vertices[1]), az = _mm_loadu_ps(block.vertices[2]);
+		__m128 bx = _mm_loadu_ps(block.vertices[3]), by = _mm_loadu_ps(block.vertices[4]), bz = _mm_loadu_ps(block.vertices[5]);
+		__m128 cx = _mm_loadu_ps(block.vertices[6]), cy = _mm_loadu_ps(block.vertices[7]), cz = _mm_loadu_ps(block.vertices[8]);
+
+		__m128 abx = _mm_sub_ps(bx, ax), aby = _mm_sub_ps(by, ay), abz = _mm_sub_ps(bz, az);
+		__m128 acx = _mm_sub_ps(cx, ax), acy = _mm_sub_ps(cy, ay), acz = _mm_sub_ps(cz, az);
+		#define RCU_DOT3(x0, y0, z0, x1, y1, z1) _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x1), _mm_mul_ps(y0, y1)), _mm_mul_ps(z0, z1))
+
+		__m128 apx = _mm_sub_ps(px, ax), apy = _mm_sub_ps(py, ay), apz = _mm_sub_ps(pz, az);
+		__m128 d1 = RCU_DOT3(abx, aby, abz, apx, apy, apz);
+		__m128 d2 = RCU_DOT3(acx, acy, acz, apx, apy, apz);
+		__m128 bpx = _mm_sub_ps(px, bx), bpy = _mm_sub_ps(py, by), bpz = _mm_sub_ps(pz, bz);
+		__m128 d3 = RCU_DOT3(abx, aby, abz, bpx, bpy, bpz);
+		__m128 d4 = RCU_DOT3(acx, acy, acz, bpx, bpy, bpz);
+		__m128 cpx = _mm_sub_ps(px, cx), cpy = _mm_sub_ps(py, cy), cpz = _mm_sub_ps(pz, cz);
+		__m128 d5 = RCU_DOT3(abx, aby, abz, cpx, cpy, cpz);
+		__m128 d6 = RCU_DOT3(acx, acy, acz, cpx, cpy, cpz);
+
+		__m128 va = _mm_sub_ps(_mm_mul_ps(d3, d6), _mm_mul_ps(d5, d4));
+		__m128 vb = _mm_sub_ps(_mm_mul_ps(d5, d2), _mm_mul_ps(d1, d6));
+		__m128 vc = _mm_sub_ps(_mm_mul_ps(d1, d4), _mm_mul_ps(d3, d2));
+
+		// Face region
+		__m128 denom = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(va, vb), vc));
+		__m128 v = _mm_mul_ps(vb, denom);
+		__m128 w = _mm_mul_ps(vc, denom);
+
+		// The regions are applied from the last to the first test so that the first matching one wins
+		__m128 d43 = _mm_sub_ps(d4, d3), d56 = _mm_sub_ps(d5, d6);
+		__m128 maskBC = _mm_and_ps(_mm_cmple_ps(va, zero), _mm_and_ps(_mm_cmpge_ps(d43, zero), _mm_cmpge_ps(d56, zero)));
+		__m128 wBC = _mm_div_ps(d43, _mm_add_ps(d43, d56));
+		v = select_ps(maskBC, _mm_sub_ps(one, wBC), v);
+		w = select_ps(maskBC, wBC, w);
+
+		__m128 maskAC = _mm_and_ps(_mm_cmple_ps(vb, zero), _mm_and_ps(_mm_cmpge_ps(d2, zero), _mm_cmple_ps(d6, zero)));
+		v = select_ps(maskAC, zero, v);
+		w = select_ps(maskAC, _mm_div_ps(d2, _mm_sub_ps(d2, d6)), w);
+
+		__m128 maskC = _mm_and_ps(_mm_cmpge_ps(d6, zero), _mm_cmple_ps(d5, d6));
+		v = select_ps(maskC, zero, v);
+		w = select_ps(maskC, one, w);
+
+		__m128 maskAB = _mm_and_ps(_mm_cmple_ps(vc, zero), _mm_and_ps(_mm_cmpge_ps(d1, zero), _mm_cmple_ps(d3, zero)));
+		v = select_ps(maskAB, _mm_div_ps(d1, _mm_sub_ps(d1, d3)), v);
+		w = select_ps(maskAB, zero, w);
+
+		__m128 maskB = _mm_and_ps(_mm_cmpge_ps(d3, zero), _mm_cmple_ps(d4, d3));
+		v = select_ps(maskB, one, v);
+		w = select_ps(maskB, zero, w);
+
+		__m128 maskA = _mm_and_ps(_mm_cmple_ps(d1, zero), _mm_cmple_ps(d2, zero));
+		v = select_ps(maskA, zero, v);
+		w = select_ps(maskA, zero, w);
+
+		// Distance to the closest point
+		__m128 qx = _mm_add_ps(ax, _mm_add_ps(_mm_mul_ps(abx, v), _mm_mul_ps(acx, w)));
+		__m128 qy = _mm_add_ps(ay, _mm_add_ps(_mm_mul_ps(aby, v), _mm_mul_ps(acy, w)));
+		__m128 qz = _mm_add_ps(az, _mm_add_ps(_mm_mul_ps(abz, v), _mm_mul_ps(acz, w)));
+		__m128 dx = _mm_sub_ps(px, qx), dy = _mm_sub_ps(py, qy), dz = _mm_sub_ps(pz, qz);
+		outDistanceSq = RCU_DOT3(dx, dy, dz, dx, dy, dz);
+
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(aby, acz), _mm_mul_ps(abz, acy));
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(abz, acx), _mm_mul_ps(abx, acz));
+		__m128 nz = _mm_sub_ps(_mm_mul_ps(abx, acy), _mm_mul_ps(aby, acx));
+		__m128 valid = _mm_and_ps(_mm_cmpgt_ps(RCU_DOT3(nx, ny, nz, nx, ny, nz), zero), _mm_cmpord_ps(outDistanceSq, outDistanceSq));
+		outDistanceSq = select_ps(valid, outDistanceSq, _mm_set1_ps(INFINITY));
+		outV = v;
+		outW = w;
+		#undef RCU_DOT3
+	}
+
+	bool bvh_closest_point(const TTriangleBVH& bvh, const bento::Vector3& point, float maxDistance, TBVHClosestHit& closestHit)
+	{
+		if (bvh.nodeArray.size() == 0)
+			return false;
+
+		float bestDistanceSq = maxDistance * maxDistance;
+		bool found = false;
+		__m128 px = _mm_set1_ps(point.x), py = _mm_set1_ps(point.y), pz = _mm_set1_ps(point.z);
+
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const TBVHNode& node = bvh.nodeArray[stack[--stackSize]];
+			if (box_distance_sq(node, point) > bestDistanceSq)
+				continue;
+
+			if (node.numTriangles == 0)
+			{
+				// Visit the closest child first
+				uint32_t nearIdx = node.childOrBlock, farIdx = node.childOrBlock + 1;
+				float nearDistanceSq = box_distance_sq(bvh.nodeArray[nearIdx], point);
+				float farDistanceSq = box_distance_sq(bvh.nodeArray[farIdx], point);
+				if (farDistanceSq < nearDistanceSq)
+				{
+					std::swap(nearIdx, farIdx);
+					std::swap(nearDistanceSq, farDistanceSq);
+				}
+				if (farDistanceSq <= bestDistanceSq)
+					stack[stackSize++] = farIdx;
+				if (nearDistanceSq <= bestDistanceSq)
+					stack[stackSize++] = nearIdx;
+				continue;
+			}
+
+			// Test the four triangles at once
+			const TTriangleBlock& block = bvh.blockArray[node.childOrBlock];
+			__m128 v, w, distanceSq;
+			block_closest_point(block, px, py, pz, v, w, distanceSq);
+
+			alignas(16) float vArray[4], wArray[4], distanceSqArray[4];
+			_mm_store_ps(vArray, v);
+			_mm_store_ps(wArray, w);
+			_mm_store_ps(distanceSqArray, distanceSq);
+			for (uint32_t laneIdx = 0; laneIdx < node.numTriangles; ++laneIdx)
+			{
+				// Written so that a NaN can never replace the best distance
+				if (!(distanceSqArray[laneIdx] < bestDistanceSq))
+					continue;
+
+				bestDistanceSq = distanceSqArray[laneIdx];
+				found = true;
+				closestHit.distanceSq = bestDistanceSq;
+				closestHit.geometryIndex = block.geometryIndex[laneIdx];
+				closestHit.triangleIndex = block.triangleIndex[laneIdx];
+				closestHit.u = vArray[laneIdx];
+				closestHit.v = wArray[laneIdx];
+				float a = 1.0f - vArray[laneIdx] - wArray[laneIdx];
+				closestHit.position.x = block.vertices[0][laneIdx] * a + block.vertices[3][laneIdx] * vArray[laneIdx] + block.vertices[6][laneIdx] * wArray[laneIdx];
+				closestHit.position.y = block.vertices[1][laneIdx] * a + block.vertices[4][laneIdx] * vArray[laneIdx] + block.vertices[7][laneIdx] * wArray[laneIdx];
+				closestHit.position.z = block.vertices[2][laneIdx] * a + block.vertices[5][laneIdx] * vArray[laneIdx] + block.vertices[8][laneIdx] * wArray[laneIdx];
+			}
+		}
+		return found;
+	}
+
+	static inline bool box_overlaps_box(const bento::Vector3& minBound0, const bento::Vector3& maxBound0, const bento::Vector3& minBound1, const bento::Vector3& maxBound1)
+	{
+		return minBound0.x <= maxBound1.x && maxBound0.x >= minBound1.x
+			&& minBound0.y <= maxBound1.y && maxBound0.y >= minBound1.y
+			&& minBound0.z <= maxBound1.z && maxBound0.z >= minBound1.z;
+	}
+
+	// Separating axis test between a triangle and a box centered on the origin (Akenine-Moller)
+	static bool triangle_overlaps_box(const bento::Vector3& a, const bento::Vector3& b, const bento::Vector3& c, const bento::Vector3& halfExtent)
+	{
+		const bento::Vector3 edges[3] = { b - a, c - b, a - c };
+		const bento::Vector3 axes[3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+
+		// The nine edge cross axis directions
+		for (uint32_t edgeIdx = 0; edgeIdx < 3; ++edgeIdx)
+		{
+			for (uint32_t axisIdx = 0; axisIdx < 3; ++axisIdx)
+			{
+				bento::Vector3 axis = bento::cross(edges[edgeIdx], axes[axisIdx]);
+				float pa = bento::dot(a, axis), pb = bento::dot(b, axis), pc = bento::dot(c, axis);
+				float minProj = pa < pb ? (pa < pc ? pa : pc) : (pb < pc ? pb : pc);
+				float maxProj = pa > pb ? (pa > pc ? pa : pc) : (pb > pc ? pb : pc);
+				float radius = halfExtent.x * fabsf(axis.x) + halfExtent.y * fabsf(axis.y) + halfExtent.z * fabsf(axis.z);
+				if (minProj > radius || maxProj < -radius)
+					return false;
+			}
+		}
+
+		// The box face normals
+		bento::Vector3 triMin = min3(a, min3(b, c)), triMax = max3(a, max3(b, c));
+		if (!box_overlaps_box(triMin, triMax, -halfExtent, halfExtent))
+			return false;
+
+		// The triangle normal
+		bento::Vector3 normal = bento::cross(edges[0], c - a);
+		float distance = bento::dot(normal, a);
+		float radius = halfExtent.x * fabsf(normal.x) + halfExtent.y * fabsf(normal.y) + halfExtent.z * fabsf(normal.z);
+		return fabsf(distance) <= radius;
+	}
+
+	static inline void append_overlap(TBVHOverlap* overlapArray, uint32_t capacity, uint32_t& numOverlaps, uint32_t geometryIndex, uint32_t triangleIndex)
+	{
+		if (numOverlaps < capacity)
+		{
+			overlapArray[numOverlaps].geometryIndex = geometryIndex;
+			overlapArray[numOverlaps].triangleIndex = triangleIndex;
+		}
+		numOverlaps++;
+	}
+
+	uint32_t bvh_overlap_box(const TTriangleBVH& bvh, const TBoxQuery& box, TBVHOverlap* overlapArray, uint32_t capacity)
+	{
+		if (bvh.nodeArray.size() == 0)
+			return 0;
+
+		bento::Vector3 center = (box.minBound + box.maxBound) * 0.5f;
+		bento::Vector3 halfExtent = (box.maxBound - box.minBound) * 0.5f;
+		uint32_t numOverlaps = 0;
+
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const TBVHNode& node = bvh.nodeArray[stack[--stackSize]];
+			if (!box_overlaps_box(node.minBound, node.maxBound, box.minBound, box.maxBound))
+				continue;
+
+			if (node.numTriangles == 0)
+			{
+				stack[stackSize++] = node.childOrBlock + 1;
+				stack[stackSize++] = node.childOrBlock;
+				continue;
+			}
+
+			const TTriangleBlock& block = bvh.blockArray[node.childOrBlock];
+			for (uint32_t laneIdx = 0; laneIdx < node.numTriangles; ++laneIdx)
+			{
+				// Work relative to the box center
+				bento::Vector3 a = { block.vertices[0][laneIdx] - center.x, block.vertices[1][laneIdx] - center.y, block.vertices[2][laneIdx] - center.z };
+				bento::Vector3 b = { block.vertices[3][laneIdx] - center.x, block.vertices[4][laneIdx] - center.y, block.vertices[5][laneIdx] - center.z };
+				bento::Vector3 c = { block.vertices[6][laneIdx] - center.x, block.vertices[7][laneIdx] - center.y, block.vertices[8][laneIdx] - center.z };
+				if (triangle_overlaps_box(a, b, c, halfExtent))
+					append_overlap(overlapArray, capacity, numOverlaps, block.geometryIndex[laneIdx], block.triangleIndex[laneIdx]);
+			}
+		}
+		return numOverlaps;
+	}
+
+	uint32_t bvh_overlap_sphere(const TTriangleBVH& bvh, const TSphereQuery& sphere, TBVHOverlap* overlapArray, uint32_t capacity)
+	{
+		if (bvh.nodeArray.size() == 0)
+			return 0;
+
+		float radiusSq = sphere.radius * sphere.radius;
+		__m128 px = _mm_set1_ps(sphere.center.x), py = _mm_set1_ps(sphere.center.y), pz = _mm_set1_ps(sphere.center.z);
+		uint32_t numOverlaps = 0;
+
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const TBVHNode& node = bvh.nodeArray[stack[--stackSize]];
+			if (box_distance_sq(node, sphere.center) > radiusSq)
+				continue;
+
+			if (node.numTriangles == 0)
+			{
+				stack[stackSize++] = node.childOrBlock + 1;
+				stack[stackSize++] = node.childOrBlock;
+				continue;
+			}
+
+			// A triangle touches the sphere if its closest point is within the radius
+			const TTriangleBlock& block = bvh.blockArray[node.childOrBlock];
+			__m128 v, w, distanceSq;
+			block_closest_point(block, px, py, pz, v, w, distanceSq);
+			int laneMask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_set1_ps(radiusSq)));
+			for (uint32_t laneIdx = 0; laneIdx < node.numTriangles; ++laneIdx)
+			{
+				if (laneMask & (1 << laneIdx))
+					append_overlap(overlapArray, capacity, numOverlaps, block.geometryIndex[laneIdx], block.triangleIndex[laneIdx]);
+			}
+		}
+		return numOverlaps;
+	}
+
+	uint32_t bvh_overlap_box_geometries(const TTriangleBVH& bvh, const TBoxQuery& box, TBVHOverlap* overlapArray, uint32_t capacity)
+	{
+		if (bvh.geometryNodeArray.size() == 0)
+			return 0;
+
+		uint32_t numOverlaps = 0;
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const TBVHNode& node = bvh.geometryNodeArray[stack[--stackSize]];
+			if (!box_overlaps_box(node.minBound, node.maxBound, box.minBound, box.maxBound))
+				continue;
+
+			if (node.numTriangles == 0)
+			{
+				stack[stackSize++] = node.childOrBlock + 1;
+				stack[stackSize++] = node.childOrBlock;
+				continue;
+			}
+
+			for (uint32_t idx = 0; idx < node.numTriangles; ++idx)
+			{
+				uint32_t geoIdx = bvh.geometryIndexArray[node.childOrBlock + idx];
+				const TBoxQuery& geometryBounds = bvh.geometryBoundsArray[geoIdx];
+				if (box_overlaps_box(geometryBounds.minBound, geometryBounds.maxBound, box.minBound, box.maxBound))
+					append_overlap(overlapArray, capacity, numOverlaps, geoIdx, (uint32_t)-1);
+			}
+		}
+		return numOverlaps;
+	}
+
+	uint32_t bvh_overlap_sphere_geometries(const TTriangleBVH& bvh, const TSphereQuery& sphere, TBVHOverlap* overlapArray, uint32_t capacity)
+	{
+		if (bvh.geometryNodeArray.size() == 0)
+			return 0;
+
+		float radiusSq = sphere.radius * sphere.radius;
+		uint32_t numOverlaps = 0;
+		uint32_t stack[64];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const TBVHNode& node = bvh.geometryNodeArray[stack[--stackSize]];
+			if (box_distance_sq(node, sphere.center) > radiusSq)
+				continue;
+
+			if (node.numTriangles == 0)
+			{
+				stack[stackSize++] = node.childOrBlock + 1;
+				stack[stackSize++] = node.childOrBlock;
+				continue;
+			}
+
+			for (uint32_t idx = 0; idx < node.numTriangles; ++idx)
+			{
+				uint32_t geoIdx = bvh.geometryIndexArray[node.childOrBlock + idx];
+				const TBoxQuery& geometryBounds = bvh.geometryBoundsArray[geoIdx];
+				TBVHNode bounds;
+				bounds.minBound = geometryBounds.minBound;
+				bounds.maxBound = geometryBounds.maxBound;
+				if (box_distance_sq(bounds, sphere.center) <= radiusSq)
+					append_overlap(overlapArray, capacity, numOverlaps, geoIdx, (uint32_t)-1);
+			}
+		}
+		return numOverlaps;
+	}
+}
\ No newline at end of file
@@ -5,7 +5,7 @@ using UnityEngine;
 public class RCUCApi
 {
     // Size of the ray data structure
-    public const int RayDataSize = 8;
+    public const int RayDataSize = 9;
 
     // Data of the ray
     public const int RayOriginX = 0;
@@ -16,6 +16,7 @@ public class RCUCApi
     public const int RayDirectionZ = 5;
     public const int RayMinRange = 6;
     public const int RayMaxRange = 7;
+    public const int RayMask = 8;
 
     // Size of the intersection data structure
     public const int IntersectionDataSize = 16;
@@ -38,6 +39,242 @@ public class RCUCApi
     public const int IntersectionTexCoordXIndex = 14;
     public const int IntersectionTexCoordYIndex = 15;
 
+    // Size of the compact hit data structure
+    public const int CompactHitDataSize = 7;
+
+    // Data of the compact hit
+    public const int CompactHitRayIndex = 0;
+    public const int CompactHitDistance = 1;
+    public const int CompactHitGeoIndex = 2;
+    public const int CompactHitSubmeshIndex = 3;
+    public const int CompactHitTriIndex = 4;
+    public const int CompactHitBarycentricUIndex = 5;
+    public const int CompactHitBarycentricVIndex = 6;
+
+    // Attributes of the output layout, each entry of the offset array is a byte offset or -1
+    public const int LayoutAttributeCount = 10;
+    public const int LayoutValidity = 0;
+    public const int LayoutDistance = 1;
+    public const int LayoutGeoIndex = 2;
+    public const int LayoutSubmeshIndex = 3;
+    public const int LayoutTriIndex = 4;
+    public const int LayoutBarycentrics = 5;
+    public const int LayoutPosition = 6;
+    public const int LayoutNormal = 7;
+    public const int LayoutTexCoord = 8;
+    public const int LayoutRayIndex = 9;
+
+    // Size of the hit record data structure
+    public const int HitRecordDataSize = 5;
+
+    // Data of the hit record
+    public const int HitRecordGeometryIndex = 0;
+    public const int HitRecordTriIndex = 1;
+    public const int HitRecordBarycentricUIndex = 2;
+    public const int HitRecordBarycentricVIndex = 3;
+    public const int HitRecordDistance = 4;
+
+    // Attributes that can be requested when resolving records
+    public const uint ResolvePosition = 0x1;
+    public const uint ResolveNormal = 0x2;
+    public const uint ResolveTexCoord = 0x4;
+    public const uint ResolveBarycentrics = 0x8;
+
+    // Size of the point query data structure
+    public const int PointQueryDataSize = 4;
+
+    // Data of the point query
+    public const int PointQueryPositionX = 0;
+    public const int PointQueryPositionY = 1;
+    public const int PointQueryPositionZ = 2;
+    public const int PointQueryMaxDistance = 3;
+
+    // Size of the closest point data structure
+    public const int ClosestPointDataSize = 11;
+
+    // Data of the closest point
+    public const int ClosestPointValidity = 0;
+    public const int ClosestPointDistance = 1;
+    public const int ClosestPointGeoIndex = 2;
+    public const int ClosestPointSubmeshIndex = 3;
+    public const int ClosestPointTriIndex = 4;
+    public const int ClosestPointBarycentricUIndex = 5;
+    public const int ClosestPointBarycentricVIndex = 6;
+    public const int ClosestPointBarycentricWIndex = 7;
+    public const int ClosestPointPositionXIndex = 8;
+    public const int ClosestPointPositionYIndex = 9;
+    public const int ClosestPointPositionZIndex = 10;
+
+    // Size of the overlap query data structures (box min + max, sphere center + radius)
+    public const int BoxQueryDataSize = 6;
+    public const int SphereQueryDataSize = 4;
+
+    // Overlap query modes
+    public const int OverlapModeTriangles = 0;
+    public const int OverlapModeGeometries = 1;
+
+    // Size of the overlap data structure
+    public const int OverlapDataSize = 4;
+
+    // Data of the overlap
+    public const int OverlapQueryIndex = 0;
+    public const int OverlapGeoIndex = 1;
+    public const int OverlapSubmeshIndex = 2;
+    public const int OverlapTriIndex = 3;
+
+    // Size of the shape cast data structures
+    public const int SphereCastDataSize = 8;
+    public const int CapsuleCastDataSize = 11;
+
+    // Data of the sphere cast
+    public const int SphereCastOriginX = 0;
+    public const int SphereCastOriginY = 1;
+    public const int SphereCastOriginZ = 2;
+    public const int SphereCastDirectionX = 3;
+    public const int SphereCastDirectionY = 4;
+    public const int SphereCastDirectionZ = 5;
+    public const int SphereCastRadius = 6;
+    public const int SphereCastMaxDistance = 7;
+
+    // Data of the capsule cast
+    public const int CapsuleCastPointAX = 0;
+    public const int CapsuleCastPointAY = 1;
+    public const int CapsuleCastPointAZ = 2;
+    public const int CapsuleCastPointBX = 3;
+    public const int CapsuleCastPointBY = 4;
+    public const int CapsuleCastPointBZ = 5;
+    public const int CapsuleCastDirectionX = 6;
+    public const int CapsuleCastDirectionY = 7;
+    public const int CapsuleCastDirectionZ = 8;
+    public const int CapsuleCastRadius = 9;
+    public const int CapsuleCastMaxDistance = 10;
+
+    // Size of the shape hit data structure
+    public const int ShapeHitDataSize = 11;
+
+    // Data of the shape hit
+    public const int ShapeHitValidity = 0;
+    public const int ShapeHitDistance = 1;
+    public const int ShapeHitGeoIndex = 2;
+    public const int ShapeHitSubmeshIndex = 3;
+    public const int ShapeHitTriIndex = 4;
+    public const int ShapeHitPositionXIndex = 5;
+    public const int ShapeHitPositionYIndex = 6;
+    public const int ShapeHitPositionZIndex = 7;
+    public const int ShapeHitNormalXIndex = 8;
+    public const int ShapeHitNormalYIndex = 9;
+    public const int ShapeHitNormalZIndex = 10;
+
+    // Analytic primitive types, parameters are (radius), (radius, half height) and (half extents)
+    public const uint PrimitiveTypeSphere = 0;
+    public const uint PrimitiveTypeCapsule = 1;
+    public const uint PrimitiveTypeBox = 2;
+
+    // Parts of the primitives reported as triangle index, box faces are PrimitivePartFirstFace + axis * 2 + (positive ? 1 : 0)
+    public const int PrimitivePartBody = 0;
+    public const int PrimitivePartBottomCap = 1;
+    public const int PrimitivePartTopCap = 2;
+    public const int PrimitivePartFirstFace = 0;
+
+    // Size of the path endpoint data structure, the emitters use the ray data structure
+    public const int PathEndpointDataSize = 12;
+
+    // Data of the path endpoint
+    public const int PathEndpointNumBounces = 0;
+    public const int PathEndpointEscaped = 1;
+    public const int PathEndpointEnergy = 2;
+    public const int PathEndpointDistance = 3;
+    public const int PathEndpointGeoIndex = 4;
+    public const int PathEndpointSubmeshIndex = 5;
+    public const int PathEndpointPositionXIndex = 6;
+    public const int PathEndpointPositionYIndex = 7;
+    public const int PathEndpointPositionZIndex = 8;
+    public const int PathEndpointDirectionXIndex = 9;
+    public const int PathEndpointDirectionYIndex = 10;
+    public const int PathEndpointDirectionZIndex = 11;
+
+    // Size of the occlusion point data structure
+    public const int OcclusionPointDataSize = 6;
+
+    // Data of the occlusion point
+    public const int OcclusionPointPositionX = 0;
+    public const int OcclusionPointPositionY = 1;
+    public const int OcclusionPointPositionZ = 2;
+    public const int OcclusionPointNormalX = 3;
+    public const int OcclusionPointNormalY = 4;
+    public const int OcclusionPointNormalZ = 5;
+
+    // Size of the bake light data structure, the type is stored as the bits of an uint
+    public const int BakeLightDataSize = 5;
+
+    // Data of the bake light
+    public const int BakeLightType = 0;
+    public const int BakeLightVectorX = 1;
+    public const int BakeLightVectorY = 2;
+    public const int BakeLightVectorZ = 3;
+    public const int BakeLightMaxDistance = 4;
+
+    // Bake light types, the vector is a position for the point lights and the direction towards the light for the directional ones
+    public const uint BakeLightTypePoint = 0;
+    public const uint BakeLightTypeDirectional = 1;
+
+    // Values of the visibility atlas
+    public const float BakeTexelVisible = 1.0f;
+    public const float BakeTexelOccluded = 0.0f;
+    public const float BakeTexelUncovered = -1.0f;
+
+    // Number of targets packed in a word of a line of sight row, a row holds (numTargets + LineOfSightWordBits - 1) / LineOfSightWordBits words
+    public const int LineOfSightWordBits = 32;
+
+    // Size of the distance sample data structure
+    public const int DistanceSampleDataSize = 2;
+
+    // Data of the distance sample, the exact distance is within the error of the distance
+    public const int DistanceSampleDistance = 0;
+    public const int DistanceSampleError = 1;
+
+    // Size of the distance hit data structure
+    public const int DistanceHitDataSize = 10;
+
+    // Data of the distance hit, the surface is within the error of the position
+    public const int DistanceHitValidity = 0;
+    public const int DistanceHitDistance = 1;
+    public const int DistanceHitError = 2;
+    public const int DistanceHitClearance = 3;
+    public const int DistanceHitPositionXIndex = 4;
+    public const int DistanceHitPositionYIndex = 5;
+    public const int DistanceHitPositionZIndex = 6;
+    public const int DistanceHitNormalXIndex = 7;
+    public const int DistanceHitNormalYIndex = 8;
+    public const int DistanceHitNormalZIndex = 9;
+
+    // Baked states of a pair of cells of the visibility grid, cells are indexed x + resX * (y + resY * z)
+    public const uint CellVisibilityUnknown = 0;
+    public const uint CellVisibilityHidden = 1;
+    public const uint CellVisibilityVisible = 2;
+    public const uint CellVisibilityPartial = 3;
+
+    // Status of a tile of the tiled world, failed tiles stop the rays until they are requested or evicted
+    public const uint TileStatusUnloaded = 0;
+    public const uint TileStatusQueued = 1;
+    public const uint TileStatusLoading = 2;
+    public const uint TileStatusLoaded = 3;
+    public const uint TileStatusResident = 4;
+    public const uint TileStatusFailed = 5;
+
+    // Tile reported for a miss, flag of the tile reported for the rays that entered a tile that is not resident yet, and the flag
+    // added when that tile failed to load
+    public const uint WorldNoTile = 0xffffffff;
+    public const uint WorldTilePending = 0x80000000;
+    public const uint WorldTileFailed = 0x40000000;
+
+    // Status of the background scene build
+    public const int SetupStatusIdle = 0;
+    public const int SetupStatusBuilding = 1;
+    public const int SetupStatusReady = 2;
+    public const int SetupStatusCancelled = 3;
+    public const int SetupStatusFailed = 4;
+
     // Allocator API
     [DllImport ("rcu_dylib")]
 	public static extern IntPtr rcu_create_allocator();
@@ -48,7 +285,31 @@ public class RCUCApi
 	[DllImport ("rcu_dylib")]
 	public static extern IntPtr rcu_create_scene(IntPtr alloc);
 	[DllImport ("rcu_dylib")]
-	public static extern void rcu_scene_append_geometry(IntPtr scene, uint geoID, uint submeshID, float[] positionArray, float[] normalArray, float[] texCoordArray, uint numVerts, int[] indexArray, uint numTriangles, float[] transformMatrix);
+	public static extern void rcu_scene_append_geometry(IntPtr scene, uint geoID, uint submeshID, float[] positionArray, float[] normalArray, float[] texCoordArray, uint numVerts, int[] indexArray, uint numTriangles, float[] transformMatrix, uint layerMask);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_append_instanced_geometry(IntPtr scene, uint geoID, uint submeshID, float[] positionArray, float[] normalArray, float[] texCoordArray, uint numVerts, int[] indexArray, uint numTriangles, float[] transformMatrix, uint layerMask);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_set_geometry_transform(IntPtr scene, uint geometryIdx, float[] transformMatrix);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_append_quad_geometry(IntPtr scene, uint geoID, uint submeshID, float[] positionArray, float[] normalArray, float[] texCoordArray, uint numVerts, int[] quadIndexArray, uint numQuads, float[] transformMatrix, uint layerMask);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_append_primitive(IntPtr scene, uint geoID, uint submeshID, uint primitiveType, float[] parameters, float[] transformMatrix, uint layerMask);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_set_geometry_deformable(IntPtr scene, uint geometryIdx, int deformable);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_update_geometry_vertices(IntPtr scene, uint geometryIdx, float[] positionArray, float[] normalArray, float[] transformMatrix);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_set_geometry_reflection(IntPtr scene, uint geometryIdx, float reflectionCoefficient);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_set_primitive_reflection(IntPtr scene, uint primitiveIdx, float reflectionCoefficient);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_set_geometry_attributes(IntPtr scene, uint geometryIdx, float[] attributeArray, uint numComponents);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_pack_geometry_attributes(IntPtr scene, uint geometryIdx);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_scene_pack_attributes(IntPtr scene);
+	[DllImport ("rcu_dylib")]
+	public static extern int rcu_scene_write_tile_cache(IntPtr scene, string path);
 	[DllImport ("rcu_dylib")]
 	public static extern void rcu_destroy_scene(IntPtr scene);
 
@@ -58,9 +319,91 @@ public class RCUCApi
 	[DllImport ("rcu_dylib")]
 	public static extern void rcu_raycast_manager_setup(IntPtr manager, IntPtr scene);
 	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_setup_async(IntPtr manager, IntPtr scene);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_cancel_setup(IntPtr manager);
+	[DllImport ("rcu_dylib")]
+	public static extern int rcu_raycast_manager_setup_status(IntPtr manager);
+	[DllImport ("rcu_dylib")]
+	public static extern float rcu_raycast_manager_setup_progress(IntPtr manager);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_enable_spatial_queries(IntPtr manager, int enabled);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_enable_multi_hit(IntPtr manager, int enabled);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_enable_occupancy_culling(IntPtr manager, float voxelSize, ulong memoryBudget);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_enable_distance_field(IntPtr manager, float voxelSize, ulong memoryBudget);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_enable_geometry_merging(IntPtr manager, uint maxTriangles);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_update_geometry(IntPtr manager, uint geometryIdx);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_update_geometry_transform(IntPtr manager, uint geometryIdx);
+	[DllImport ("rcu_dylib")]
 	public static extern void rcu_raycast_manager_release(IntPtr manager);
 	[DllImport ("rcu_dylib")]
 	public static extern void rcu_raycast_manager_run(IntPtr manager, float[] rayDataArray, int[] intersectionDataArray, uint numRays);
 	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_enable_result_cache(IntPtr manager, uint capacity, float quantum);
+	[DllImport ("rcu_dylib")]
+	public static extern uint rcu_raycast_manager_run_compact(IntPtr manager, float[] rayDataArray, int[] hitDataArray, uint numRays);
+	[DllImport ("rcu_dylib")]
+	public static extern uint rcu_raycast_manager_run_layout(IntPtr manager, float[] rayDataArray, IntPtr outputData, uint stride, int[] attributeOffsets, int hitsOnly, uint numRays);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_run_specialized(IntPtr manager, float[] rayDataArray, int[] intersectionDataArray, uint numRays, uint attributeMask, uint packetWidth);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_run_multi_hit(IntPtr manager, float[] rayDataArray, int[] intersectionDataArray, uint[] hitCountArray, uint numRays, uint maxHits);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_closest_points(IntPtr manager, float[] queryDataArray, int[] resultDataArray, uint numQueries);
+	[DllImport ("rcu_dylib")]
+	public static extern uint rcu_raycast_manager_overlap_boxes(IntPtr manager, float[] queryDataArray, uint numQueries, uint mode, uint[] overlapDataArray, uint capacity);
+	[DllImport ("rcu_dylib")]
+	public static extern uint rcu_raycast_manager_overlap_spheres(IntPtr manager, float[] queryDataArray, uint numQueries, uint mode, uint[] overlapDataArray, uint capacity);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_sphere_casts(IntPtr manager, float[] castDataArray, int[] hitDataArray, uint numCasts);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_capsule_casts(IntPtr manager, float[] castDataArray, int[] hitDataArray, uint numCasts);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_trace_reflection_paths(IntPtr manager, float[] emitterDataArray, int[] endpointDataArray, uint numPaths, uint maxBounces, float minEnergy);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_ambient_occlusion(IntPtr manager, float[] pointDataArray, float[] visibilityArray, uint numPoints, uint numSamples, float radius, uint mask);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_bake_visibility(IntPtr manager, uint geometryIdx, uint width, uint height, float[] lightDataArray, uint numLights, uint mask, float[] atlas);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_line_of_sight(IntPtr manager, float[] sourceDataArray, uint numSources, float[] targetDataArray, uint numTargets, uint mask, uint[] bitMatrix);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_distance_samples(IntPtr manager, float[] pointDataArray, float[] sampleDataArray, uint numPoints);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_approximate_raycasts(IntPtr manager, float[] rayDataArray, int[] hitDataArray, uint numRays);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_bake_visibility_grid(IntPtr manager, float[] originData, float[] cellSizeData, uint[] resolution, uint numSamples, uint mask);
+	[DllImport ("rcu_dylib")]
+	public static extern uint rcu_raycast_manager_cell_visibility(IntPtr manager, uint cellA, uint cellB);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_potential_visibility(IntPtr manager, float[] sourceDataArray, float[] targetDataArray, uint numPairs, uint mask, byte[] visibleArray);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_setup_world(IntPtr manager, ulong memoryBudget);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_release_world(IntPtr manager);
+	[DllImport ("rcu_dylib")]
+	public static extern uint rcu_raycast_manager_add_world_tile(IntPtr manager, float[] boundsData, IntPtr scene, string cachePath);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_request_world_tile(IntPtr manager, uint tileIdx);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_request_world_region(IntPtr manager, float[] centerData, float radius);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_evict_world_tile(IntPtr manager, uint tileIdx);
+	[DllImport ("rcu_dylib")]
+	public static extern uint rcu_raycast_manager_world_tile_status(IntPtr manager, uint tileIdx);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_run_world(IntPtr manager, float[] rayDataArray, int[] intersectionDataArray, uint[] tileArray, uint numRays);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_run_records(IntPtr manager, float[] rayDataArray, int[] recordDataArray, uint numRays);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_resolve(IntPtr manager, int[] recordDataArray, uint[] indexArray, uint numIndices, uint attributeMask, int[] intersectionDataArray);
+	[DllImport ("rcu_dylib")]
+	public static extern void rcu_raycast_manager_resolve_attributes(IntPtr manager, int[] recordDataArray, uint[] indexArray, uint numIndices, float[] attributeDataArray, uint numComponents);
+	[DllImport ("rcu_dylib")]
 	public static extern void rcu_destroy_raycast_manager(IntPtr manager);
 }
\ No newline at end of file
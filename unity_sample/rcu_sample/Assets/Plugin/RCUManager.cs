@@ -136,7 +136,7 @@ public class RCUManager
                     uint numTriangles = (uint)(subMeshIndices.Length / 3);
 
                     // Push the geometry to the scene
-                    RCUCApi.rcu_scene_append_geometry(rcuScene, (uint)meshFilterIterator, subMeshIdx, vertArray, normalDataArray, texDataCoord, numVerts, subMeshIndices, numTriangles, transformMatrix);
+                    RCUCApi.rcu_scene_append_geometry(rcuScene, (uint)meshFilterIterator, subMeshIdx, vertArray, normalDataArray, texDataCoord, numVerts, subMeshIndices, numTriangles, transformMatrix, 1u << gameObject.layer);
                 }
 
                 meshFilterIterator++;
@@ -178,7 +178,7 @@ public class RCUManager
         intersectionDataArray = new int[currentMaxNumRays * RCUCApi.IntersectionDataSize];
     }
 
-    public void SetRayData(Vector3 origin, Vector3 direction, float tmin, float tmax, int rayIdx)
+    public void SetRayData(Vector3 origin, Vector3 direction, float tmin, float tmax, int rayIdx, uint layerMask = 0xffffffff)
     {
         rayDataArray[RCUCApi.RayDataSize * rayIdx + RCUCApi.RayOriginX] = origin.x;
         rayDataArray[RCUCApi.RayDataSize * rayIdx + RCUCApi.RayOriginY] = origin.y;
@@ -190,6 +190,9 @@ public class RCUManager
 
         rayDataArray[RCUCApi.RayDataSize * rayIdx + RCUCApi.RayMinRange] = tmin;
         rayDataArray[RCUCApi.RayDataSize * rayIdx + RCUCApi.RayMaxRange] = tmax;
+
+        // The mask is stored as raw bits in the float array
+        rayDataArray[RCUCApi.RayDataSize * rayIdx + RCUCApi.RayMask] = BitConverter.ToSingle(BitConverter.GetBytes(layerMask), 0);
     }
 
     public void RayOrigin(int targetRay, ref Vector3 outOrigin)